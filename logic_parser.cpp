@@ -8,6 +8,12 @@
  */
 
 #include <bits/stdc++.h> /**< \brief Includes all standard C++ libraries (e.g., iostream, vector, string, stack, map, set). */
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>     /**< \brief poll(), used by the cube-and-conquer worker processes. */
+#include <sys/wait.h> /**< \brief waitpid(), used by the cube-and-conquer worker processes. */
+#include <unistd.h>   /**< \brief fork() and pipe(), used by the cube-and-conquer worker processes. */
+#define HAVE_PROCESS_WORKERS 1 /**< \brief Defined where cubes can be farmed out to worker processes. */
+#endif
 using namespace std; /**< \brief Brings all identifiers from the std namespace into the global scope. */
 
 // ---------------- STRUCT ----------------
@@ -20,7 +26,7 @@ using namespace std; /**< \brief Brings all identifiers from the std namespace i
  */
 struct Node {
     /** \var value 
-     * \brief The operator (~, *, +, >) or a propositional atom (e.g., 'p', 'x1'). 
+     * \brief The operator (~, *, +, >), a propositional atom (e.g., 'p', 'x1') or a constant (1, 0). 
      */
     string value;
     /** \var left 
@@ -68,6 +74,17 @@ bool isOperator(const string &s) {
     return (s == "*" || s == "+" || s == ">" || s == "~");
 }
 
+/**
+ * \brief Checks if a given string token is one of the constants 1 (TRUE) and 0 (FALSE).
+ *
+ * Constants are leaves like atoms, but they are never assigned and are not atoms of the formula.
+ * \param s The string token to check.
+ * \return true if the token is a constant, false otherwise.
+ */
+bool isConstant(const string &s) {
+    return (s == "1" || s == "0");
+}
+
 /**
  * \brief Returns the precedence level for a logical operator.
  *
@@ -240,6 +257,38 @@ int treeHeight(Node* root) {
     return 1 + max(treeHeight(root->left), treeHeight(root->right));
 }
 
+// ---------------- TREE COPY ----------------
+
+/**
+ * \brief Makes a deep copy of a parse tree.
+ *
+ * The CNF conversion rewrites the tree in place, so a copy keeps the original formula available.
+ * \param root Pointer to the root Node of the parse tree.
+ * \return Pointer to the root of the copy.
+ */
+Node* copyTree(Node* root) {
+    if (!root) return nullptr;
+    return new Node(root->value, copyTree(root->left), copyTree(root->right));
+}
+
+/**
+ * \brief Frees every node of a parse tree.
+ *
+ * Iterative, so deep chains do not overflow the stack. The tree must not share nodes.
+ * \param root Pointer to the root Node of the parse tree (may be null).
+ */
+void deleteTree(Node* root) {
+    vector<Node*> pending;
+    if (root) pending.push_back(root);
+    while (!pending.empty()) {
+        Node* node = pending.back();
+        pending.pop_back();
+        if (node->left) pending.push_back(node->left);
+        if (node->right) pending.push_back(node->right);
+        delete node;
+    }
+}
+
 // ---------------- EVALUATION ----------------
 
 /**
@@ -250,8 +299,10 @@ int treeHeight(Node* root) {
  * \return The boolean result of the formula evaluation.
  */
 bool evaluate(Node* root, unordered_map<string, bool> &values) {
-    if (!root->left && !root->right)
+    if (!root->left && !root->right) {
+        if (isConstant(root->value)) return root->value == "1"; // Constant
         return values.at(root->value); // Atom evaluation
+    }
 
     if (root->value == "~")
         return !evaluate(root->left, values);
@@ -319,7 +370,7 @@ string dimacsToFormula(const string& filename) {
  */
 void collectAtoms(Node* root, set<string>& atoms) {
     if (!root) return;
-    if (!root->left && !root->right && !isOperator(root->value)) {
+    if (!root->left && !root->right && !isOperator(root->value) && !isConstant(root->value)) {
         atoms.insert(root->value);
     }
     collectAtoms(root->left, atoms);
@@ -336,7 +387,7 @@ void collectAtoms(Node* root, set<string>& atoms) {
  */
 bool evaluateNode(Node* root, const unordered_map<string,bool>& values) {
     // This function is essentially a duplication of evaluate but is used internally for the table
-    if (!root->left && !root->right) return values.at(root->value); 
+    if (!root->left && !root->right) return isConstant(root->value) ? root->value == "1" : values.at(root->value);
     if (root->value == "~") return !evaluateNode(root->left, values);
     if (root->value == "*") return evaluateNode(root->left, values) && evaluateNode(root->right, values);
     if (root->value == "+") return evaluateNode(root->left, values) || evaluateNode(root->right, values);
@@ -511,6 +562,83 @@ Node* convertToCNF(Node* root) {
 
 /* ---------------- END CNF Conversion ---------------- */
 
+/* ---------------- INTEGER CLAUSE DATABASE ---------------- */
+
+/**
+ * \struct ClauseDB
+ * \brief A set of clauses over integer literals.
+ *
+ * Atom number v (0-based) is encoded as literal 2*v when positive and 2*v+1 when negated,
+ * so the negation of a literal is `lit ^ 1` and both polarities of an atom sort next to each other.
+ */
+struct ClauseDB {
+    /** \var numVars
+     * \brief Number of distinct atoms (variables) in the database.
+     */
+    int numVars = 0;
+    /** \var clauses
+     * \brief The clauses; each inner vector is a disjunction of literals.
+     */
+    vector<vector<int>> clauses;
+    /** \var names
+     * \brief names[v] is the atom name of variable v (e.g., "x12", "p").
+     */
+    vector<string> names;
+};
+
+/** \brief Builds the literal of variable \p var, negated if \p negated is true. */
+inline int makeLiteral(int var, bool negated) { return 2 * var + (negated ? 1 : 0); }
+/** \brief Returns the variable of a literal. */
+inline int literalVar(int lit) { return lit >> 1; }
+/** \brief Returns true if the literal is a negated atom. */
+inline bool literalIsNegated(int lit) { return lit & 1; }
+/** \brief Returns the complementary literal. */
+inline int negateLiteral(int lit) { return lit ^ 1; }
+
+/**
+ * \brief Converts an integer literal back to its textual form (e.g., "p", "~x3").
+ * \param db The clause database holding the atom names.
+ * \param lit The literal.
+ * \return The literal as a string.
+ */
+string literalToString(const ClauseDB& db, int lit) {
+    return (literalIsNegated(lit) ? "~" : "") + db.names[literalVar(lit)];
+}
+
+/**
+ * \brief Builds an integer clause database from string clauses (as produced by \ref collectClauses).
+ *
+ * Atoms are numbered in order of first appearance.
+ * \param clauses The string clauses.
+ * \return The equivalent integer clause database.
+ */
+ClauseDB buildClauseDB(const vector<vector<string>>& clauses) {
+    ClauseDB db;
+    unordered_map<string, int> index;
+    db.clauses.reserve(clauses.size());
+
+    for (const auto& clause : clauses) {
+        vector<int> intClause;
+        intClause.reserve(clause.size());
+        for (const auto& literal : clause) {
+            bool negated = (literal[0] == '~');
+            string atom = negated ? literal.substr(1) : literal;
+            auto it = index.find(atom);
+            int var;
+            if (it == index.end()) {
+                var = db.numVars++;
+                index.emplace(atom, var);
+                db.names.push_back(atom);
+            } else {
+                var = it->second;
+            }
+            intClause.push_back(makeLiteral(var, negated));
+        }
+        db.clauses.push_back(move(intClause));
+    }
+    return db;
+}
+
 /* ---------------- TASK 7 - CNF Validity Check ---------------- */
 
 /**
@@ -554,183 +682,10575 @@ void collectClauses(Node* cnfRoot, vector<vector<string>>& clauses) {
         // Found a clause (which is an OR-chain or a single literal)
         vector<string> currentClause;
         getLiterals(cnfRoot, currentClause);
-        clauses.push_back(currentClause);
+        // Constants: a true literal satisfies the clause, a false one drops out of it
+        vector<string> kept;
+        for (const auto& literal : currentClause) {
+            if (literal == "1" || literal == "~0") return;
+            if (literal != "0" && literal != "~1") kept.push_back(literal);
+        }
+        clauses.push_back(kept);
     }
 }
 
 /**
- * \brief Analyzes the validity (tautology status) of each clause in a CNF formula.
+ * \brief Clauses below this count are analyzed on the calling thread only.
+ */
+const size_t PARALLEL_VALIDITY_THRESHOLD = 1 << 16;
+
+/**
+ * \brief Counts the tautological clauses in the range [begin, end) of a clause list.
+ *
+ * Uses an epoch-stamped mark array: mark[lit] == epoch means lit was already seen in the
+ * current clause. Starting a new clause only increments the epoch, so each clause is checked
+ * in O(L) time without clearing or allocating anything.
+ * \param clauses The integer clauses.
+ * \param begin Index of the first clause to check.
+ * \param end One past the index of the last clause to check.
+ * \param numVars Number of variables (the mark array has 2 * numVars entries).
+ * \param valid_count Receives the number of tautological clauses in the range.
+ * \param invalid_count Receives the number of non-tautological clauses in the range.
+ */
+void countTautologicalClauses(const vector<vector<int>>& clauses, size_t begin, size_t end, int numVars,
+                              long long& valid_count, long long& invalid_count) {
+    vector<uint32_t> mark(2 * (size_t)numVars, 0);
+    uint32_t epoch = 0;
+    valid_count = 0;
+    invalid_count = 0;
+
+    for (size_t i = begin; i < end; ++i) {
+        if (++epoch == 0) { // wrapped around: reset the marks once every 2^32 clauses
+            fill(mark.begin(), mark.end(), 0);
+            epoch = 1;
+        }
+        bool clauseIsTautology = false;
+        for (int lit : clauses[i]) {
+            if (mark[negateLiteral(lit)] == epoch) {
+                clauseIsTautology = true;
+                break;
+            }
+            mark[lit] = epoch;
+        }
+        if (clauseIsTautology) valid_count++;
+        else invalid_count++;
+    }
+}
+
+/**
+ * \brief Analyzes the validity (tautology status) of each clause in an integer clause database.
  *
  * A clause is a tautology if it contains a literal and its negation (e.g., $A + \neg A$).
  * The overall CNF formula is only a tautology if every single clause is a tautology.
- * \param clauses The vector of clauses (from \ref collectClauses).
+ * Large databases are split into contiguous ranges that are checked on separate threads,
+ * each with its own mark array; the per-thread counts are summed at the end.
+ * \param db The clause database.
  * \param valid_count Reference to an integer to store the count of tautological clauses.
  * \param invalid_count Reference to an integer to store the count of non-tautological clauses.
  * \return true if the entire CNF formula is a tautology (all clauses are tautological), false otherwise.
  */
-bool analyzeCNFValidity(const vector<vector<string>>& clauses, int& valid_count, int& invalid_count) {
+bool analyzeCNFValidity(const ClauseDB& db, int& valid_count, int& invalid_count) {
     valid_count = 0;
     invalid_count = 0;
 
-    if (clauses.empty()) {
-        return true; 
+    size_t total = db.clauses.size();
+    if (total == 0) {
+        return true;
     }
 
-    for (const auto& clause : clauses) {
-        set<string> literalsInClause;
-        bool clauseIsTautology = false;
-
-        for (const auto& literal : clause) {
-            string negation;
-            // Determine the negation of the current literal
-            if (literal[0] == '~') {
-                negation = literal.substr(1); // Literal is ~A, negation is A
-            } else {
-                negation = "~" + literal; // Literal is A, negation is ~A
-            }
-
-            // Check if the negation is already in the clause
-            if (literalsInClause.count(negation)) {
-                clauseIsTautology = true;
-                break; 
-            }
-            literalsInClause.insert(literal);
-        }
+    size_t threads = 1;
+    if (total >= PARALLEL_VALIDITY_THRESHOLD) {
+        threads = max(1u, thread::hardware_concurrency());
+        threads = min(threads, total / (PARALLEL_VALIDITY_THRESHOLD / 4));
+    }
 
-        if (clauseIsTautology) {
-            valid_count++;
-        } else {
-            invalid_count++;
+    vector<long long> valid(threads, 0), invalid(threads, 0);
+    if (threads == 1) {
+        countTautologicalClauses(db.clauses, 0, total, db.numVars, valid[0], invalid[0]);
+    } else {
+        vector<thread> workers;
+        size_t chunk = (total + threads - 1) / threads;
+        for (size_t t = 0; t < threads; ++t) {
+            size_t begin = min(total, t * chunk);
+            size_t end = min(total, begin + chunk);
+            workers.emplace_back(countTautologicalClauses, cref(db.clauses), begin, end, db.numVars,
+                                 ref(valid[t]), ref(invalid[t]));
         }
+        for (auto& w : workers) w.join();
     }
 
+    for (size_t t = 0; t < threads; ++t) {
+        valid_count += (int)valid[t];
+        invalid_count += (int)invalid[t];
+    }
     return (invalid_count == 0);
 }
 
+/**
+ * \brief Analyzes the validity (tautology status) of each clause in a CNF formula.
+ *
+ * Converts the string clauses to integer literals and runs the integer analysis.
+ * \param clauses The vector of clauses (from \ref collectClauses).
+ * \param valid_count Reference to an integer to store the count of tautological clauses.
+ * \param invalid_count Reference to an integer to store the count of non-tautological clauses.
+ * \return true if the entire CNF formula is a tautology (all clauses are tautological), false otherwise.
+ */
+bool analyzeCNFValidity(const vector<vector<string>>& clauses, int& valid_count, int& invalid_count) {
+    return analyzeCNFValidity(buildClauseDB(clauses), valid_count, invalid_count);
+}
+
+/* ---------------- END CNF Validity Check ---------------- */
 
-// ---------------- MAIN ----------------
+/* ---------------- CLAUSE SIMPLIFICATION ---------------- */
 
 /**
- * \brief Main function to handle user interaction, execute formula processing tasks, and output results.
+ * \struct SimplifyStats
+ * \brief Counters reported by \ref simplifyClauseDB.
+ */
+struct SimplifyStats {
+    size_t originalClauses = 0;   /**< Clauses before simplification. */
+    size_t duplicateLiterals = 0; /**< Repeated literals removed inside clauses. */
+    size_t tautologies = 0;       /**< Clauses removed because they contain A and ~A. */
+    size_t duplicateClauses = 0;  /**< Exact duplicate clauses removed. */
+    size_t forwardSubsumed = 0;   /**< Clauses dropped because an earlier clause subsumes them. */
+    size_t backwardSubsumed = 0;  /**< Earlier clauses dropped because a later clause subsumes them. */
+    size_t remainingClauses = 0;  /**< Clauses after simplification. */
+    double milliseconds = 0;      /**< Wall-clock time of the whole pass. */
+};
+
+/**
+ * \brief Sorts a clause and removes repeated literals.
  *
- * Tasks include: Infix to Prefix conversion, Parse Tree construction, Infix output, 
- * Tree Height calculation, Manual Evaluation, Truth Table Generation, CNF Conversion, 
- * and CNF Validity Check. It can load an expression from user input or a DIMACS file.
- * \return 0 upon successful execution, 1 on error.
+ * After sorting, A and ~A are adjacent (literals 2v and 2v+1), so the tautology test is a single scan.
+ * \param clause The clause to normalize (modified in place).
+ * \param removedLiterals Incremented by the number of duplicate literals removed.
+ * \return true if the clause is a tautology.
  */
-int main() {
-    cout << "Enter the infix logical expression (or leave blank to use CNF file): ";
-    string infix_expr;
-    getline(cin, infix_expr);
+bool normalizeClause(vector<int>& clause, size_t& removedLiterals) {
+    sort(clause.begin(), clause.end());
+    size_t before = clause.size();
+    clause.erase(unique(clause.begin(), clause.end()), clause.end());
+    removedLiterals += before - clause.size();
 
-    // --- Case 1: User entered a formula manually ---
-    if (!infix_expr.empty()) {
-        cout << "\n--- Using User-Entered Expression ---" << endl;
-        cout << "Expression: " << infix_expr << endl;
-    } 
-    // --- Case 2: No expression entered — load CNF file ---
-    else {
-        cout << "\nNo custom expression entered. Reading from CNF file..." << endl;
-        string formula = dimacsToFormula("unif-c500-v250-s453695930.cnf");
-        if (formula.empty()) {
-            cerr << "Error: CNF file could not be loaded. Exiting.\n";
-            return 1;
-        }
-        infix_expr = formula;
-        cout << "\n--- DIMACS Conversion ---" << endl;
-        cout << "Formula from CNF: " << formula << endl;
+    for (size_t i = 1; i < clause.size(); ++i) {
+        if (clause[i] == negateLiteral(clause[i - 1])) return true;
     }
+    return false;
+}
 
-    // --- Task 1: Infix → Prefix ---
-    vector<string> prefix_tokens = infixToPrefix(infix_expr);
-    string prefix_expr;
-    for (const string& token : prefix_tokens) prefix_expr += token + " ";
+/**
+ * \brief Computes a 64-bit signature of a clause (one bit per literal modulo 64).
+ *
+ * If clause D subsumes clause C then `sig(D) & ~sig(C)` is zero, which rejects most
+ * subsumption candidates without comparing literals.
+ * \param clause The clause.
+ * \return The signature bit mask.
+ */
+uint64_t clauseSignature(const vector<int>& clause) {
+    uint64_t sig = 0;
+    for (int lit : clause) sig |= 1ULL << (lit & 63);
+    return sig;
+}
 
-    cout << "\n--- Task 1: Prefix Conversion ---" << endl;
-    cout << "Infix: " << infix_expr << endl;
-    cout << "Prefix: " << prefix_expr << endl;
+/**
+ * \brief Hashes a normalized clause (FNV-1a over its literals).
+ * \param clause The sorted clause.
+ * \return The 64-bit hash.
+ */
+uint64_t clauseHash(const vector<int>& clause) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int lit : clause) {
+        h ^= (uint64_t)(uint32_t)lit;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
 
-    // --- Task 2: Prefix → Parse Tree ---
-    Node* root = buildParseTree(prefix_tokens); 
+/**
+ * \brief Simplifies a clause database in place.
+ *
+ * The pass works in three steps:
+ * 1. Sort every clause, drop duplicate literals and drop tautological clauses.
+ * 2. Remove exact duplicate clauses using a hash table keyed by \ref clauseHash.
+ * 3. Subsumption: clauses are inserted one at a time into per-literal occurrence lists.
+ *    A new clause is dropped if an inserted clause is a subset of it (forward subsumption);
+ *    otherwise every inserted clause that is a superset of it is removed (backward subsumption).
+ *    Candidates are filtered by size and by \ref clauseSignature before the literal comparison.
+ *
+ * If an empty clause remains after step 1, it subsumes everything and is the only clause kept.
+ * The order of surviving clauses is preserved. Variable numbering and names are unchanged.
+ * \param db The clause database to simplify.
+ * \return Statistics of the pass.
+ */
+SimplifyStats simplifyClauseDB(ClauseDB& db) {
+    auto start = chrono::steady_clock::now();
+    SimplifyStats stats;
+    stats.originalClauses = db.clauses.size();
 
-    cout << "\n--- Task 2: Parse Tree Building ---" << endl;
-    if (!root) {
-        cout << "Tree could not be built! Check the input expression." << endl;
-        return 1;
+    // Step 1: normalize clauses, drop tautologies
+    vector<vector<int>> work;
+    work.reserve(db.clauses.size());
+    for (auto& clause : db.clauses) {
+        if (normalizeClause(clause, stats.duplicateLiterals)) {
+            stats.tautologies++;
+            continue;
+        }
+        work.push_back(move(clause));
     }
-    cout << "Parse Tree built successfully!" << endl;
 
-    // --- Task 3: Tree → Infix ---
-    string inOrder = toInfix(root);
-    cout << "\n--- Task 3: Tree to Infix Conversion ---" << endl;
-    cout << "In-order (Infix form): " << inOrder << endl;
+    // The empty clause subsumes every clause; the occurrence lists below never see it.
+    for (size_t i = 0; i < work.size(); ++i) {
+        if (!work[i].empty()) continue;
+        stats.forwardSubsumed = work.size() - 1;
+        db.clauses.clear();
+        db.clauses.emplace_back();
+        stats.remainingClauses = 1;
+        stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
 
-    // --- Task 4: Tree Height ---
-    int height = treeHeight(root);
-    cout << "\n--- Task 4: Tree Height ---" << endl;
-    cout << "Tree Height: " << height << endl;
+    // Step 2: exact deduplication
+    unordered_map<uint64_t, vector<int>> buckets; // hash -> indices into work
+    buckets.reserve(work.size() * 2);
+    vector<char> removed(work.size(), 0);
+    for (int i = 0; i < (int)work.size(); ++i) {
+        auto& bucket = buckets[clauseHash(work[i])];
+        bool duplicate = false;
+        for (int j : bucket) {
+            if (work[j] == work[i]) { duplicate = true; break; }
+        }
+        if (duplicate) {
+            removed[i] = 1;
+            stats.duplicateClauses++;
+        } else {
+            bucket.push_back(i);
+        }
+    }
+    buckets.clear();
 
-    // --- Task 5: Evaluation ---
-    cout << "\n--- Task 5: Formula Evaluation ---" << endl;
-    unordered_map<string, bool> assignment;
-    
-    while (true) {
-        string atom;
-        cout << "Enter atom name (e.g., x1, p, y22) or STOP to end: ";
-        cin >> atom;
-        if (atom == "STOP") break;
+    // Step 3: forward and backward subsumption over occurrence lists
+    vector<uint64_t> sig(work.size());
+    for (size_t i = 0; i < work.size(); ++i) sig[i] = clauseSignature(work[i]);
+    vector<vector<int>> occurs(2 * (size_t)db.numVars);
 
-        int val_input;
-        cout << "Enter truth value for " << atom << " (0 for FALSE, 1 for TRUE): ";
-        cin >> val_input;
+    for (int i = 0; i < (int)work.size(); ++i) {
+        if (removed[i]) continue;
+        const vector<int>& c = work[i];
 
-        if (cin.fail() || (val_input != 0 && val_input != 1)) {
-            cerr << "Invalid input. Please enter 0 or 1." << endl;
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        // Forward: is c subsumed by an inserted clause? Any such clause occurs under one of c's literals.
+        bool subsumed = false;
+        for (int lit : c) {
+            for (int j : occurs[lit]) {
+                if (removed[j] || work[j].size() > c.size() || (sig[j] & ~sig[i])) continue;
+                if (includes(c.begin(), c.end(), work[j].begin(), work[j].end())) {
+                    subsumed = true;
+                    break;
+                }
+            }
+            if (subsumed) break;
+        }
+        if (subsumed) {
+            removed[i] = 1;
+            stats.forwardSubsumed++;
             continue;
         }
 
-        assignment[atom] = (val_input == 1);
+        // Backward: remove inserted clauses that c subsumes. They all contain c's rarest literal.
+        if (!c.empty()) {
+            int best = c[0];
+            for (int lit : c)
+                if (occurs[lit].size() < occurs[best].size()) best = lit;
+
+            vector<int>& list = occurs[best];
+            size_t keep = 0;
+            for (size_t k = 0; k < list.size(); ++k) {
+                int j = list[k];
+                if (removed[j]) continue; // compact lazily
+                if (work[j].size() >= c.size() && !(sig[i] & ~sig[j]) &&
+                    includes(work[j].begin(), work[j].end(), c.begin(), c.end())) {
+                    removed[j] = 1;
+                    stats.backwardSubsumed++;
+                    continue;
+                }
+                list[keep++] = j;
+            }
+            list.resize(keep);
+        }
+
+        for (int lit : c) occurs[lit].push_back(i);
     }
 
-    if (!assignment.empty()) {
-        bool result = evaluate(root, assignment); 
-        cout << "\nEvaluation Result:" << endl;
-        cout << "The formula evaluates to " << (result ? "TRUE" : "FALSE") << "." << endl;
-    } else {
-        cout << "No variables assigned. Skipping evaluation." << endl;
+    db.clauses.clear();
+    for (size_t i = 0; i < work.size(); ++i) {
+        if (!removed[i]) db.clauses.push_back(move(work[i]));
     }
+    stats.remainingClauses = db.clauses.size();
+    stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
 
-    // ---- Generate Truth Table ---
-    cout << "\n---Truth Table Generation ---" << endl;
-    cout << "Do you want to generate a full truth table for this formula? (y/n): ";
-    char choice;
-    cin >> choice;
-    if (choice == 'y' || choice == 'Y') {
-        generateTruthTable(root);
+/**
+ * \brief Prints the statistics of a simplification pass.
+ * \param stats The statistics returned by \ref simplifyClauseDB.
+ */
+void printSimplifyStats(const SimplifyStats& stats) {
+    streamsize oldPrecision = cout.precision();
+    cout << "Clauses before: " << stats.originalClauses << endl;
+    cout << "Duplicate literals removed: " << stats.duplicateLiterals << endl;
+    cout << "Tautological clauses removed: " << stats.tautologies << endl;
+    cout << "Duplicate clauses removed: " << stats.duplicateClauses << endl;
+    cout << "Forward-subsumed clauses removed: " << stats.forwardSubsumed << endl;
+    cout << "Backward-subsumed clauses removed: " << stats.backwardSubsumed << endl;
+    cout << "Clauses after: " << stats.remainingClauses << endl;
+    if (stats.originalClauses > 0) {
+        cout << "Reduction: " << fixed << setprecision(1)
+             << 100.0 * (stats.originalClauses - stats.remainingClauses) / stats.originalClauses << "%" << endl;
     }
+    cout << "Time: " << fixed << setprecision(3) << stats.milliseconds << " ms" << endl;
+    cout.unsetf(ios::floatfield);
+    cout.precision(oldPrecision);
+}
 
-    // --- Task 6 & 7: CNF Conversion + Validity ---
-    cout << "\n--- Task 6 & 7: CNF Conversion and Clause Validity ---" << endl;
-    Node* cnfRoot = convertToCNF(root);
-    string cnfInfix = toInfix(cnfRoot);
-    cout << "\nCNF Form of Formula: " << cnfInfix << endl;
+/* ---------------- END Clause Simplification ---------------- */
 
-    vector<vector<string>> clauses;
-    collectClauses(cnfRoot, clauses);
+/* ---------------- STREAMING CNF CONVERSION ---------------- */
 
-    int valid_count = 0, invalid_count = 0;
-    bool all_valid = analyzeCNFValidity(clauses, valid_count, invalid_count);
+/**
+ * \struct SpillFileHeader
+ * \brief Header of a binary clause spill file.
+ *
+ * The header is followed by the clauses, each stored as a 32-bit length followed by that many
+ * 32-bit literals (2*var+sign encoding, see \ref ClauseDB).
+ */
+struct SpillFileHeader {
+    char magic[4] = {'L', 'P', 'C', 'N'}; /**< File identifier. */
+    uint32_t numVars = 0;                 /**< Number of variables. */
+    uint64_t numClauses = 0;              /**< Number of clauses in the file. */
+    uint64_t numLiterals = 0;             /**< Total number of literals in the file. */
+};
 
-    cout << "\nCNF Clause Validity Analysis:" << endl;
-    cout << "Valid (tautological) clauses: " << valid_count << endl;
-    cout << "Non-tautological clauses: " << invalid_count << endl;
+/**
+ * \brief Default size of the in-memory clause buffer used for spilling (1 MiB).
+ */
+const size_t DEFAULT_SPILL_BUFFER_BYTES = 1 << 20;
 
-    if (all_valid)
-        cout << "The CNF is valid (all clauses are tautologies)." << endl;
-    else
-        cout << "The CNF is not valid (some clauses are not tautologies)." << endl;
+/**
+ * \struct ClauseSpillWriter
+ * \brief Writes clauses to a binary spill file through a fixed-size buffer.
+ *
+ * Memory use is bounded by the buffer size: the buffer is flushed to disk whenever the next
+ * clause would not fit.
+ */
+struct ClauseSpillWriter {
+    /** \var file \brief The open output file. */
+    FILE* file = nullptr;
+    /** \var buffer \brief Pending words (lengths and literals) not yet written. */
+    vector<uint32_t> buffer;
+    /** \var capacity \brief Buffer capacity in 32-bit words. */
+    size_t capacity = 0;
+    /** \var header \brief Running counts, written to the file on \ref close. */
+    SpillFileHeader header;
+    /** \var failed \brief Set when a write fails (e.g. the disk is full); reported by \ref close. */
+    bool failed = false;
+
+    /**
+     * \brief Opens a spill file for writing.
+     * \param path The output path.
+     * \param numVars The number of variables recorded in the header.
+     * \param bufferBytes The buffer size in bytes.
+     * \return true on success.
+     */
+    bool open(const string& path, int numVars, size_t bufferBytes = DEFAULT_SPILL_BUFFER_BYTES) {
+        file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        header = SpillFileHeader();
+        header.numVars = numVars;
+        capacity = max<size_t>(bufferBytes / sizeof(uint32_t), 16);
+        buffer.clear();
+        buffer.reserve(capacity);
+        failed = fwrite(&header, sizeof(header), 1, file) != 1; // placeholder, rewritten by close()
+        return true;
+    }
+
+    /** \brief Writes the buffered words to disk. */
+    void flush() {
+        if (!buffer.empty() && fwrite(buffer.data(), sizeof(uint32_t), buffer.size(), file) != buffer.size()) failed = true;
+        buffer.clear();
+    }
+
+    /**
+     * \brief Appends one clause.
+     * \param lits Pointer to the literals.
+     * \param len Number of literals.
+     */
+    void write(const int* lits, size_t len) {
+        if (buffer.size() + len + 1 > capacity) flush();
+        if (len + 1 > capacity) { // clause larger than the whole buffer: write it directly
+            uint32_t n = (uint32_t)len;
+            if (fwrite(&n, sizeof(n), 1, file) != 1 || fwrite(lits, sizeof(uint32_t), len, file) != len) failed = true;
+        } else {
+            buffer.push_back((uint32_t)len);
+            buffer.insert(buffer.end(), lits, lits + len);
+        }
+        header.numClauses++;
+        header.numLiterals += len;
+    }
+
+    /** \brief Appends one clause. */
+    void write(const vector<int>& clause) { write(clause.data(), clause.size()); }
+
+    /**
+     * \brief Flushes the buffer, writes the final header and closes the file.
+     * \return false if any write since \ref open failed; the file is then incomplete.
+     */
+    bool close() {
+        if (!file) return !failed;
+        flush();
+        if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1) failed = true;
+        if (fclose(file) != 0) failed = true;
+        file = nullptr;
+        return !failed;
+    }
+};
+
+/**
+ * \brief Reads a spill file in buffer-sized chunks and calls \p visit for every clause.
+ *
+ * Only one chunk (plus a clause that crosses a chunk boundary) is held in memory at a time.
+ * \param path The spill file path.
+ * \param visit Called as visit(lits, len) for every clause in file order.
+ * \param header Receives the file header.
+ * \param bufferBytes The chunk size in bytes.
+ * \return false if the file could not be opened, is not a spill file, or ends before the
+ *         clause count in its header (the clauses before the truncation are still visited).
+ */
+bool forEachSpilledClause(const string& path, const function<void(const int*, size_t)>& visit,
+                          SpillFileHeader& header, size_t bufferBytes = DEFAULT_SPILL_BUFFER_BYTES) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, "LPCN", 4) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    size_t capacity = max<size_t>(bufferBytes / sizeof(uint32_t), 16);
+    vector<uint32_t> chunk(capacity);
+    size_t filled = 0, pos = 0;
+    vector<int> large; // used only for clauses that do not fit into one chunk
+    bool complete = false;
+
+    // Makes at least 'need' words available at chunk[pos]; returns false at end of file.
+    auto fill = [&](size_t need) {
+        if (filled - pos >= need) return true;
+        memmove(chunk.data(), chunk.data() + pos, (filled - pos) * sizeof(uint32_t));
+        filled -= pos;
+        pos = 0;
+        filled += fread(chunk.data() + filled, sizeof(uint32_t), capacity - filled, file);
+        return filled >= need;
+    };
+
+    for (uint64_t c = 0;; ++c) {
+        if (c == header.numClauses) {
+            complete = true;
+            break;
+        }
+        if (!fill(1)) break;
+        size_t len = chunk[pos++];
+        if (len < capacity) {
+            if (!fill(len)) break;
+            visit(reinterpret_cast<const int*>(chunk.data() + pos), len);
+            pos += len;
+        } else {
+            large.resize(len);
+            size_t have = filled - pos;
+            memcpy(large.data(), chunk.data() + pos, have * sizeof(uint32_t));
+            size_t got = fread(large.data() + have, sizeof(uint32_t), len - have, file);
+            pos = filled = 0;
+            if (have + got < len) break;
+            visit(large.data(), len);
+        }
+    }
+    fclose(file);
+    return complete;
+}
+
+/**
+ * \brief Returns a fresh path in the system temporary directory for a spill file.
+ * \return The path as a string.
+ */
+string makeSpillPath() {
+    static atomic<unsigned> counter{0};
+    auto stamp = chrono::steady_clock::now().time_since_epoch().count();
+    string name = "logic_cnf_" + to_string(stamp) + "_" + to_string(counter++) + ".bin";
+    return (filesystem::temp_directory_path() / name).string();
+}
+
+/**
+ * \brief Enumerates the clauses of the disjunction of all pending NNF subformulas.
+ *
+ * This is the distributive law applied lazily: for an AND node the clause set is the union of the
+ * clause sets with either child in its place, for an OR node both children stay pending, and a
+ * literal is added to the current clause. Nothing but the pending list and the current clause is
+ * kept in memory, so no CNF tree is ever built.
+ * \param pending The subformulas still to be distributed (used as a stack).
+ * \param clause The literals collected so far.
+ * \param varOf Maps atom names to variable numbers.
+ * \param out The spill writer receiving each finished clause.
+ */
+void streamDistribute(vector<Node*>& pending, vector<int>& clause,
+                      const unordered_map<string, int>& varOf, ClauseSpillWriter& out) {
+    if (out.failed) return; // the file is lost anyway; do not enumerate the rest
+    if (pending.empty()) {
+        out.write(clause);
+        return;
+    }
+    Node* node = pending.back();
+    pending.pop_back();
+
+    if (node->value == "+") {
+        pending.push_back(node->right);
+        pending.push_back(node->left);
+        streamDistribute(pending, clause, varOf, out);
+        pending.pop_back();
+        pending.pop_back();
+    } else if (node->value == "*") {
+        pending.push_back(node->left);
+        streamDistribute(pending, clause, varOf, out);
+        pending.back() = node->right;
+        streamDistribute(pending, clause, varOf, out);
+        pending.pop_back();
+    } else {
+        // Literal: an atom or a negated atom (the tree is in NNF)
+        bool negated = (node->value == "~");
+        const string& atom = negated ? node->left->value : node->value;
+        if (isConstant(atom)) {
+            // A true literal satisfies every clause through it; a false one adds nothing
+            if ((atom == "1") == negated) streamDistribute(pending, clause, varOf, out);
+        } else {
+            clause.push_back(makeLiteral(varOf.at(atom), negated));
+            streamDistribute(pending, clause, varOf, out);
+            clause.pop_back();
+        }
+    }
+    pending.push_back(node);
+}
+
+/**
+ * \brief Converts a formula to CNF, streaming the clauses to a binary spill file instead of building a CNF tree.
+ *
+ * Implications are eliminated and negations moved inward as in \ref convertToCNF (both linear);
+ * the exponential distribution step is replaced by \ref streamDistribute. Variables are numbered in
+ * the sorted order of \ref collectAtoms. The clauses are the same as those of
+ * `collectClauses(convertToCNF(root))`, possibly in a different order.
+ * \param root Pointer to the root Node of the parse tree (rewritten to NNF in place).
+ * \param path The output spill file path.
+ * \param names Receives the atom name of every variable.
+ * \param header Receives the header of the written file (clause and literal counts).
+ * \param bufferBytes The write buffer size in bytes; bounds the memory used for clauses.
+ * \return false if the file could not be opened or a write failed (e.g. the disk is full).
+ */
+bool convertToCNFStreaming(Node* root, const string& path, vector<string>& names, SpillFileHeader& header,
+                           size_t bufferBytes = DEFAULT_SPILL_BUFFER_BYTES) {
+    root = eliminateImplications(root);
+    root = moveNegations(root);
+
+    set<string> atoms;
+    collectAtoms(root, atoms);
+    names.assign(atoms.begin(), atoms.end());
+    unordered_map<string, int> varOf;
+    for (int v = 0; v < (int)names.size(); ++v) varOf[names[v]] = v;
+
+    header = SpillFileHeader();
+    ClauseSpillWriter out;
+    if (!root || !out.open(path, (int)names.size(), bufferBytes)) return false;
+
+    vector<Node*> pending{root};
+    vector<int> clause;
+    streamDistribute(pending, clause, varOf, out);
+    bool written = out.close();
+    header = out.header;
+    return written;
+}
+
+/**
+ * \brief Number of clauses above which main() offers streaming before the in-memory CNF conversion.
+ */
+const uint64_t STREAMING_CNF_CLAUSES = 1000000;
+
+/**
+ * \brief Upper bound on the number of clauses \ref convertToCNF produces, computed without building anything.
+ *
+ * Follows the distribution on clause counts only: a conjunction adds the counts of its operands
+ * and a disjunction multiplies them, with negations and implications handled by tracking the
+ * polarity as in \ref moveNegations. Iterative and linear in the tree size; the count saturates
+ * instead of overflowing.
+ * \param root Pointer to the root Node of the parse tree (not modified).
+ * \return The bound (UINT64_MAX if it does not fit).
+ */
+uint64_t estimateCNFClauses(Node* root) {
+    if (!root) return 0;
+    auto add = [](uint64_t a, uint64_t b) { return a > UINT64_MAX - b ? UINT64_MAX : a + b; };
+    auto multiply = [](uint64_t a, uint64_t b) { return b && a > UINT64_MAX / b ? UINT64_MAX : a * b; };
+    struct Frame {
+        Node* node;
+        bool positive;
+        bool expanded;
+    };
+    vector<Frame> stack{{root, true, false}};
+    vector<uint64_t> counts; // clause counts of finished subtrees, in post-order
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+        Node* node = frame.node;
+        const string& op = node->value;
+        if (!node->left && !node->right) {
+            counts.push_back(1);
+            continue;
+        }
+        if (op == "~") {
+            stack.push_back({node->left, !frame.positive, false});
+            continue;
+        }
+        if (!frame.expanded) {
+            // A > B is ~A + B: the left operand has the opposite polarity
+            stack.push_back({node, frame.positive, true});
+            stack.push_back({node->right, frame.positive, false});
+            stack.push_back({node->left, op == ">" ? !frame.positive : frame.positive, false});
+            continue;
+        }
+        uint64_t right = counts.back();
+        counts.pop_back();
+        uint64_t left = counts.back();
+        // Positive OR and IMPLIES distribute (product); positive AND and negated OR/IMPLIES concatenate
+        bool conjunction = (op == "*") == frame.positive;
+        counts.back() = conjunction ? add(left, right) : multiply(left, right);
+    }
+    return counts.back();
+}
+
+/**
+ * \struct SpillStatistics
+ * \brief Summary of a spilled clause set, computed by \ref analyzeSpilledClauses.
+ */
+struct SpillStatistics {
+    uint64_t clauses = 0;        /**< Number of clauses. */
+    uint64_t literals = 0;       /**< Total number of literals. */
+    uint64_t unitClauses = 0;    /**< Clauses with one literal. */
+    uint64_t binaryClauses = 0;  /**< Clauses with two literals. */
+    uint64_t maxLength = 0;      /**< Length of the longest clause. */
+    uint64_t tautologies = 0;    /**< Clauses containing A and ~A. */
+    int usedVars = 0;            /**< Variables that occur in at least one clause. */
+};
+
+/**
+ * \brief Computes clause statistics and the tautological clause count in one streaming pass.
+ *
+ * Uses the same epoch-stamped mark array as \ref countTautologicalClauses, so the pass needs
+ * O(k) memory besides the read buffer.
+ * \param path The spill file path.
+ * \param stats Receives the statistics.
+ * \param bufferBytes The read buffer size in bytes.
+ * \return false if the file could not be read or is truncated.
+ */
+bool analyzeSpilledClauses(const string& path, SpillStatistics& stats,
+                           size_t bufferBytes = DEFAULT_SPILL_BUFFER_BYTES) {
+    stats = SpillStatistics();
+    SpillFileHeader header;
+    vector<uint32_t> mark;
+    vector<char> used;
+    uint32_t epoch = 0;
+
+    bool ok = forEachSpilledClause(path, [&](const int* lits, size_t len) {
+        if (mark.empty()) {
+            mark.assign(2 * (size_t)header.numVars, 0);
+            used.assign(header.numVars, 0);
+        }
+        stats.clauses++;
+        stats.literals += len;
+        if (len == 1) stats.unitClauses++;
+        if (len == 2) stats.binaryClauses++;
+        stats.maxLength = max<uint64_t>(stats.maxLength, len);
+
+        if (++epoch == 0) {
+            fill(mark.begin(), mark.end(), 0);
+            epoch = 1;
+        }
+        bool tautology = false;
+        for (size_t i = 0; i < len; ++i) {
+            used[literalVar(lits[i])] = 1;
+            if (mark[negateLiteral(lits[i])] == epoch) tautology = true;
+            mark[lits[i]] = epoch;
+        }
+        if (tautology) stats.tautologies++;
+    }, header, bufferBytes);
+
+    stats.usedVars = (int)count(used.begin(), used.end(), 1);
+    return ok;
+}
+
+/**
+ * \brief Streaming simplification: copies a spill file, normalizing clauses and dropping tautologies.
+ *
+ * Each clause is sorted, repeated literals are removed and tautological clauses are skipped
+ * (see \ref normalizeClause). Cross-clause steps (deduplication, subsumption) need the whole
+ * clause set and are left to \ref simplifyClauseDB.
+ * \param inPath The input spill file.
+ * \param outPath The output spill file.
+ * \param stats Receives the counters (the subsumption and duplicate-clause counters stay 0).
+ * \param bufferBytes The buffer size used for both reading and writing.
+ * \return false if either file could not be opened, the input is truncated or a write failed.
+ */
+bool simplifySpilledClauses(const string& inPath, const string& outPath, SimplifyStats& stats,
+                            size_t bufferBytes = DEFAULT_SPILL_BUFFER_BYTES) {
+    auto start = chrono::steady_clock::now();
+    stats = SimplifyStats();
+    SpillFileHeader header;
+    ClauseSpillWriter out;
+    vector<int> clause;
+    bool opened = false;
+
+    bool ok = forEachSpilledClause(inPath, [&](const int* lits, size_t len) {
+        if (!opened) opened = out.open(outPath, header.numVars, bufferBytes);
+        if (!opened) return;
+        stats.originalClauses++;
+        clause.assign(lits, lits + len);
+        if (normalizeClause(clause, stats.duplicateLiterals)) {
+            stats.tautologies++;
+            return;
+        }
+        out.write(clause);
+    }, header, bufferBytes);
+
+    if (ok && !opened) opened = out.open(outPath, header.numVars, bufferBytes); // empty input
+    bool written = out.close();
+    stats.remainingClauses = out.header.numClauses;
+    stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return ok && opened && written;
+}
+
+/**
+ * \brief Loads a spill file into an in-memory clause database.
+ * \param path The spill file path.
+ * \param names The atom names (from \ref convertToCNFStreaming).
+ * \param db Receives the clauses.
+ * \return false if the file could not be read or is truncated.
+ */
+bool loadSpilledClauses(const string& path, const vector<string>& names, ClauseDB& db) {
+    SpillFileHeader header;
+    db = ClauseDB();
+    db.names = names;
+    bool ok = forEachSpilledClause(path, [&](const int* lits, size_t len) {
+        db.clauses.emplace_back(lits, lits + len);
+    }, header);
+    db.numVars = header.numVars;
+    return ok;
+}
+
+/* ---------------- END Streaming CNF Conversion ---------------- */
+
+/* ---------------- DIMACS EXPORT / IMPORT ---------------- */
+
+/**
+ * \struct DimacsOutputBuffer
+ * \brief A large output buffer with hand-written integer formatting for fast DIMACS writing.
+ */
+struct DimacsOutputBuffer {
+    /** \var file \brief The open output file. */
+    FILE* file;
+    /** \var data \brief Buffered characters. */
+    vector<char> data;
+    /** \var used \brief Number of buffered characters. */
+    size_t used = 0;
+
+    /**
+     * \brief Creates a buffer writing to \p f.
+     * \param f The output file.
+     * \param bytes The buffer size.
+     */
+    DimacsOutputBuffer(FILE* f, size_t bytes = 1 << 20) : file(f), data(bytes) {}
+
+    /** \brief Writes out the buffered characters. */
+    void flush() {
+        fwrite(data.data(), 1, used, file);
+        used = 0;
+    }
+
+    /** \brief Makes room for at least \p n more characters. */
+    void reserve(size_t n) {
+        if (used + n > data.size()) flush();
+        if (n > data.size()) data.resize(n);
+    }
+
+    /** \brief Appends a string. */
+    void put(const string& s) {
+        reserve(s.size());
+        memcpy(data.data() + used, s.data(), s.size());
+        used += s.size();
+    }
+
+    /** \brief Appends a character. */
+    void put(char c) {
+        reserve(1);
+        data[used++] = c;
+    }
+
+    /** \brief Appends a signed integer in decimal. */
+    void putInt(long long v) {
+        reserve(21);
+        if (v < 0) {
+            data[used++] = '-';
+            v = -v;
+        }
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v > 0);
+        while (n > 0) data[used++] = digits[--n];
+    }
+};
+
+/**
+ * \brief Writes a clause database in DIMACS CNF format.
+ *
+ * Variable v of the database becomes DIMACS variable v+1. A comment block maps every DIMACS
+ * variable back to its atom name (`c var <number> <name>`) so \ref loadDimacs can restore the
+ * names. It is followed by the `p cnf <variables> <clauses>` header and one clause per line.
+ * \param db The clause database.
+ * \param filename The output path.
+ * \return true on success, false if the file could not be written.
+ */
+bool writeDimacs(const ClauseDB& db, const string& filename) {
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        cerr << "Error opening file\n";
+        return false;
+    }
+
+    DimacsOutputBuffer out(file);
+    out.put("c generated by logic_parser\nc atom names: c var <dimacs variable> <atom>\n");
+    for (int v = 0; v < db.numVars; ++v) {
+        out.put("c var ");
+        out.putInt(v + 1);
+        out.put(' ');
+        out.put(v < (int)db.names.size() ? db.names[v] : "x" + to_string(v + 1));
+        out.put('\n');
+    }
+    out.put("p cnf ");
+    out.putInt(db.numVars);
+    out.put(' ');
+    out.putInt((long long)db.clauses.size());
+    out.put('\n');
+
+    for (const auto& clause : db.clauses) {
+        for (int lit : clause) {
+            out.putInt(literalIsNegated(lit) ? -(literalVar(lit) + 1) : literalVar(lit) + 1);
+            out.put(' ');
+        }
+        out.put("0\n");
+    }
+    out.flush();
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * \brief Loads a DIMACS CNF file directly into an integer clause database.
+ *
+ * This is the fast path for files written by \ref writeDimacs: no infix string or parse tree is
+ * built. The whole file is read at once and scanned with a hand-written integer parser.
+ * Atom names are taken from `c var <number> <name>` comments; variables without such a comment
+ * are named "x<number>", matching \ref dimacsToFormula. Clauses may span several lines.
+ * Comment (`c`) and header (`p`) lines are recognized after leading blanks; a `c` after the
+ * literals of a line also starts a comment.
+ * \param filename The path to the DIMACS CNF file.
+ * \param db Receives the clause database.
+ * \return true on success, false if the file could not be opened or a literal exceeds the
+ *         variable count of the `p cnf` header (or the literal encoding when there is no header).
+ */
+bool loadDimacs(const string& filename, ClauseDB& db) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        cerr << "Error opening file\n";
+        return false;
+    }
+    string text;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0) {
+        text.resize(size);
+        text.resize(fread(&text[0], 1, size, file));
+    }
+    fclose(file);
+
+    db = ClauseDB();
+    vector<pair<int, string>> mappedNames; // (v, name) from "c var v+1 <name>"; applied once numVars is known
+    int declaredVars = 0, maxVar = 0;
+    vector<int> clause;
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    bool lineStart = true;
+    long line = 1;
+
+    while (p < end) {
+        char c = *p;
+        if (c == '\n') {
+            lineStart = true;
+            ++line;
+            ++p;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            ++p;
+            continue;
+        }
+        if (c == 'c' || (c == 'p' && lineStart)) {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            if (!eol) eol = end;
+            if (c == 'p') {
+                stringstream ss(string(p, eol));
+                string tag, format;
+                ss >> tag >> format >> declaredVars; // p cnf <vars> <clauses>
+            } else if (eol - p > 6 && memcmp(p, "c var ", 6) == 0) {
+                const char* q = p + 6;
+                long long number = 0;
+                while (q < eol && *q >= '0' && *q <= '9' && number <= INT_MAX) number = number * 10 + (*q++ - '0');
+                while (q < eol && *q == ' ') ++q;
+                const char* nameEnd = q;
+                while (nameEnd < eol && !isspace((unsigned char)*nameEnd)) ++nameEnd;
+                if (number > 0 && number <= INT_MAX / 2 && nameEnd > q) {
+                    mappedNames.push_back({(int)number - 1, string(q, nameEnd)});
+                }
+            }
+            p = eol;
+            continue;
+        }
+        lineStart = false;
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            bool negative = (c == '-');
+            if (negative) ++p;
+            // Variables are bounded by the header, and always by the 2*var+sign literal encoding
+            int limit = declaredVars > 0 ? min(declaredVars, INT_MAX / 2) : INT_MAX / 2;
+            long long v = 0;
+            const char* digits = p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                v = v * 10 + (*p++ - '0');
+                if (v > limit) {
+                    cerr << "Error: variable out of range on line " << line << " (at most " << limit << ")\n";
+                    return false;
+                }
+            }
+            if (p == digits) continue; // stray '-'
+            if (v == 0) { // "0" and "-0" both end the clause
+                db.clauses.emplace_back(clause.begin(), clause.end());
+                clause.clear();
+            } else {
+                maxVar = max(maxVar, (int)v);
+                clause.push_back(makeLiteral((int)v - 1, negative));
+            }
+            continue;
+        } else if (c == '%') {
+            break; // end marker used by some benchmark files
+        }
+        ++p;
+    }
+    if (!clause.empty()) db.clauses.push_back(clause);
+
+    db.numVars = max(declaredVars, maxVar);
+    db.names.resize(db.numVars);
+    for (int v = 0; v < db.numVars; ++v) db.names[v] = "x" + to_string(v + 1);
+    for (auto& [v, name] : mappedNames) {
+        if (v < db.numVars) db.names[v] = move(name);
+    }
+    return true;
+}
+
+/* ---------------- END DIMACS Export / Import ---------------- */
+
+/* ---------------- PARALLEL CNF CONVERSION ---------------- */
+
+/**
+ * \struct WorkStealingPool
+ * \brief A fork-join thread pool with one task deque per worker.
+ *
+ * Each worker pushes and pops its own tasks at the back of its deque (LIFO, good locality) and
+ * steals from the front of other workers' deques when it runs out of work. The thread that calls
+ * \ref run acts as worker 0; the pool starts the other workers itself. A thread waiting in
+ * \ref forkJoin keeps running tasks instead of blocking, so nested fork-join cannot deadlock.
+ */
+struct WorkStealingPool {
+    /** \brief A worker's task deque. */
+    struct TaskQueue {
+        mutex lock;                    /**< Guards \p tasks. */
+        deque<function<void()>> tasks; /**< Pending tasks. */
+    };
+
+    /** \var queues \brief One deque per worker. */
+    vector<unique_ptr<TaskQueue>> queues;
+    /** \var threads \brief Workers 1..N-1 (worker 0 is the caller of \ref run). */
+    vector<thread> threads;
+    /** \var stopping \brief Set by the destructor to end the worker loops. */
+    atomic<bool> stopping{false};
+    /** \var workerId \brief Index of the current thread's deque, or -1 outside the pool. */
+    inline static thread_local int workerId = -1;
+
+    /**
+     * \brief Starts a pool with \p numThreads workers (including the calling thread).
+     * \param numThreads Number of workers; values below 1 are treated as 1.
+     */
+    explicit WorkStealingPool(int numThreads) {
+        numThreads = max(1, numThreads);
+        for (int i = 0; i < numThreads; ++i) queues.emplace_back(new TaskQueue());
+        for (int i = 1; i < numThreads; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    /** \brief Stops and joins the worker threads. */
+    ~WorkStealingPool() {
+        stopping = true;
+        for (auto& t : threads) t.join();
+    }
+
+    /** \brief Number of workers. */
+    int size() const { return (int)queues.size(); }
+
+    /** \brief Pushes a task onto the current worker's deque. */
+    void push(function<void()> task) {
+        TaskQueue& q = *queues[max(workerId, 0)];
+        lock_guard<mutex> guard(q.lock);
+        q.tasks.push_back(move(task));
+    }
+
+    /**
+     * \brief Runs one task: the newest of the current worker, otherwise the oldest of another worker.
+     * \return false if no task was found.
+     */
+    bool tryRunOne() {
+        int self = max(workerId, 0);
+        function<void()> task;
+        {
+            TaskQueue& q = *queues[self];
+            lock_guard<mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                task = move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+        }
+        for (int k = 1; !task && k < size(); ++k) {
+            TaskQueue& victim = *queues[(self + k) % size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task) return false;
+        task();
+        return true;
+    }
+
+    /** \brief Main loop of workers 1..N-1: run or steal tasks, backing off when idle. */
+    void workerLoop(int id) {
+        workerId = id;
+        int idle = 0;
+        while (!stopping) {
+            if (tryRunOne()) idle = 0;
+            else if (++idle < 64) this_thread::yield();
+            else this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+
+    /**
+     * \brief Runs \p f and \p g, possibly in parallel, and returns when both are done.
+     *
+     * \p g is pushed as a stealable task while the current thread runs \p f; afterwards the
+     * current thread runs pending tasks (normally \p g itself) until \p g has finished.
+     */
+    template <class F, class G>
+    void forkJoin(F&& f, G&& g) {
+        if (size() == 1) {
+            f();
+            g();
+            return;
+        }
+        atomic<bool> done{false};
+        push([&] {
+            g();
+            done.store(true, memory_order_release);
+        });
+        f();
+        while (!done.load(memory_order_acquire)) {
+            if (!tryRunOne()) this_thread::yield();
+        }
+    }
+
+    /** \brief Runs \p f on the calling thread as worker 0. */
+    template <class F>
+    void run(F&& f) {
+        int saved = workerId;
+        workerId = 0;
+        f();
+        workerId = saved;
+    }
+};
+
+/**
+ * \brief Upper bound on the worker count accepted by the parallel CNF conversion prompt.
+ */
+const int MAX_PARALLEL_CNF_THREADS = 256;
+
+/**
+ * \struct NodeArena
+ * \brief A bump allocator for parse tree nodes, used by one worker at a time.
+ *
+ * Nodes are carved out of 4096-node blocks, so parallel tasks do not contend on the global heap.
+ * The arena owns its nodes: destroying it destroys every node (and its label) and frees the
+ * blocks, so a tree built in arenas is valid exactly as long as they are.
+ */
+struct NodeArena {
+    /** \var BLOCK_NODES \brief Nodes per block. */
+    static constexpr size_t BLOCK_NODES = 4096;
+    /** \var blocks \brief All blocks; the last one is being filled. */
+    vector<Node*> blocks;
+    /** \var used \brief Nodes used in the last block. */
+    size_t used = BLOCK_NODES;
+
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+    NodeArena(NodeArena&& other) noexcept : blocks(move(other.blocks)), used(other.used) { other.blocks.clear(); }
+
+    /** \brief Destroys the nodes and frees the blocks. */
+    ~NodeArena() {
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            size_t constructed = b + 1 == blocks.size() ? used : BLOCK_NODES;
+            for (size_t i = 0; i < constructed; ++i) blocks[b][i].~Node();
+            ::operator delete(blocks[b]);
+        }
+    }
+
+    /** \brief Constructs a node in the arena. */
+    Node* make(const string& value, Node* l = nullptr, Node* r = nullptr) {
+        if (used == BLOCK_NODES) {
+            blocks.push_back(static_cast<Node*>(::operator new(BLOCK_NODES * sizeof(Node))));
+            used = 0;
+        }
+        Node* node = new (blocks.back() + used) Node(value, l, r);
+        used++;
+        return node;
+    }
+};
+
+/**
+ * \struct ParallelCNFContext
+ * \brief Settings shared by the parallel CNF passes.
+ */
+struct ParallelCNFContext {
+    WorkStealingPool& pool;    /**< The pool running the tasks. */
+    size_t cutoff;             /**< Work (in nodes or clauses) below which a pass runs sequentially. */
+    vector<NodeArena>& arenas; /**< One arena per worker; they own every node the passes create. */
+
+    /**
+     * \brief Allocates a node from the calling worker's arena.
+     * \param value The operator or atom.
+     * \param l Left child.
+     * \param r Right child.
+     * \return The new node.
+     */
+    Node* node(const string& value, Node* l = nullptr, Node* r = nullptr) {
+        return arenas[max(WorkStealingPool::workerId, 0)].make(value, l, r);
+    }
+};
+
+/**
+ * \brief Counts the nodes of a subtree, stopping once \p limit is reached.
+ * \param root The subtree.
+ * \param limit The maximum count of interest.
+ * \return min(size of subtree, limit).
+ */
+size_t countNodesUpTo(Node* root, size_t limit) {
+    size_t count = 0;
+    vector<Node*> todo;
+    if (root) todo.push_back(root);
+    while (!todo.empty() && count < limit) {
+        Node* n = todo.back();
+        todo.pop_back();
+        count++;
+        if (n->left) todo.push_back(n->left);
+        if (n->right) todo.push_back(n->right);
+    }
+    return count;
+}
+
+/**
+ * \brief Flattens a chain of the same binary operator into its operand list (e.g., a*(b*c) gives a, b, c).
+ * \param root The chain's root.
+ * \param op The operator ("*" or "+").
+ * \param operands Receives the operands in left-to-right order.
+ */
+void gatherOperands(Node* root, const string& op, vector<Node*>& operands) {
+    vector<Node*> todo{root};
+    while (!todo.empty()) {
+        Node* n = todo.back();
+        todo.pop_back();
+        if (n->value == op && n->left && n->right) {
+            todo.push_back(n->right);
+            todo.push_back(n->left);
+        } else {
+            operands.push_back(n);
+        }
+    }
+}
+
+/**
+ * \brief Builds a balanced tree of operator \p op over items[lo, hi), forking on large ranges.
+ * \param ctx The parallel context.
+ * \param op The operator.
+ * \param items The operands.
+ * \param lo First operand.
+ * \param hi One past the last operand.
+ * \return The root of the balanced tree.
+ */
+Node* buildBalanced(ParallelCNFContext& ctx, const string& op, const vector<Node*>& items, size_t lo, size_t hi) {
+    if (hi - lo == 1) return items[lo];
+    size_t mid = lo + (hi - lo) / 2;
+    Node* l = nullptr;
+    Node* r = nullptr;
+    if (hi - lo >= ctx.cutoff) {
+        ctx.pool.forkJoin([&] { l = buildBalanced(ctx, op, items, lo, mid); },
+                          [&] { r = buildBalanced(ctx, op, items, mid, hi); });
+    } else {
+        l = buildBalanced(ctx, op, items, lo, mid);
+        r = buildBalanced(ctx, op, items, mid, hi);
+    }
+    return ctx.node(op, l, r);
+}
+
+/**
+ * \brief Applies \p fn to every operand, splitting the operand range across tasks while the
+ * estimated work (bounded subtree sizes) is at least the cutoff.
+ * \param ctx The parallel context.
+ * \param operands The inputs.
+ * \param fn The per-operand transformation.
+ * \return The transformed operands, in order.
+ */
+vector<Node*> parallelMapOperands(ParallelCNFContext& ctx, const vector<Node*>& operands,
+                                  const function<Node*(Node*)>& fn) {
+    size_t n = operands.size();
+    vector<Node*> out(n);
+    vector<size_t> prefix(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + countNodesUpTo(operands[i], ctx.cutoff);
+
+    function<void(size_t, size_t)> apply = [&](size_t lo, size_t hi) {
+        if (hi - lo > 1 && prefix[hi] - prefix[lo] >= ctx.cutoff) {
+            size_t mid = lo + (hi - lo) / 2;
+            ctx.pool.forkJoin([&] { apply(lo, mid); }, [&] { apply(mid, hi); });
+            return;
+        }
+        for (size_t i = lo; i < hi; ++i) out[i] = fn(operands[i]);
+    };
+    apply(0, n);
+    return out;
+}
+
+/**
+ * \brief Parallel counterpart of \ref eliminateImplications.
+ *
+ * Builds a new tree (the input is not modified) in which A > B is replaced by ~A + B.
+ * Chains of * and + are flattened and rebuilt balanced, so the later passes can split them evenly.
+ * \param ctx The parallel context.
+ * \param root The input subtree.
+ * \return The new subtree.
+ */
+Node* parallelEliminateImplications(ParallelCNFContext& ctx, Node* root) {
+    if (!root || (!root->left && !root->right)) return root;
+    auto self = [&ctx](Node* n) { return parallelEliminateImplications(ctx, n); };
+
+    if (root->value == "~") return ctx.node("~", self(root->left));
+    if (root->value == ">") {
+        Node* l = nullptr;
+        Node* r = nullptr;
+        if (countNodesUpTo(root, ctx.cutoff) >= ctx.cutoff)
+            ctx.pool.forkJoin([&] { l = self(root->left); }, [&] { r = self(root->right); });
+        else {
+            l = self(root->left);
+            r = self(root->right);
+        }
+        return ctx.node("+", ctx.node("~", l), r);
+    }
+
+    vector<Node*> operands;
+    gatherOperands(root, root->value, operands);
+    vector<Node*> converted = parallelMapOperands(ctx, operands, self);
+    return buildBalanced(ctx, root->value, converted, 0, converted.size());
+}
+
+/**
+ * \brief Parallel counterpart of \ref moveNegations.
+ *
+ * Pushes negations down to the atoms in a single pass by carrying the polarity: under an odd
+ * number of negations * and + swap roles (De Morgan) and atoms are negated. The input must not
+ * contain implications.
+ * \param ctx The parallel context.
+ * \param root The input subtree.
+ * \param negated true if the subtree is under an odd number of negations.
+ * \return The new subtree in Negation Normal Form.
+ */
+Node* parallelMoveNegations(ParallelCNFContext& ctx, Node* root, bool negated = false) {
+    if (!root) return nullptr;
+    if (!root->left && !root->right) return negated ? ctx.node("~", root) : root;
+    if (root->value == "~") return parallelMoveNegations(ctx, root->left, !negated);
+
+    vector<Node*> operands;
+    gatherOperands(root, root->value, operands);
+    vector<Node*> converted = parallelMapOperands(ctx, operands, [&ctx, negated](Node* n) {
+        return parallelMoveNegations(ctx, n, negated);
+    });
+    string op = negated ? (root->value == "*" ? "+" : "*") : root->value;
+    return buildBalanced(ctx, op, converted, 0, converted.size());
+}
+
+/**
+ * \brief Distributes the disjunction of two CNF subtrees: (a1 * ... * am) + (b1 * ... * bn)
+ * becomes the conjunction of all (ai + bj).
+ *
+ * Rows of the m x n product are split across tasks when m * n reaches the cutoff. The new clauses
+ * share the ai and bj subtrees.
+ * \param ctx The parallel context.
+ * \param A The left CNF.
+ * \param B The right CNF.
+ * \return The CNF of A + B.
+ */
+Node* parallelDistributePair(ParallelCNFContext& ctx, Node* A, Node* B) {
+    vector<Node*> as, bs;
+    gatherOperands(A, "*", as);
+    gatherOperands(B, "*", bs);
+    size_t m = as.size(), n = bs.size();
+    vector<Node*> clauses(m * n);
+
+    function<void(size_t, size_t)> rows = [&](size_t lo, size_t hi) {
+        if (hi - lo > 1 && (hi - lo) * n >= ctx.cutoff) {
+            size_t mid = lo + (hi - lo) / 2;
+            ctx.pool.forkJoin([&] { rows(lo, mid); }, [&] { rows(mid, hi); });
+            return;
+        }
+        for (size_t i = lo; i < hi; ++i)
+            for (size_t j = 0; j < n; ++j) clauses[i * n + j] = ctx.node("+", as[i], bs[j]);
+    };
+    rows(0, m);
+    return buildBalanced(ctx, "*", clauses, 0, clauses.size());
+}
+
+/**
+ * \brief Parallel counterpart of \ref distributeOrOverAnd.
+ *
+ * Conjunctions are converted operand by operand. For a disjunction, each disjunct is converted
+ * to CNF and the results are combined pairwise with \ref parallelDistributePair in a balanced
+ * reduction; both halves of the reduction are forked when the product of their clause counts
+ * reaches the cutoff.
+ * \param ctx The parallel context.
+ * \param root The input subtree (in NNF).
+ * \return The CNF subtree.
+ */
+Node* parallelDistributeOrOverAnd(ParallelCNFContext& ctx, Node* root) {
+    if (!root || (!root->left && !root->right) || root->value == "~") return root;
+    auto self = [&ctx](Node* n) { return parallelDistributeOrOverAnd(ctx, n); };
+
+    vector<Node*> operands;
+    gatherOperands(root, root->value, operands);
+    vector<Node*> converted = parallelMapOperands(ctx, operands, self);
+    if (root->value == "*") return buildBalanced(ctx, "*", converted, 0, converted.size());
+
+    // Disjunction: clause counts of each converted disjunct
+    vector<size_t> clauseCount(converted.size());
+    for (size_t i = 0; i < converted.size(); ++i) {
+        vector<Node*> conj;
+        gatherOperands(converted[i], "*", conj);
+        clauseCount[i] = conj.size();
+    }
+    function<Node*(size_t, size_t)> reduce = [&](size_t lo, size_t hi) -> Node* {
+        if (hi - lo == 1) return converted[lo];
+        size_t mid = lo + (hi - lo) / 2;
+        // Clause count of the distributed range, saturated at the cutoff so it cannot overflow
+        size_t product = 1;
+        for (size_t i = lo; i < hi && product < ctx.cutoff; ++i) {
+            product = clauseCount[i] > ctx.cutoff / product ? ctx.cutoff : product * clauseCount[i];
+        }
+        Node* l = nullptr;
+        Node* r = nullptr;
+        if (product >= ctx.cutoff)
+            ctx.pool.forkJoin([&] { l = reduce(lo, mid); }, [&] { r = reduce(mid, hi); });
+        else {
+            l = reduce(lo, mid);
+            r = reduce(mid, hi);
+        }
+        return parallelDistributePair(ctx, l, r);
+    };
+    return reduce(0, converted.size());
+}
+
+/**
+ * \brief Converts a formula to CNF using task parallelism on a work-stealing pool.
+ *
+ * Runs the same three steps as \ref convertToCNF with their parallel counterparts. Unlike
+ * \ref convertToCNF the input tree is not modified. The result has the same clauses (as
+ * collected by \ref collectClauses) up to order; shared subtrees make it a DAG rather than a tree.
+ * \param root Pointer to the root Node of the original parse tree.
+ * \param numThreads Number of worker threads (including the calling thread).
+ * \param arenas Receives the arenas owning the new nodes; the result is valid while they live.
+ * \param cutoff Subtrees or products smaller than this are processed sequentially.
+ * \return Pointer to the root Node of the resulting CNF.
+ */
+Node* parallelConvertToCNF(Node* root, int numThreads, vector<NodeArena>& arenas, size_t cutoff = 4096) {
+    WorkStealingPool pool(numThreads);
+    arenas.resize(max<size_t>(arenas.size(), pool.size()));
+    ParallelCNFContext ctx{pool, max<size_t>(cutoff, 2), arenas};
+    Node* result = nullptr;
+    pool.run([&] {
+        Node* noImplications = parallelEliminateImplications(ctx, root);
+        Node* nnf = parallelMoveNegations(ctx, noImplications);
+        result = parallelDistributeOrOverAnd(ctx, nnf);
+    });
+    return result;
+}
+
+/* ---------------- END Parallel CNF Conversion ---------------- */
+
+/* ---------------- DRAT PROOF WRITER ---------------- */
+
+/**
+ * \struct DratProofWriter
+ * \brief Writes a binary DRAT proof through a buffered, asynchronous writer.
+ *
+ * Binary DRAT: every step is 'a' (addition) or 'd' (deletion), followed by the literals as
+ * variable-length integers (7 bits per byte, low bits first, high bit set on all but the last
+ * byte) and a terminating 0 byte. DIMACS literal x maps to 2|x| + (x < 0); for the integer
+ * literals of \ref ClauseDB (2*var + sign, var from 0) that is simply lit + 2.
+ *
+ * Steps are encoded into a buffer on the solver thread; full buffers are handed to a background
+ * thread that writes them to disk, so the solver never waits for I/O unless the writer falls
+ * more than a few buffers behind.
+ */
+struct DratProofWriter {
+    static const size_t MAX_PENDING = 4;   /**< Full buffers queued before the producer blocks. */
+
+    FILE* file = nullptr;                  /**< The proof file. */
+    vector<uint8_t> buffer;                /**< Buffer being filled by the solver. */
+    size_t bufferBytes = 1 << 20;          /**< Size at which a buffer is handed to the writer thread. */
+    deque<vector<uint8_t>> pending;        /**< Full buffers waiting to be written. */
+    mutex lock;                            /**< Guards \ref pending and \ref closing. */
+    condition_variable changed;            /**< Signals new buffers, free queue slots and shutdown. */
+    bool closing = false;                  /**< Set by \ref close to stop the writer thread. */
+    bool failed = false;                   /**< A write to the file failed. */
+    thread writer;                         /**< Background writer thread. */
+    uint64_t additions = 0, deletions = 0; /**< Steps written. */
+    uint64_t bytes = 0;                    /**< Encoded proof size. */
+
+    DratProofWriter() = default;
+    DratProofWriter(const DratProofWriter&) = delete;
+    DratProofWriter& operator=(const DratProofWriter&) = delete;
+    ~DratProofWriter() { close(); }
+
+    /**
+     * \brief Opens the proof file and starts the writer thread.
+     * \param path Output path.
+     * \param bufferSize Buffer size in bytes.
+     * \return false if the file could not be created.
+     */
+    bool open(const string& path, size_t bufferSize = 1 << 20) {
+        file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        bufferBytes = max<size_t>(bufferSize, 64);
+        buffer.reserve(bufferBytes + 64);
+        closing = false;
+        writer = thread([this] { writeLoop(); });
+        return true;
+    }
+
+    /** \brief Writer thread: writes queued buffers until closed and drained. */
+    void writeLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [&] { return closing || !pending.empty(); });
+            if (pending.empty()) return; // closing and drained
+            vector<uint8_t> data = std::move(pending.front());
+            pending.pop_front();
+            changed.notify_all();
+            guard.unlock();
+            if (fwrite(data.data(), 1, data.size(), file) != data.size()) failed = true;
+            guard.lock();
+        }
+    }
+
+    /** \brief Hands the current buffer to the writer thread. */
+    void handOff() {
+        if (buffer.empty()) return;
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] { return pending.size() < MAX_PENDING; });
+        pending.push_back(std::move(buffer));
+        buffer = vector<uint8_t>();
+        buffer.reserve(bufferBytes + 64);
+        changed.notify_all();
+    }
+
+    /** \brief Encodes one proof step. */
+    void step(uint8_t kind, const int* lits, int size) {
+        buffer.push_back(kind);
+        for (int i = 0; i < size; ++i) {
+            unsigned u = (unsigned)lits[i] + 2;
+            while (u > 127) {
+                buffer.push_back((uint8_t)(u | 128));
+                u >>= 7;
+            }
+            buffer.push_back((uint8_t)u);
+        }
+        buffer.push_back(0);
+        if (buffer.size() >= bufferBytes) {
+            bytes += buffer.size();
+            handOff();
+        }
+    }
+
+    /** \brief Logs the addition of a clause (the empty clause when \p size is 0). */
+    void add(const int* lits, int size) {
+        additions++;
+        step('a', lits, size);
+    }
+
+    /** \brief Logs the deletion of a clause. */
+    void remove(const int* lits, int size) {
+        deletions++;
+        step('d', lits, size);
+    }
+
+    /** \brief Flushes all steps, stops the writer thread and closes the file. */
+    void close() {
+        if (!file) return;
+        bytes += buffer.size();
+        handOff();
+        {
+            lock_guard<mutex> guard(lock);
+            closing = true;
+        }
+        changed.notify_all();
+        writer.join();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+/* ---------------- END DRAT Proof Writer ---------------- */
+
+/* ---------------- CDCL SAT SOLVER ---------------- */
+
+/**
+ * \struct XorShiftRandom
+ * \brief A fast xorshift64* pseudo-random number generator.
+ */
+struct XorShiftRandom {
+    /** \var state \brief Generator state (never zero). */
+    uint64_t state;
+
+    /** \brief Seeds the generator. */
+    explicit XorShiftRandom(uint64_t seed = 88172645463325252ULL) : state(seed ? seed : 88172645463325252ULL) {}
+
+    /** \brief Returns the next 64-bit value. */
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+
+    /** \brief Returns a value in [0, bound). */
+    uint32_t below(uint32_t bound) { return (uint32_t)(((next() >> 32) * (uint64_t)bound) >> 32); }
+
+    /** \brief Returns a double in [0, 1). */
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+/**
+ * \brief Outcome of a satisfiability check.
+ */
+enum class SolveResult { SAT, UNSAT, UNKNOWN };
+
+/**
+ * \brief Returns "SAT", "UNSAT" or "UNKNOWN".
+ * \param result The solver outcome.
+ * \return Its name.
+ */
+string solveResultName(SolveResult result) {
+    if (result == SolveResult::SAT) return "SAT";
+    if (result == SolveResult::UNSAT) return "UNSAT";
+    return "UNKNOWN";
+}
+
+/**
+ * \struct SolverOptions
+ * \brief Tunable parameters of \ref CDCLSolver.
+ */
+struct SolverOptions {
+    bool glucoseRestarts = true;   /**< true: restart on LBD moving averages (Glucose); false: Luby sequence. */
+    int lubyUnit = 100;            /**< Conflicts per Luby unit. */
+    double varDecay = 0.95;        /**< EVSIDS decay factor. */
+    double clauseDecay = 0.999;    /**< Learnt clause activity decay factor. */
+    bool defaultPhase = false;     /**< Initial saved phase of every variable. */
+    int firstReduce = 2000;        /**< Conflicts before the first learnt clause reduction. */
+    int reduceIncrement = 300;     /**< Growth of the reduction interval after each reduction. */
+    long long conflictBudget = -1; /**< Stop with UNKNOWN after this many conflicts (-1: no limit). */
+    uint64_t seed = 0;             /**< Non-zero: randomize initial activities (used to diversify portfolio workers). */
+};
+
+/**
+ * \struct SolverStats
+ * \brief Counters collected by \ref CDCLSolver.
+ */
+struct SolverStats {
+    uint64_t decisions = 0;    /**< Decision literals picked. */
+    uint64_t propagations = 0; /**< Literals propagated (trail entries processed). */
+    uint64_t conflicts = 0;    /**< Conflicts analyzed. */
+    uint64_t restarts = 0;     /**< Restarts performed. */
+    uint64_t reductions = 0;   /**< Learnt clause database reductions. */
+    uint64_t learnt = 0;       /**< Clauses learnt in total. */
+    uint64_t deleted = 0;      /**< Learnt clauses deleted by reductions. */
+};
+
+/**
+ * \struct VarOrderHeap
+ * \brief Binary max-heap of variables ordered by VSIDS activity.
+ */
+struct VarOrderHeap {
+    /** \var activity \brief Activity of every variable (owned by the solver). */
+    const vector<double>* activity = nullptr;
+    /** \var heap \brief The heap array of variables. */
+    vector<int> heap;
+    /** \var position \brief position[v] is v's index in \p heap, or -1 if absent. */
+    vector<int> position;
+
+    /** \brief true if variable \p a has higher priority than \p b. */
+    bool before(int a, int b) const { return (*activity)[a] > (*activity)[b]; }
+
+    /** \brief Moves the entry at index i towards the root. */
+    void siftUp(int i) {
+        int v = heap[i];
+        while (i > 0) {
+            int parent = (i - 1) >> 1;
+            if (!before(v, heap[parent])) break;
+            heap[i] = heap[parent];
+            position[heap[i]] = i;
+            i = parent;
+        }
+        heap[i] = v;
+        position[v] = i;
+    }
+
+    /** \brief Moves the entry at index i towards the leaves. */
+    void siftDown(int i) {
+        int v = heap[i];
+        int n = (int)heap.size();
+        while (true) {
+            int child = 2 * i + 1;
+            if (child >= n) break;
+            if (child + 1 < n && before(heap[child + 1], heap[child])) child++;
+            if (!before(heap[child], v)) break;
+            heap[i] = heap[child];
+            position[heap[i]] = i;
+            i = child;
+        }
+        heap[i] = v;
+        position[v] = i;
+    }
+
+    /** \brief true if v is in the heap. */
+    bool contains(int v) const { return position[v] >= 0; }
+
+    /** \brief Inserts v (no effect if present). */
+    void insert(int v) {
+        if (contains(v)) return;
+        position[v] = (int)heap.size();
+        heap.push_back(v);
+        siftUp(position[v]);
+    }
+
+    /** \brief Restores the heap order after v's activity increased. */
+    void increased(int v) {
+        if (contains(v)) siftUp(position[v]);
+    }
+
+    /** \brief Restores the heap order after v's activity decreased. */
+    void decreased(int v) {
+        if (contains(v)) siftDown(position[v]);
+    }
+
+    /** \brief Removes and returns the variable with the highest activity. */
+    int pop() {
+        int top = heap[0];
+        heap[0] = heap.back();
+        position[heap[0]] = 0;
+        heap.pop_back();
+        position[top] = -1;
+        if (!heap.empty()) siftDown(0);
+        return top;
+    }
+};
+
+/**
+ * \struct CDCLSolver
+ * \brief A conflict-driven clause-learning SAT solver over integer literals.
+ *
+ * Clauses live in one flat arena (a 3-word header followed by the literals) and are referenced
+ * by their offset. The solver implements two-watched-literal propagation with blocker literals,
+ * first-UIP conflict analysis with clause minimization, EVSIDS decision heuristic, phase saving,
+ * Luby or Glucose-style restarts, and periodic reduction of learnt clauses by LBD (literal block
+ * distance, the number of decision levels in a clause).
+ */
+struct CDCLSolver {
+    /** \brief Watch list entry: a clause and a literal of it that, when true, satisfies it. */
+    struct Watcher {
+        int cref;    /**< Clause reference (arena offset). */
+        int blocker; /**< Some other literal of the clause. */
+    };
+
+    /** \var HEADER \brief Words before the literals of a clause: size, flags | lbd << 2, activity. */
+    static const int HEADER = 3;
+
+    SolverOptions options;            /**< Configuration. */
+    SolverStats stats;                /**< Counters. */
+    int numVars = 0;                  /**< Number of variables. */
+    bool ok = true;                   /**< false once the clauses are known to be unsatisfiable. */
+
+    vector<int> arena;                /**< Clause memory. */
+    vector<int> originals;            /**< References of problem clauses. */
+    vector<int> learnts;              /**< References of learnt clauses. */
+    size_t wasted = 0;                /**< Arena words held by deleted clauses. */
+    vector<vector<Watcher>> watches;  /**< watches[p]: clauses watching ~p, visited when p becomes true. */
+
+    vector<int8_t> value;             /**< value[lit]: 1 true, -1 false, 0 unassigned. */
+    vector<int> level;                /**< Decision level of each assigned variable. */
+    vector<int> reason;               /**< Reason clause of each propagated variable, or -1. */
+    vector<int> trail;                /**< Assigned literals in assignment order. */
+    vector<int> trailLimits;          /**< Trail size at the start of each decision level. */
+    size_t qhead = 0;                 /**< Next trail position to propagate. */
+
+    vector<double> activity;          /**< VSIDS activity of each variable. */
+    double varIncrement = 1.0;        /**< Current EVSIDS bump amount. */
+    double clauseIncrement = 1.0;     /**< Current clause activity bump amount. */
+    VarOrderHeap order;               /**< Unassigned variables by activity. */
+    vector<char> savedNegated;        /**< Phase saving: last polarity of each variable. */
+
+    vector<char> seen;                /**< Scratch marks for conflict analysis. */
+    vector<int> analyzeStack;         /**< Scratch stack for clause minimization. */
+    vector<int> analyzeClear;         /**< Variables whose \p seen mark must be cleared. */
+    vector<uint32_t> levelStamp;      /**< Scratch stamps for LBD computation. */
+    uint32_t stamp = 0;               /**< Current LBD stamp. */
+
+    double lbdFast = 0, lbdSlow = 0;  /**< Moving averages of learnt LBD (Glucose restarts), started at 0. */
+    double fastWeight = 1, slowWeight = 1; /**< (1-alpha)^n of each average, for its start-up bias correction. */
+    uint64_t conflictsAtRestart = 0;  /**< Conflict count at the last restart. */
+    uint64_t restartLimit = 0;        /**< Conflict count of the next Luby restart. */
+    uint64_t nextReduce = 0;          /**< Conflict count of the next reduction. */
+
+    vector<char> model;               /**< Satisfying assignment (model[v] is v's value) after SAT. */
+    vector<int> failedAssumptions;    /**< After UNSAT under assumptions: a subset of them that is already inconsistent. */
+
+    const atomic<bool>* terminate = nullptr;                 /**< Optional external stop flag, polled by \ref solve. */
+    function<void(const vector<int>&, int)> exportClause;    /**< Optional: called with every learnt clause and its LBD. */
+    function<void(CDCLSolver&)> importClauses;               /**< Optional: called at every restart (decision level 0). */
+    DratProofWriter* proof = nullptr;                        /**< Optional: receives learnt and deleted clauses (DRAT). */
+    bool emptyClauseLogged = false;                          /**< The empty clause has been written to \ref proof. */
+
+    /**
+     * \brief Creates a solver for \p n variables and no clauses.
+     * \param n Number of variables.
+     * \param opts Solver options.
+     */
+    explicit CDCLSolver(int n = 0, const SolverOptions& opts = SolverOptions()) : options(opts) {
+        order.activity = &activity;
+        growTo(n);
+        nextReduce = options.firstReduce;
+        if (options.seed != 0) {
+            XorShiftRandom rng(options.seed);
+            for (int v = 0; v < numVars; ++v) {
+                activity[v] = rng.uniform() * 1e-5;
+                order.increased(v);
+            }
+        }
+    }
+
+    /**
+     * \brief Creates a solver loaded with the clauses of a clause database.
+     * \param db The clause database.
+     * \param opts Solver options.
+     */
+    CDCLSolver(const ClauseDB& db, const SolverOptions& opts) : CDCLSolver(db.numVars, opts) {
+        for (const auto& clause : db.clauses) {
+            if (!addClause(clause)) break;
+        }
+    }
+
+    /** \brief Adds variables so that there are at least \p n. */
+    void growTo(int n) {
+        if (n <= numVars) return;
+        numVars = n;
+        watches.resize(2 * (size_t)n);
+        value.resize(2 * (size_t)n, 0);
+        level.resize(n, 0);
+        reason.resize(n, -1);
+        activity.resize(n, 0.0);
+        savedNegated.resize(n, options.defaultPhase ? 0 : 1);
+        seen.resize(n, 0);
+        levelStamp.resize(n + 1, 0);
+        order.position.resize(n, -1);
+        for (int v = 0; v < n; ++v) {
+            if (value[makeLiteral(v, false)] == 0) order.insert(v);
+        }
+    }
+
+    // ----- clause arena -----
+
+    /** \brief Number of literals of clause \p cref. */
+    int clauseSize(int cref) const { return arena[cref]; }
+    /** \brief Pointer to the literals of clause \p cref (invalidated by arena growth). */
+    int* clauseLits(int cref) { return &arena[cref + HEADER]; }
+    /** \brief true if clause \p cref is learnt. */
+    bool isLearnt(int cref) const { return arena[cref + 1] & 1; }
+    /** \brief true if clause \p cref was deleted. */
+    bool isDeleted(int cref) const { return arena[cref + 1] & 2; }
+    /** \brief LBD of clause \p cref. */
+    int clauseLBD(int cref) const { return arena[cref + 1] >> 2; }
+    /** \brief Activity of clause \p cref. */
+    float& clauseActivity(int cref) { return *reinterpret_cast<float*>(&arena[cref + 2]); }
+
+    /** \brief Copies a clause into the arena and returns its reference. */
+    int allocClause(const vector<int>& lits, bool learnt, int lbd) {
+        int cref = (int)arena.size();
+        arena.push_back((int)lits.size());
+        arena.push_back((learnt ? 1 : 0) | (lbd << 2));
+        arena.push_back(0);
+        clauseActivity(cref) = 0.0f;
+        arena.insert(arena.end(), lits.begin(), lits.end());
+        return cref;
+    }
+
+    /** \brief Registers the first two literals of a clause as its watches. */
+    void attachClause(int cref) {
+        int* c = clauseLits(cref);
+        watches[negateLiteral(c[0])].push_back({cref, c[1]});
+        watches[negateLiteral(c[1])].push_back({cref, c[0]});
+    }
+
+    /** \brief true if clause \p cref is the reason of a current assignment. */
+    bool isLocked(int cref) {
+        int first = clauseLits(cref)[0];
+        return value[first] == 1 && reason[literalVar(first)] == cref;
+    }
+
+    /**
+     * \brief Compacts the arena, dropping deleted clauses, and rebuilds the watch lists.
+     */
+    void collectGarbage() {
+        vector<int> fresh;
+        fresh.reserve(arena.size() - wasted);
+        auto relocate = [&](vector<int>& refs) {
+            size_t keep = 0;
+            for (int cref : refs) {
+                if (isDeleted(cref)) continue;
+                int moved = (int)fresh.size();
+                fresh.insert(fresh.end(), arena.begin() + cref, arena.begin() + cref + HEADER + clauseSize(cref));
+                arena[cref + 2] = moved; // forwarding address for reasons
+                refs[keep++] = moved;
+            }
+            refs.resize(keep);
+        };
+        // Reasons must be translated before the old arena is dropped
+        vector<int> reasonVars;
+        for (int lit : trail) {
+            if (reason[literalVar(lit)] >= 0) reasonVars.push_back(literalVar(lit));
+        }
+        relocate(originals);
+        relocate(learnts);
+        for (int v : reasonVars) reason[v] = arena[reason[v] + 2];
+        arena.swap(fresh);
+        wasted = 0;
+
+        for (auto& ws : watches) ws.clear();
+        for (int cref : originals) attachClause(cref);
+        for (int cref : learnts) attachClause(cref);
+    }
+
+    // ----- assignment -----
+
+    /** \brief Current decision level. */
+    int decisionLevel() const { return (int)trailLimits.size(); }
+
+    /** \brief Assigns \p lit true with the given reason clause (-1 for decisions and units). */
+    void enqueue(int lit, int from) {
+        int v = literalVar(lit);
+        value[lit] = 1;
+        value[negateLiteral(lit)] = -1;
+        level[v] = decisionLevel();
+        reason[v] = from;
+        trail.push_back(lit);
+    }
+
+    /** \brief Undoes all assignments above decision level \p target, saving their phases. */
+    void cancelUntil(int target) {
+        if (decisionLevel() <= target) return;
+        for (int i = (int)trail.size() - 1; i >= trailLimits[target]; --i) {
+            int lit = trail[i];
+            int v = literalVar(lit);
+            value[lit] = 0;
+            value[negateLiteral(lit)] = 0;
+            reason[v] = -1;
+            savedNegated[v] = literalIsNegated(lit);
+            order.insert(v);
+        }
+        trail.resize(trailLimits[target]);
+        trailLimits.resize(target);
+        qhead = trail.size();
+    }
+
+    /**
+     * \brief Unit propagation with two watched literals.
+     * \return The reference of a conflicting clause, or -1 if no conflict occurred.
+     */
+    int propagate() {
+        int conflict = -1;
+        while (qhead < trail.size()) {
+            int p = trail[qhead++];
+            int falseLit = negateLiteral(p);
+            vector<Watcher>& ws = watches[p];
+            stats.propagations++;
+
+            size_t i = 0, j = 0, n = ws.size();
+            while (i < n) {
+                Watcher w = ws[i];
+                if (value[w.blocker] == 1) {
+                    ws[j++] = ws[i++];
+                    continue;
+                }
+                int cref = w.cref;
+                int* c = clauseLits(cref);
+                if (c[0] == falseLit) swap(c[0], c[1]);
+                i++;
+
+                int first = c[0];
+                Watcher kept{cref, first};
+                if (first != w.blocker && value[first] == 1) {
+                    ws[j++] = kept;
+                    continue;
+                }
+
+                // Look for a new literal to watch
+                int size = clauseSize(cref);
+                bool moved = false;
+                for (int k = 2; k < size; ++k) {
+                    if (value[c[k]] != -1) {
+                        c[1] = c[k];
+                        c[k] = falseLit;
+                        watches[negateLiteral(c[1])].push_back(kept);
+                        moved = true;
+                        break;
+                    }
+                }
+                if (moved) continue;
+
+                ws[j++] = kept;
+                if (value[first] == -1) {
+                    conflict = cref;
+                    qhead = trail.size();
+                    while (i < n) ws[j++] = ws[i++];
+                } else {
+                    enqueue(first, cref);
+                }
+            }
+            ws.resize(j);
+            if (conflict >= 0) break;
+        }
+        return conflict;
+    }
+
+    // ----- heuristics -----
+
+    /** \brief EVSIDS bump of variable v. */
+    void bumpVariable(int v) {
+        if ((activity[v] += varIncrement) > 1e100) {
+            for (double& a : activity) a *= 1e-100;
+            varIncrement *= 1e-100;
+        }
+        order.increased(v);
+    }
+
+    /** \brief Bumps the activity of a learnt clause. */
+    void bumpClause(int cref) {
+        if ((clauseActivity(cref) += (float)clauseIncrement) > 1e20f) {
+            for (int c : learnts) clauseActivity(c) *= 1e-20f;
+            clauseIncrement *= 1e-20;
+        }
+    }
+
+    /** \brief Computes the LBD (number of distinct decision levels) of a set of literals. */
+    int computeLBD(const int* lits, int size) {
+        if (++stamp == 0) {
+            fill(levelStamp.begin(), levelStamp.end(), 0);
+            stamp = 1;
+        }
+        int lbd = 0;
+        for (int i = 0; i < size; ++i) {
+            int l = level[literalVar(lits[i])];
+            if (levelStamp[l] != stamp) {
+                levelStamp[l] = stamp;
+                lbd++;
+            }
+        }
+        return lbd;
+    }
+
+    /**
+     * \brief true if literal p of the learnt clause is implied by the other marked literals
+     * (recursive clause minimization).
+     */
+    bool isRedundant(int p) {
+        analyzeStack.clear();
+        analyzeStack.push_back(p);
+        size_t top = analyzeClear.size();
+        while (!analyzeStack.empty()) {
+            int q = analyzeStack.back();
+            analyzeStack.pop_back();
+            int cref = reason[literalVar(q)];
+            int* c = clauseLits(cref);
+            int size = clauseSize(cref);
+            for (int i = 1; i < size; ++i) {
+                int v = literalVar(c[i]);
+                if (seen[v] || level[v] == 0) continue;
+                if (reason[v] < 0) {
+                    for (size_t k = top; k < analyzeClear.size(); ++k) seen[analyzeClear[k]] = 0;
+                    analyzeClear.resize(top);
+                    return false;
+                }
+                seen[v] = 1;
+                analyzeStack.push_back(c[i]);
+                analyzeClear.push_back(v);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief First-UIP conflict analysis.
+     * \param conflict The conflicting clause.
+     * \param learnt Receives the learnt clause; learnt[0] is the asserting literal and learnt[1]
+     * (if any) has the highest decision level among the rest.
+     * \param backtrackLevel Receives the level to backtrack to.
+     */
+    void analyze(int conflict, vector<int>& learnt, int& backtrackLevel) {
+        learnt.clear();
+        learnt.push_back(-1);
+        int pathCount = 0;
+        int p = -1;
+        int index = (int)trail.size() - 1;
+
+        do {
+            if (isLearnt(conflict)) bumpClause(conflict);
+            int* c = clauseLits(conflict);
+            int size = clauseSize(conflict);
+            for (int j = (p == -1 ? 0 : 1); j < size; ++j) {
+                int q = c[j];
+                int v = literalVar(q);
+                if (seen[v] || level[v] == 0) continue;
+                bumpVariable(v);
+                seen[v] = 1;
+                if (level[v] >= decisionLevel()) pathCount++;
+                else learnt.push_back(q);
+            }
+            while (!seen[literalVar(trail[index--])]) {}
+            p = trail[index + 1];
+            conflict = reason[literalVar(p)];
+            seen[literalVar(p)] = 0;
+            pathCount--;
+        } while (pathCount > 0);
+        learnt[0] = negateLiteral(p);
+
+        // Minimize: drop literals implied by the others
+        analyzeClear.clear();
+        for (size_t i = 1; i < learnt.size(); ++i) analyzeClear.push_back(literalVar(learnt[i]));
+        size_t keep = 1;
+        for (size_t i = 1; i < learnt.size(); ++i) {
+            if (reason[literalVar(learnt[i])] < 0 || !isRedundant(learnt[i])) learnt[keep++] = learnt[i];
+        }
+        learnt.resize(keep);
+        for (int v : analyzeClear) seen[v] = 0;
+
+        backtrackLevel = 0;
+        if (learnt.size() > 1) {
+            size_t maxIndex = 1;
+            for (size_t i = 2; i < learnt.size(); ++i) {
+                if (level[literalVar(learnt[i])] > level[literalVar(learnt[maxIndex])]) maxIndex = i;
+            }
+            swap(learnt[1], learnt[maxIndex]);
+            backtrackLevel = level[literalVar(learnt[1])];
+        }
+    }
+
+    /** \brief Picks the unassigned variable with the highest activity, using its saved phase. */
+    int pickBranchLiteral() {
+        while (!order.heap.empty()) {
+            int v = order.pop();
+            if (value[makeLiteral(v, false)] == 0) return makeLiteral(v, savedNegated[v]);
+        }
+        return -1;
+    }
+
+    /** \brief The i-th element (0-based) of the Luby sequence 1,1,2,1,1,2,4,... */
+    static double luby(uint64_t i) {
+        uint64_t size = 1;
+        int seq = 0;
+        while (size < i + 1) {
+            seq++;
+            size = 2 * size + 1;
+        }
+        while (size - 1 != i) {
+            size = (size - 1) >> 1;
+            seq--;
+            i = i % size;
+        }
+        return pow(2.0, seq);
+    }
+
+    /** \brief true if the restart policy asks for a restart now. */
+    bool shouldRestart() {
+        uint64_t sinceRestart = stats.conflicts - conflictsAtRestart;
+        if (options.glucoseRestarts) {
+            // Both averages start at 0: divide by 1-(1-alpha)^n, or the slow one lags for thousands of conflicts
+            if (sinceRestart < 50 || stats.learnt < 50) return false;
+            return lbdFast / (1 - fastWeight) > 1.25 * lbdSlow / (1 - slowWeight);
+        }
+        return stats.conflicts >= restartLimit;
+    }
+
+    /** \brief Restarts the search, keeping learnt clauses, activities and saved phases. */
+    void restart() {
+        stats.restarts++;
+        conflictsAtRestart = stats.conflicts;
+        restartLimit = stats.conflicts + (uint64_t)(luby(stats.restarts) * options.lubyUnit);
+        cancelUntil(0);
+        if (importClauses) importClauses(*this);
+    }
+
+    /**
+     * \brief Deletes about half of the learnt clauses, keeping glue clauses (LBD <= 2), locked
+     * clauses, and those with the lowest LBD and highest activity.
+     */
+    void reduceLearnts() {
+        stats.reductions++;
+        sort(learnts.begin(), learnts.end(), [&](int a, int b) {
+            if (clauseLBD(a) != clauseLBD(b)) return clauseLBD(a) > clauseLBD(b);
+            return clauseActivity(a) < clauseActivity(b);
+        });
+        size_t target = learnts.size() / 2;
+        for (size_t i = 0; i < target; ++i) {
+            int cref = learnts[i];
+            if (clauseLBD(cref) <= 2 || isLocked(cref)) continue;
+            if (proof) proof->remove(clauseLits(cref), clauseSize(cref));
+            arena[cref + 1] |= 2;
+            wasted += HEADER + clauseSize(cref);
+            stats.deleted++;
+        }
+        collectGarbage();
+    }
+
+    /** \brief Writes the empty clause to \ref proof, once. */
+    void logEmptyClause() {
+        if (!proof || emptyClauseLogged) return;
+        proof->add(nullptr, 0);
+        emptyClauseLogged = true;
+    }
+
+    // ----- interface -----
+
+    /**
+     * \brief Adds a clause at decision level 0.
+     *
+     * The clause is normalized: duplicate literals and literals already false are dropped, and a
+     * satisfied or tautological clause is ignored. Variables are added as needed.
+     * \param lits The literals.
+     * \return false if the solver's clauses became unsatisfiable.
+     */
+    bool addClause(vector<int> lits) {
+        if (!ok) return false;
+        cancelUntil(0);
+        for (int lit : lits) growTo(literalVar(lit) + 1);
+        sort(lits.begin(), lits.end());
+        size_t keep = 0;
+        for (size_t i = 0; i < lits.size(); ++i) {
+            int lit = lits[i];
+            if (value[lit] == 1 || (i > 0 && lit == negateLiteral(lits[i - 1]))) return true; // satisfied/tautology
+            if (value[lit] == -1 || (keep > 0 && lits[keep - 1] == lit)) continue;
+            lits[keep++] = lit;
+        }
+        lits.resize(keep);
+
+        if (lits.size() <= 1) {
+            if (!lits.empty()) {
+                enqueue(lits[0], -1);
+                ok = (propagate() < 0);
+            } else {
+                ok = false;
+            }
+            if (!ok) logEmptyClause();
+            return ok;
+        }
+        int cref = allocClause(lits, false, 0);
+        originals.push_back(cref);
+        attachClause(cref);
+        return true;
+    }
+
+    /**
+     * \brief Adds a learnt clause received from another solver at decision level 0.
+     *
+     * Literals false at level 0 are dropped and satisfied clauses are ignored. The clause is
+     * treated like a learnt clause of this solver, so it may later be removed by \ref reduceLearnts.
+     * Imported clauses are not logged to \ref proof, so proofs are only complete without sharing.
+     * \param lits The clause.
+     * \param lbd Its LBD in the exporting solver.
+     * \return false if the clause made the problem unsatisfiable.
+     */
+    bool importLearntClause(const vector<int>& lits, int lbd) {
+        if (!ok) return false;
+        vector<int> clause;
+        for (int lit : lits) {
+            if (literalVar(lit) >= numVars || value[lit] == 1) return true;
+            if (value[lit] == 0) clause.push_back(lit);
+        }
+        if (clause.empty()) return ok = false;
+        if (clause.size() == 1) {
+            enqueue(clause[0], -1);
+            return true; // propagated by the search loop
+        }
+        int cref = allocClause(clause, true, max(1, min(lbd, (int)clause.size())));
+        learnts.push_back(cref);
+        attachClause(cref);
+        return true;
+    }
+
+    /**
+     * \brief Opens a new decision level, assigns \p lit and propagates.
+     *
+     * Used by lookahead to probe literals; undo with cancelUntil(decisionLevel() - 1).
+     * \param lit The literal to assign (must be unassigned).
+     * \return The conflicting clause, or -1.
+     */
+    int decideAndPropagate(int lit) {
+        trailLimits.push_back((int)trail.size());
+        enqueue(lit, -1);
+        return propagate();
+    }
+
+    /**
+     * \brief Collects the assumptions responsible for assumption \p p being false.
+     *
+     * Walks the trail backwards from ~p through the reason clauses; every decision reached is an
+     * assumption (assumptions are the only decisions below their levels).
+     * \param p A falsified assumption literal.
+     */
+    void analyzeFinal(int p) {
+        failedAssumptions.assign(1, p);
+        if (decisionLevel() == 0) return;
+        seen[literalVar(p)] = 1;
+        for (int i = (int)trail.size() - 1; i >= trailLimits[0]; --i) {
+            int v = literalVar(trail[i]);
+            if (!seen[v]) continue;
+            if (reason[v] < 0) {
+                failedAssumptions.push_back(trail[i]);
+            } else {
+                int* c = clauseLits(reason[v]);
+                int size = clauseSize(reason[v]);
+                for (int k = 1; k < size; ++k) {
+                    if (level[literalVar(c[k])] > 0) seen[literalVar(c[k])] = 1;
+                }
+            }
+            seen[v] = 0;
+        }
+        seen[literalVar(p)] = 0;
+    }
+
+    /**
+     * \brief Runs the CDCL search.
+     * \return SAT (with \ref model filled), UNSAT, or UNKNOWN if the conflict budget ran out or
+     * \ref terminate was set.
+     */
+    SolveResult solve() { return solve(vector<int>()); }
+
+    /**
+     * \brief Runs the CDCL search under assumptions.
+     *
+     * The assumption literals are taken as the first decisions (one per decision level). UNSAT
+     * then means "unsatisfiable under these assumptions"; learnt clauses, activities and saved
+     * phases are kept, so repeated calls with different assumptions are incremental. If the
+     * assumptions themselves are contradictory, \ref failedAssumptions receives a subset of them
+     * that is already inconsistent with the clauses (empty if the clauses alone are UNSAT).
+     * \param assumptions Literals assumed true for this call only.
+     * \return SAT (with \ref model filled), UNSAT, or UNKNOWN if the conflict budget ran out or
+     * \ref terminate was set.
+     */
+    SolveResult solve(const vector<int>& assumptions) {
+        model.clear();
+        failedAssumptions.clear();
+        for (int lit : assumptions) growTo(literalVar(lit) + 1);
+        if (!ok) {
+            logEmptyClause(); // refuted while loading, possibly before the proof was attached
+            return SolveResult::UNSAT;
+        }
+        cancelUntil(0);
+        long long budgetEnd = options.conflictBudget < 0 ? -1 : (long long)stats.conflicts + options.conflictBudget;
+        if (restartLimit == 0) restartLimit = (uint64_t)options.lubyUnit;
+        vector<int> learnt;
+
+        while (true) {
+            if (terminate && terminate->load(memory_order_relaxed)) {
+                cancelUntil(0);
+                return SolveResult::UNKNOWN;
+            }
+            int conflict = propagate();
+            if (conflict >= 0) {
+                stats.conflicts++;
+                if (decisionLevel() == 0) {
+                    ok = false;
+                    logEmptyClause();
+                    return SolveResult::UNSAT;
+                }
+                int backtrackLevel;
+                analyze(conflict, learnt, backtrackLevel);
+                if (proof) proof->add(learnt.data(), (int)learnt.size());
+                int lbd = computeLBD(learnt.data(), (int)learnt.size());
+                cancelUntil(backtrackLevel);
+                if (learnt.size() == 1) {
+                    enqueue(learnt[0], -1);
+                } else {
+                    int cref = allocClause(learnt, true, lbd);
+                    learnts.push_back(cref);
+                    attachClause(cref);
+                    bumpClause(cref);
+                    enqueue(learnt[0], cref);
+                }
+                stats.learnt++;
+                if (exportClause) exportClause(learnt, lbd);
+                lbdFast += (lbd - lbdFast) / 32.0;
+                lbdSlow += (lbd - lbdSlow) / 4096.0;
+                fastWeight *= 1 - 1 / 32.0;
+                slowWeight *= 1 - 1 / 4096.0;
+                varIncrement /= options.varDecay;
+                clauseIncrement /= options.clauseDecay;
+                if (budgetEnd >= 0 && (long long)stats.conflicts >= budgetEnd) {
+                    cancelUntil(0);
+                    return SolveResult::UNKNOWN;
+                }
+                continue;
+            }
+
+            if (shouldRestart()) {
+                restart();
+                continue;
+            }
+            if (stats.conflicts >= nextReduce) {
+                nextReduce = stats.conflicts + options.firstReduce + options.reduceIncrement * (stats.reductions + 1);
+                reduceLearnts();
+            }
+
+            int next = -1;
+            while (decisionLevel() < (int)assumptions.size()) {
+                int p = assumptions[decisionLevel()];
+                if (value[p] == 1) {
+                    trailLimits.push_back((int)trail.size()); // already true: empty decision level
+                } else if (value[p] == -1) {
+                    analyzeFinal(p);
+                    cancelUntil(0);
+                    return SolveResult::UNSAT; // the assumptions contradict the clauses
+                } else {
+                    next = p;
+                    break;
+                }
+            }
+            if (next < 0) next = pickBranchLiteral();
+            if (next < 0) {
+                model.assign(numVars, 0);
+                for (int v = 0; v < numVars; ++v) model[v] = (value[makeLiteral(v, false)] == 1);
+                cancelUntil(0);
+                return SolveResult::SAT;
+            }
+            stats.decisions++;
+            trailLimits.push_back((int)trail.size());
+            enqueue(next, -1);
+        }
+    }
+};
+
+/**
+ * \brief Checks that an assignment satisfies every clause of a database.
+ * \param db The clause database.
+ * \param model model[v] is the value of variable v.
+ * \return true if every clause has a true literal.
+ */
+bool modelSatisfies(const ClauseDB& db, const vector<char>& model) {
+    for (const auto& clause : db.clauses) {
+        bool satisfied = false;
+        for (int lit : clause) {
+            if (literalVar(lit) < (int)model.size() && model[literalVar(lit)] != literalIsNegated(lit)) {
+                satisfied = true;
+                break;
+            }
+        }
+        if (!satisfied) return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Prints a model as the list of true and false atoms.
+ * \param db The clause database holding the atom names.
+ * \param model model[v] is the value of variable v.
+ */
+void printModel(const ClauseDB& db, const vector<char>& model) {
+    cout << "Model:";
+    for (int v = 0; v < (int)model.size() && v < db.numVars; ++v)
+        cout << " " << (model[v] ? "" : "~") << db.names[v];
+    cout << endl;
+}
+
+/**
+ * \brief Prints the result, timing and counters of a CDCL run.
+ * \param result The outcome.
+ * \param stats The solver counters.
+ * \param ms Solve time in milliseconds.
+ */
+void printSolverStats(SolveResult result, const SolverStats& stats, double ms) {
+    cout << "Result: " << solveResultName(result) << endl;
+    cout << "Decisions: " << stats.decisions << ", conflicts: " << stats.conflicts
+         << ", propagations: " << stats.propagations << endl;
+    cout << "Restarts: " << stats.restarts << ", learnt clauses: " << stats.learnt
+         << ", reductions: " << stats.reductions << " (" << stats.deleted << " clauses deleted)" << endl;
+    cout << "Solve time: " << ms << " ms";
+    if (ms > 0) cout << ", propagations/sec: " << (uint64_t)(stats.propagations / (ms / 1000.0));
+    cout << endl;
+}
+
+/* ---------------- END CDCL SAT Solver ---------------- */
+
+/* ---------------- STOCHASTIC LOCAL SEARCH ---------------- */
+
+/**
+ * \brief Variable selection policy of \ref LocalSearchSolver.
+ */
+enum class LocalSearchPolicy { PROBSAT, WALKSAT };
+
+/**
+ * \struct LocalSearchOptions
+ * \brief Parameters of \ref LocalSearchSolver.
+ */
+struct LocalSearchOptions {
+    LocalSearchPolicy policy = LocalSearchPolicy::PROBSAT; /**< Selection policy. */
+    double cb = 2.06;              /**< probSAT: exponent of the polynomial break function (2.06 suits 3-SAT). */
+    double eps = 0.9;              /**< probSAT: offset of the polynomial break function. */
+    double noise = 0.567;          /**< WalkSAT: probability of a random walk step. */
+    uint64_t maxFlips = 100000000; /**< Flip budget. */
+    double timeLimit = 10.0;       /**< Time limit in seconds. */
+    uint64_t seed = 1;             /**< Random seed. */
+};
+
+/**
+ * \struct LocalSearchSolver
+ * \brief probSAT / WalkSAT stochastic local search over a clause database.
+ *
+ * Keeps, for the current assignment, the number of true literals of every clause, the XOR of
+ * the variables of its true literals (which is the critical variable when exactly one literal is
+ * true), break and make counts of every variable, and a flat array of unsatisfied clauses with
+ * position indices. Each flip updates these incrementally by visiting the occurrences of the
+ * flipped variable only.
+ * Local search can only answer SAT; it reports UNKNOWN when the budget runs out.
+ */
+struct LocalSearchSolver {
+    LocalSearchOptions options;   /**< Configuration. */
+    int numVars = 0;              /**< Number of variables. */
+    vector<int> clauseStart;      /**< Clause c occupies lits[clauseStart[c], clauseStart[c+1]). */
+    vector<int> lits;             /**< All clause literals. */
+    vector<int> occurStart;       /**< Literal l occurs in clauses occurs[occurStart[l], occurStart[l+1]). */
+    vector<int> occurs;           /**< Occurrence lists. */
+
+    vector<char> assignment;      /**< Current value of every variable. */
+    vector<int> numTrue;          /**< True literals per clause. */
+    vector<int> critXor;          /**< XOR of the variables of the true literals per clause. */
+    vector<int> breakCount;       /**< Clauses that become false if the variable is flipped. */
+    vector<int> makeCount;        /**< False clauses that become true if the variable is flipped. */
+    vector<int> unsat;            /**< Unsatisfied clauses. */
+    vector<int> unsatPos;         /**< Position of each clause in \p unsat, or -1. */
+    vector<double> probTable;     /**< probSAT weight for each break count. */
+    XorShiftRandom rng;           /**< Random source. */
+
+    uint64_t flips = 0;           /**< Flips performed. */
+    bool trivialUnsat = false;    /**< true if the database contains an empty clause. */
+
+    /**
+     * \brief Builds the flat clause and occurrence arrays.
+     *
+     * Clauses are normalized with \ref normalizeClause first: a repeated literal would count twice
+     * in \p numTrue and cancel itself in \p critXor, and a tautology can never be broken, so
+     * tautologies are dropped.
+     * \param db The clause database.
+     * \param opts Options.
+     */
+    LocalSearchSolver(const ClauseDB& db, const LocalSearchOptions& opts)
+        : options(opts), numVars(db.numVars), rng(opts.seed) {
+        vector<int> counts(2 * (size_t)numVars + 1, 0);
+        clauseStart.push_back(0);
+        vector<int> clause;
+        size_t duplicateLiterals = 0;
+        for (const auto& original : db.clauses) {
+            if (original.empty()) trivialUnsat = true;
+            clause = original;
+            if (normalizeClause(clause, duplicateLiterals)) continue;
+            for (int lit : clause) {
+                lits.push_back(lit);
+                counts[lit + 1]++;
+            }
+            clauseStart.push_back((int)lits.size());
+        }
+        occurStart = counts;
+        for (size_t i = 1; i < occurStart.size(); ++i) occurStart[i] += occurStart[i - 1];
+        occurs.resize(lits.size());
+        vector<int> fillPos(occurStart.begin(), occurStart.end() - 1);
+        for (int c = 0; c + 1 < (int)clauseStart.size(); ++c) {
+            for (int k = clauseStart[c]; k < clauseStart[c + 1]; ++k) occurs[fillPos[lits[k]]++] = c;
+        }
+        for (int b = 0; b < 64; ++b) probTable.push_back(pow(options.eps + b, -options.cb));
+    }
+
+    /** \brief Number of clauses. */
+    int numClauses() const { return (int)clauseStart.size() - 1; }
+
+    /** \brief true if literal \p lit is true under the current assignment. */
+    bool isTrue(int lit) const { return assignment[literalVar(lit)] != literalIsNegated(lit); }
+
+    /** \brief Adds clause c to the unsatisfied list. */
+    void markUnsat(int c) {
+        unsatPos[c] = (int)unsat.size();
+        unsat.push_back(c);
+    }
+
+    /** \brief Removes clause c from the unsatisfied list in O(1). */
+    void markSat(int c) {
+        int last = unsat.back();
+        unsat[unsatPos[c]] = last;
+        unsatPos[last] = unsatPos[c];
+        unsat.pop_back();
+        unsatPos[c] = -1;
+    }
+
+    /**
+     * \brief Sets the assignment and recomputes all counters from scratch.
+     * \param initial Initial values (random when empty).
+     */
+    void initialize(vector<char> initial = {}) {
+        assignment.assign(numVars, 0);
+        for (int v = 0; v < numVars; ++v)
+            assignment[v] = (v < (int)initial.size()) ? initial[v] : (char)(rng.next() & 1);
+        int m = numClauses();
+        numTrue.assign(m, 0);
+        critXor.assign(m, 0);
+        breakCount.assign(numVars, 0);
+        makeCount.assign(numVars, 0);
+        unsat.clear();
+        unsatPos.assign(m, -1);
+        for (int c = 0; c < m; ++c) {
+            for (int k = clauseStart[c]; k < clauseStart[c + 1]; ++k) {
+                if (isTrue(lits[k])) {
+                    numTrue[c]++;
+                    critXor[c] ^= literalVar(lits[k]);
+                }
+            }
+            if (numTrue[c] == 0) {
+                markUnsat(c);
+                for (int k = clauseStart[c]; k < clauseStart[c + 1]; ++k) makeCount[literalVar(lits[k])]++;
+            } else if (numTrue[c] == 1) {
+                breakCount[critXor[c]]++;
+            }
+        }
+    }
+
+    /** \brief Flips variable v and updates all counters incrementally. */
+    void flip(int v) {
+        flips++;
+        assignment[v] ^= 1;
+        int nowTrue = makeLiteral(v, !assignment[v]);
+        int nowFalse = negateLiteral(nowTrue);
+
+        for (int k = occurStart[nowTrue]; k < occurStart[nowTrue + 1]; ++k) {
+            int c = occurs[k];
+            int count = ++numTrue[c];
+            critXor[c] ^= v;
+            if (count == 1) { // was false, now satisfied by v only
+                markSat(c);
+                for (int j = clauseStart[c]; j < clauseStart[c + 1]; ++j) makeCount[literalVar(lits[j])]--;
+                breakCount[v]++;
+            } else if (count == 2) { // the previous critical variable is no longer critical
+                breakCount[critXor[c] ^ v]--;
+            }
+        }
+        for (int k = occurStart[nowFalse]; k < occurStart[nowFalse + 1]; ++k) {
+            int c = occurs[k];
+            int count = --numTrue[c];
+            critXor[c] ^= v;
+            if (count == 0) { // v was critical, clause is now false
+                markUnsat(c);
+                breakCount[v]--;
+                for (int j = clauseStart[c]; j < clauseStart[c + 1]; ++j) makeCount[literalVar(lits[j])]++;
+            } else if (count == 1) { // the remaining true literal becomes critical
+                breakCount[critXor[c]]++;
+            }
+        }
+    }
+
+    /** \brief probSAT: samples a variable of clause c with weight (eps + break)^-cb. */
+    int pickProbSAT(int c) {
+        double weights[64];
+        double total = 0;
+        int len = clauseStart[c + 1] - clauseStart[c];
+        int n = min(len, 64);
+        for (int i = 0; i < n; ++i) {
+            int b = breakCount[literalVar(lits[clauseStart[c] + i])];
+            total += weights[i] = probTable[min(b, 63)];
+        }
+        double r = rng.uniform() * total;
+        for (int i = 0; i < n; ++i) {
+            if ((r -= weights[i]) <= 0) return literalVar(lits[clauseStart[c] + i]);
+        }
+        return literalVar(lits[clauseStart[c] + n - 1]);
+    }
+
+    /** \brief WalkSAT (SKC): a zero-break variable if any, else random with probability noise, else minimum break. */
+    int pickWalkSAT(int c) {
+        int begin = clauseStart[c], len = clauseStart[c + 1] - begin;
+        int best = -1, bestBreak = INT_MAX, ties = 0;
+        for (int i = 0; i < len; ++i) {
+            int v = literalVar(lits[begin + i]);
+            int b = breakCount[v];
+            if (b < bestBreak) {
+                best = v;
+                bestBreak = b;
+                ties = 1;
+            } else if (b == bestBreak && rng.below(++ties) == 0) {
+                best = v;
+            }
+        }
+        if (bestBreak > 0 && rng.uniform() < options.noise) return literalVar(lits[begin + rng.below(len)]);
+        return best;
+    }
+
+    /**
+     * \brief Runs local search until all clauses are satisfied, the flip budget or the time limit is reached,
+     * or \p stop becomes true.
+     * \param initial Initial assignment (random when empty).
+     * \param stop Optional external cancellation flag.
+     * \return SAT (the satisfying assignment is in \ref assignment) or UNKNOWN.
+     */
+    SolveResult solve(const vector<char>& initial = {}, const atomic<bool>* stop = nullptr) {
+        if (trivialUnsat) return SolveResult::UNSAT;
+        initialize(initial);
+        auto start = chrono::steady_clock::now();
+        while (!unsat.empty()) {
+            if (flips >= options.maxFlips) return SolveResult::UNKNOWN;
+            if ((flips & 4095) == 0) {
+                if (stop && stop->load(memory_order_relaxed)) return SolveResult::UNKNOWN;
+                if (chrono::duration<double>(chrono::steady_clock::now() - start).count() > options.timeLimit)
+                    return SolveResult::UNKNOWN;
+            }
+            int c = unsat[rng.below((uint32_t)unsat.size())];
+            flip(options.policy == LocalSearchPolicy::PROBSAT ? pickProbSAT(c) : pickWalkSAT(c));
+        }
+        return SolveResult::SAT;
+    }
+};
+
+/* ---------------- END Stochastic Local Search ---------------- */
+
+/* ---------------- PARALLEL PORTFOLIO SOLVING ---------------- */
+
+/**
+ * \struct ClauseExportRing
+ * \brief A lock-free single-writer, multi-reader ring of short learnt clauses.
+ *
+ * Each portfolio worker owns one ring and is its only writer. Readers keep their own cursor and
+ * never block the writer; a slot is protected by a sequence number (seqlock), so a reader that
+ * races with an overwrite simply discards that slot. When a reader falls more than a full ring
+ * behind, the overwritten clauses are skipped.
+ */
+struct ClauseExportRing {
+    /** \var CAPACITY \brief Number of slots. */
+    static const int CAPACITY = 1024;
+    /** \var MAX_LENGTH \brief Longest clause that can be exported. */
+    static constexpr int MAX_LENGTH = 8;
+
+    /** \brief One exported clause. */
+    struct Slot {
+        atomic<uint64_t> sequence{0};        /**< 2k+2 once write number k is complete, odd while writing. */
+        atomic<int> size{0};                 /**< Number of literals. */
+        atomic<int> lbd{0};                  /**< LBD in the exporting solver. */
+        array<atomic<int>, MAX_LENGTH> lits; /**< The literals. */
+    };
+
+    /** \var slots \brief The ring storage. */
+    unique_ptr<Slot[]> slots{new Slot[CAPACITY]};
+    /** \var head \brief Number of clauses published so far. */
+    atomic<uint64_t> head{0};
+
+    /**
+     * \brief Publishes a clause (writer only).
+     * \param clause The literals (at most \ref MAX_LENGTH).
+     * \param lbd The clause's LBD.
+     */
+    void publish(const vector<int>& clause, int lbd) {
+        uint64_t k = head.load(memory_order_relaxed);
+        Slot& slot = slots[k % CAPACITY];
+        slot.sequence.store(2 * k + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot.size.store((int)clause.size(), memory_order_relaxed);
+        slot.lbd.store(lbd, memory_order_relaxed);
+        for (size_t i = 0; i < clause.size(); ++i) slot.lits[i].store(clause[i], memory_order_relaxed);
+        slot.sequence.store(2 * k + 2, memory_order_release);
+        head.store(k + 1, memory_order_release);
+    }
+
+    /**
+     * \brief Reads the clauses published since \p cursor.
+     * \param cursor The reader's position, advanced past everything read or skipped.
+     * \param visit Called as visit(clause, lbd) for every clause read intact.
+     */
+    void collect(uint64_t& cursor, const function<void(const vector<int>&, int)>& visit) const {
+        uint64_t end = head.load(memory_order_acquire);
+        if (end - cursor > (uint64_t)CAPACITY) cursor = end - CAPACITY;
+        vector<int> clause;
+        for (; cursor < end; ++cursor) {
+            const Slot& slot = slots[cursor % CAPACITY];
+            uint64_t expected = 2 * cursor + 2;
+            if (slot.sequence.load(memory_order_acquire) != expected) continue;
+            int size = slot.size.load(memory_order_relaxed);
+            int lbd = slot.lbd.load(memory_order_relaxed);
+            clause.resize(max(0, min(size, MAX_LENGTH)));
+            for (size_t i = 0; i < clause.size(); ++i) clause[i] = slot.lits[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.sequence.load(memory_order_relaxed) != expected) continue; // overwritten meanwhile
+            visit(clause, lbd);
+        }
+    }
+};
+
+/**
+ * \struct PortfolioWorkerConfig
+ * \brief The configuration of one portfolio worker.
+ */
+struct PortfolioWorkerConfig {
+    bool localSearch = false;       /**< true: run \ref LocalSearchSolver instead of CDCL. */
+    SolverOptions cdcl;             /**< CDCL options (when not local search). */
+    LocalSearchOptions sls;         /**< Local search options (when local search). */
+    string description;             /**< Short label for reports. */
+};
+
+/**
+ * \brief Builds diversified worker configurations.
+ *
+ * Worker 0 is the default CDCL configuration; the others vary the restart policy, default phase,
+ * decay and random seed, and every fourth worker runs probSAT local search.
+ * \param numThreads Number of workers.
+ * \return One configuration per worker.
+ */
+vector<PortfolioWorkerConfig> makePortfolioConfigs(int numThreads) {
+    vector<PortfolioWorkerConfig> configs;
+    for (int i = 0; i < numThreads; ++i) {
+        PortfolioWorkerConfig config;
+        if (i % 4 == 3) {
+            config.localSearch = true;
+            config.sls.seed = 1 + i;
+            config.sls.timeLimit = 1e9; // stopped by the portfolio
+            config.sls.maxFlips = UINT64_MAX;
+            config.description = "probSAT seed " + to_string(i + 1);
+        } else {
+            config.cdcl.glucoseRestarts = (i % 2 == 0);
+            config.cdcl.defaultPhase = (i % 4 == 1);
+            config.cdcl.varDecay = 0.95 - 0.01 * (i % 3);
+            config.cdcl.seed = (i == 0) ? 0 : 1000 + i;
+            config.description = string("CDCL ") + (config.cdcl.glucoseRestarts ? "glucose" : "luby") +
+                                 (config.cdcl.defaultPhase ? " phase+" : " phase-") + " seed " + to_string(config.cdcl.seed);
+        }
+        configs.push_back(config);
+    }
+    return configs;
+}
+
+/**
+ * \struct PortfolioResult
+ * \brief Outcome of \ref solvePortfolio.
+ */
+struct PortfolioResult {
+    SolveResult result = SolveResult::UNKNOWN; /**< The answer of the first worker to finish. */
+    int winner = -1;                           /**< Index of that worker. */
+    vector<char> model;                        /**< Model when SAT. */
+    vector<PortfolioWorkerConfig> configs;     /**< The worker configurations. */
+    vector<uint64_t> exported, imported;       /**< Clauses shared by each worker. */
+};
+
+/**
+ * \brief Solves a clause database with a parallel portfolio of diversified solvers.
+ *
+ * Every worker holds its own copy of the clauses. CDCL workers export learnt clauses with at most
+ * \p shareMaxSize literals and LBD at most \p shareMaxLBD into their own \ref ClauseExportRing and
+ * import the other workers' clauses at every restart. The first worker with a definite answer
+ * sets a shared stop flag that all other workers poll.
+ * \param db The clause database.
+ * \param numThreads Number of workers.
+ * \param timeLimit Seconds before all workers are stopped (the result is then UNKNOWN).
+ * \param shareMaxLBD Maximum LBD of shared clauses.
+ * \param shareMaxSize Maximum length of shared clauses.
+ * \return The portfolio outcome.
+ */
+PortfolioResult solvePortfolio(const ClauseDB& db, int numThreads, double timeLimit = 1e9,
+                               int shareMaxLBD = 4, int shareMaxSize = ClauseExportRing::MAX_LENGTH) {
+    numThreads = max(1, numThreads);
+    PortfolioResult out;
+    out.configs = makePortfolioConfigs(numThreads);
+    out.exported.assign(numThreads, 0);
+    out.imported.assign(numThreads, 0);
+    shareMaxSize = min(shareMaxSize, ClauseExportRing::MAX_LENGTH);
+
+    vector<ClauseExportRing> rings(numThreads);
+    atomic<bool> stop{false};
+    atomic<int> winner{-1};
+    vector<SolveResult> results(numThreads, SolveResult::UNKNOWN);
+    vector<vector<char>> models(numThreads);
+
+    auto work = [&](int id) {
+        const PortfolioWorkerConfig& config = out.configs[id];
+        SolveResult result;
+        if (config.localSearch) {
+            LocalSearchSolver sls(db, config.sls);
+            result = sls.solve({}, &stop);
+            if (result == SolveResult::SAT) models[id] = sls.assignment;
+        } else {
+            CDCLSolver solver(db, config.cdcl);
+            solver.terminate = &stop;
+            vector<uint64_t> cursors(numThreads, 0);
+            solver.exportClause = [&, id](const vector<int>& clause, int lbd) {
+                if ((int)clause.size() > shareMaxSize || lbd > shareMaxLBD) return;
+                rings[id].publish(clause, lbd);
+                out.exported[id]++;
+            };
+            solver.importClauses = [&, id](CDCLSolver& s) {
+                for (int other = 0; other < numThreads; ++other) {
+                    if (other == id) continue;
+                    rings[other].collect(cursors[other], [&](const vector<int>& clause, int lbd) {
+                        s.importLearntClause(clause, lbd);
+                        out.imported[id]++;
+                    });
+                }
+            };
+            result = solver.solve();
+            if (result == SolveResult::SAT) models[id] = solver.model;
+        }
+        results[id] = result;
+        int none = -1;
+        if (result != SolveResult::UNKNOWN && winner.compare_exchange_strong(none, id)) stop = true;
+    };
+
+    vector<thread> threads;
+    for (int i = 0; i < numThreads; ++i) threads.emplace_back(work, i);
+    auto deadline = chrono::steady_clock::now() + chrono::duration<double>(timeLimit);
+    while (!stop && chrono::steady_clock::now() < deadline) this_thread::sleep_for(chrono::milliseconds(1));
+    stop = true;
+    for (auto& t : threads) t.join();
+
+    out.winner = winner.load();
+    if (out.winner >= 0) {
+        out.result = results[out.winner];
+        out.model = models[out.winner];
+    }
+    return out;
+}
+
+/* ---------------- END Parallel Portfolio Solving ---------------- */
+
+/* ---------------- CUBE AND CONQUER ---------------- */
+
+/**
+ * \struct CubeOptions
+ * \brief Parameters of the lookahead cuber.
+ */
+struct CubeOptions {
+    int targetCubes = 1024; /**< Approximate number of cubes; the split depth is log2 of this. */
+    int candidates = 32;    /**< Unassigned variables (by occurrence count) probed at every split. */
+    int minFreeVars = 10;   /**< Stop splitting when at most this many variables are unassigned. */
+};
+
+/**
+ * \struct CubeSet
+ * \brief The result of lookahead cubing.
+ */
+struct CubeSet {
+    vector<vector<int>> cubes; /**< Open cubes (partial assignments) still to be solved. */
+    uint64_t refuted = 0;      /**< Branches refuted by propagation during cubing. */
+    bool unsat = false;        /**< true if cubing alone refuted the whole formula. */
+};
+
+/**
+ * \brief Splits a clause database into cubes with propagation-based lookahead.
+ *
+ * At every node the candidate variables are probed in both polarities: the literal is assigned
+ * and propagated, and the number of implied assignments is recorded. A literal whose propagation
+ * fails is a failed literal and its negation is added to the cube. The variable with the largest
+ * product of both counts is split on (march-style). Leaves at the target depth, or with few free
+ * variables left, become cubes; branches refuted by propagation are dropped. Together the cubes
+ * and refuted branches cover every assignment, so the formula is SAT iff some cube is.
+ * \param db The clause database.
+ * \param options Cuber parameters.
+ * \return The cubes.
+ */
+CubeSet generateCubes(const ClauseDB& db, const CubeOptions& options = CubeOptions()) {
+    CubeSet out;
+    CDCLSolver engine(db, SolverOptions());
+    if (!engine.ok || engine.propagate() >= 0) {
+        out.unsat = true;
+        return out;
+    }
+
+    vector<int> occurrences(db.numVars, 0);
+    for (const auto& clause : db.clauses)
+        for (int lit : clause) occurrences[literalVar(lit)]++;
+    vector<int> byOccurrence(db.numVars);
+    iota(byOccurrence.begin(), byOccurrence.end(), 0);
+    stable_sort(byOccurrence.begin(), byOccurrence.end(), [&](int a, int b) { return occurrences[a] > occurrences[b]; });
+
+    int maxDepth = 0;
+    while ((1 << maxDepth) < options.targetCubes && maxDepth < 30) maxDepth++;
+    vector<int> cube;
+
+    // Probes lit at a new level; returns the number of implied assignments, or -1 on conflict.
+    auto probe = [&](int lit) {
+        size_t before = engine.trail.size();
+        int conflict = engine.decideAndPropagate(lit);
+        int implied = (conflict >= 0) ? -1 : (int)(engine.trail.size() - before);
+        engine.cancelUntil(engine.decisionLevel() - 1);
+        return implied;
+    };
+
+    function<void(int)> split = [&](int depth) {
+        int baseLevel = engine.decisionLevel();
+        size_t baseCube = cube.size();
+        auto backtrack = [&] {
+            engine.cancelUntil(baseLevel);
+            cube.resize(baseCube);
+        };
+
+        int bestVar = -1;
+        long long bestScore = -1;
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            bestVar = -1;
+            bestScore = -1;
+            int probed = 0;
+            for (int v : byOccurrence) {
+                if (probed >= options.candidates) break;
+                int pos = makeLiteral(v, false);
+                if (engine.value[pos] != 0) continue;
+                probed++;
+                int up = probe(pos), down = probe(negateLiteral(pos));
+                if (up < 0 && down < 0) { // both polarities fail: this branch is refuted
+                    out.refuted++;
+                    backtrack();
+                    return;
+                }
+                if (up < 0 || down < 0) { // failed literal: assert its negation
+                    int forced = (up < 0) ? negateLiteral(pos) : pos;
+                    cube.push_back(forced);
+                    if (engine.decideAndPropagate(forced) >= 0) {
+                        out.refuted++;
+                        backtrack();
+                        return;
+                    }
+                    progress = true;
+                    break;
+                }
+                long long score = (long long)(up + 1) * (down + 1);
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestVar = v;
+                }
+            }
+        }
+
+        int freeVars = engine.numVars - (int)engine.trail.size();
+        if (depth >= maxDepth || bestVar < 0 || freeVars <= options.minFreeVars) {
+            out.cubes.push_back(cube);
+            backtrack();
+            return;
+        }
+        for (int negated = 0; negated < 2; ++negated) {
+            int lit = makeLiteral(bestVar, negated);
+            cube.push_back(lit);
+            if (engine.decideAndPropagate(lit) >= 0) out.refuted++;
+            else split(depth + 1);
+            engine.cancelUntil(engine.decisionLevel() - 1);
+            cube.pop_back();
+        }
+        backtrack();
+    };
+    split(0);
+    if (out.cubes.empty()) out.unsat = true;
+    return out;
+}
+
+/**
+ * \struct CubeAndConquerResult
+ * \brief Outcome of \ref solveCubeAndConquer.
+ */
+struct CubeAndConquerResult {
+    SolveResult result = SolveResult::UNKNOWN; /**< Overall answer. */
+    vector<char> model;                        /**< Model when SAT. */
+    size_t cubes = 0;                          /**< Cubes produced by the cuber. */
+    uint64_t refuted = 0;                      /**< Branches refuted while cubing. */
+    size_t solvedCubes = 0;                    /**< Cubes solved before the answer was known. */
+    double cubeMs = 0, conquerMs = 0;          /**< Time of both phases. */
+    bool usedProcesses = false;                /**< true if the cubes were solved by worker processes. */
+};
+
+/**
+ * \brief Conquer phase on threads: cubes are split recursively over a \ref WorkStealingPool.
+ *
+ * Every worker owns one \ref CDCLSolver and solves its cubes incrementally with
+ * solve(assumptions), so learnt clauses carry over between cubes. The first SAT cube stops the
+ * remaining work.
+ * \param db The clause database.
+ * \param cubes The cubes.
+ * \param numThreads Number of workers.
+ * \param out Receives the result, model and solved-cube count.
+ */
+void conquerCubesThreaded(const ClauseDB& db, const vector<vector<int>>& cubes, int numThreads,
+                          CubeAndConquerResult& out) {
+    WorkStealingPool pool(numThreads);
+    vector<unique_ptr<CDCLSolver>> solvers(pool.size());
+    atomic<bool> found{false};
+    atomic<size_t> solved{0};
+    mutex modelLock;
+
+    function<void(size_t, size_t)> conquer = [&](size_t lo, size_t hi) {
+        if (found) return;
+        if (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            pool.forkJoin([&] { conquer(lo, mid); }, [&] { conquer(mid, hi); });
+            return;
+        }
+        auto& solver = solvers[max(WorkStealingPool::workerId, 0)];
+        if (!solver) {
+            solver.reset(new CDCLSolver(db, SolverOptions()));
+            solver->terminate = &found;
+        }
+        SolveResult r = solver->solve(cubes[lo]);
+        solved++;
+        if (r == SolveResult::SAT && !found.exchange(true)) {
+            lock_guard<mutex> guard(modelLock);
+            out.model = solver->model;
+        }
+    };
+    pool.run([&] { conquer(0, cubes.size()); });
+    out.solvedCubes = solved;
+    out.result = found ? SolveResult::SAT : SolveResult::UNSAT;
+}
+
+#ifdef HAVE_PROCESS_WORKERS
+/**
+ * \brief Writes exactly \p bytes to a pipe.
+ * \return false if the pipe was closed (EPIPE; SIGPIPE must be ignored by the caller).
+ */
+bool writeAll(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = write(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+/**
+ * \brief Reads exactly \p bytes from a pipe.
+ * \return false if the pipe was closed.
+ */
+bool readAll(int fd, void* data, size_t bytes) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = read(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+/**
+ * \brief Conquer phase on separate worker processes connected by pipes.
+ *
+ * Stands in for a multi-node run: each child process inherits the clause database through
+ * fork(), then answers cube requests (`int length, int literals[length]`; length -1 ends the
+ * child) with `int result` (1 SAT, 0 UNSAT), followed by the model bytes when SAT. The parent
+ * hands out one cube at a time to whichever child answers next.
+ *
+ * A child that dies (crash, OOM kill) shows up as a failed read or write; it is dropped and its
+ * cube is handed to another child. The answer is UNSAT only if every cube was refuted; if all
+ * children die first it is UNKNOWN. SIGPIPE is ignored while the children run.
+ * \param db The clause database.
+ * \param cubes The cubes.
+ * \param numWorkers Number of child processes.
+ * \param out Receives the result, model and solved-cube count.
+ * \return false if the worker processes could not be started.
+ */
+bool conquerCubesInProcesses(const ClauseDB& db, const vector<vector<int>>& cubes, int numWorkers,
+                             CubeAndConquerResult& out) {
+    struct Worker {
+        pid_t pid;
+        int toChild, fromChild;
+        bool alive;  /**< false once a read or write failed. */
+        long cube;   /**< Index of the cube being solved, or -1 when idle. */
+    };
+    auto previousSigpipe = signal(SIGPIPE, SIG_IGN); // a dead child must not kill the parent
+    vector<Worker> workers;
+    for (int i = 0; i < numWorkers; ++i) {
+        int down[2], up[2];
+        if (pipe(down) != 0) break;
+        if (pipe(up) != 0) {
+            close(down[0]);
+            close(down[1]);
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(down[0]); close(down[1]); close(up[0]); close(up[1]);
+            break;
+        }
+        if (pid == 0) { // child: serve cubes until told to stop
+            close(down[1]);
+            close(up[0]);
+            for (const Worker& w : workers) {
+                close(w.toChild);
+                close(w.fromChild);
+            }
+            CDCLSolver solver(db, SolverOptions());
+            int length;
+            vector<int> cube;
+            while (readAll(down[0], &length, sizeof(length)) && length >= 0) {
+                cube.resize(length);
+                if (length > 0 && !readAll(down[0], cube.data(), length * sizeof(int))) break;
+                int sat = (solver.solve(cube) == SolveResult::SAT) ? 1 : 0;
+                if (!writeAll(up[1], &sat, sizeof(sat))) break;
+                if (sat && !writeAll(up[1], solver.model.data(), solver.model.size())) break;
+            }
+            _exit(0);
+        }
+        close(down[0]);
+        close(up[1]);
+        workers.push_back({pid, down[1], up[0], true, -1});
+    }
+    if (workers.empty()) {
+        signal(SIGPIPE, previousSigpipe);
+        return false;
+    }
+
+    // Cubes not yet solved: never sent, or held by a child that died
+    deque<long> todo;
+    for (size_t i = 0; i < cubes.size(); ++i) todo.push_back((long)i);
+    size_t refuted = 0;
+    bool found = false;
+
+    auto drop = [&](Worker& w) {
+        w.alive = false;
+        if (w.cube >= 0) todo.push_front(w.cube);
+        w.cube = -1;
+    };
+    auto assign = [&](Worker& w) {
+        while (w.alive && !todo.empty()) {
+            long c = todo.front();
+            todo.pop_front();
+            w.cube = c;
+            int length = (int)cubes[c].size();
+            if (writeAll(w.toChild, &length, sizeof(length)) &&
+                (length == 0 || writeAll(w.toChild, cubes[c].data(), length * sizeof(int)))) {
+                return;
+            }
+            drop(w);
+        }
+    };
+
+    for (Worker& w : workers) assign(w);
+    vector<pollfd> fds;
+    vector<Worker*> polled;
+    while (!found) {
+        fds.clear();
+        polled.clear();
+        for (Worker& w : workers) {
+            if (w.alive && w.cube >= 0) {
+                fds.push_back({w.fromChild, POLLIN, 0});
+                polled.push_back(&w);
+            }
+        }
+        if (fds.empty()) break; // all cubes answered, or no child left to answer them
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))) continue;
+            Worker& w = *polled[i];
+            int sat = 0;
+            if (!readAll(w.fromChild, &sat, sizeof(sat))) {
+                drop(w);
+                continue;
+            }
+            if (sat) {
+                vector<char> model(db.numVars);
+                if (!readAll(w.fromChild, model.data(), model.size())) {
+                    drop(w);
+                    continue;
+                }
+                out.model = move(model);
+                found = true;
+            } else {
+                refuted++;
+            }
+            out.solvedCubes++;
+            w.cube = -1;
+            if (!found) assign(w);
+        }
+        // Cubes requeued from dead children go to idle survivors
+        for (Worker& w : workers) {
+            if (!found && w.alive && w.cube < 0) assign(w);
+        }
+    }
+    for (Worker& w : workers) {
+        int stop = -1;
+        if (w.alive) writeAll(w.toChild, &stop, sizeof(stop));
+        close(w.toChild);
+    }
+    for (Worker& w : workers) {
+        if (found || !w.alive) kill(w.pid, SIGTERM); // stop children still busy with a cube
+        waitpid(w.pid, nullptr, 0);
+        close(w.fromChild);
+    }
+    signal(SIGPIPE, previousSigpipe);
+    if (found) out.result = SolveResult::SAT;
+    else out.result = refuted == cubes.size() ? SolveResult::UNSAT : SolveResult::UNKNOWN;
+    return true;
+}
+#endif
+
+/**
+ * \brief Solves a clause database with cube-and-conquer.
+ *
+ * The instance is split by \ref generateCubes and the cubes are solved in parallel, either on
+ * threads (\ref conquerCubesThreaded) or, where fork() is available, on worker processes
+ * (\ref conquerCubesInProcesses). Process mode falls back to threads elsewhere.
+ * \param db The clause database.
+ * \param numWorkers Number of threads or processes.
+ * \param useProcesses true to solve the cubes in separate processes.
+ * \param options Cuber parameters.
+ * \return The outcome and phase timings.
+ */
+CubeAndConquerResult solveCubeAndConquer(const ClauseDB& db, int numWorkers, bool useProcesses = false,
+                                         const CubeOptions& options = CubeOptions()) {
+    CubeAndConquerResult out;
+    auto start = chrono::steady_clock::now();
+    CubeSet cubes = generateCubes(db, options);
+    out.cubeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out.cubes = cubes.cubes.size();
+    out.refuted = cubes.refuted;
+    if (cubes.unsat) {
+        out.result = SolveResult::UNSAT;
+        return out;
+    }
+
+    start = chrono::steady_clock::now();
+#ifdef HAVE_PROCESS_WORKERS
+    if (useProcesses) out.usedProcesses = conquerCubesInProcesses(db, cubes.cubes, max(1, numWorkers), out);
+#endif
+    if (!out.usedProcesses) conquerCubesThreaded(db, cubes.cubes, max(1, numWorkers), out);
+    out.conquerMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+/* ---------------- END Cube and Conquer ---------------- */
+
+/* ---------------- INCREMENTAL SOLVING ---------------- */
+
+/**
+ * \struct IncrementalSolver
+ * \brief Answers many related queries against one base formula.
+ *
+ * The base clauses are loaded into one \ref CDCLSolver once. Clauses can be added at any time and
+ * every query is a call to solve(assumptions), so learnt clauses, activities and saved phases
+ * carry over from query to query. A copy of the clauses is kept so a query can also be answered
+ * by a cold solver for comparison.
+ */
+struct IncrementalSolver {
+    CDCLSolver solver;                 /**< The persistent solver. */
+    ClauseDB db;                       /**< Base clauses plus every clause added since. */
+    unordered_map<string, int> index;  /**< Atom name to variable. */
+    double lastMs = 0;                 /**< Time of the last query in milliseconds. */
+    double learntLimit = 1.0;          /**< Reduce before a query once learnt clauses exceed this many per problem clause. */
+
+    /**
+     * \brief Loads the base formula.
+     * \param base The clause database.
+     * \param options Solver options.
+     */
+    explicit IncrementalSolver(const ClauseDB& base, const SolverOptions& options = SolverOptions())
+        : solver(base, options), db(base) {
+        for (int v = 0; v < db.numVars; ++v) index[db.names[v]] = v;
+    }
+
+    /**
+     * \brief Parses whitespace-separated literals such as "a ~b c".
+     * \param text The literals; "~" or "-" negates.
+     * \param lits Receives the literals.
+     * \param createAtoms true to add unknown atoms as new variables, false to reject them.
+     * \param error Receives a message on failure.
+     * \return true on success.
+     */
+    bool parseLiterals(const string& text, vector<int>& lits, bool createAtoms, string& error) {
+        lits.clear();
+        istringstream in(text);
+        string word;
+        while (in >> word) {
+            bool negated = false;
+            while (!word.empty() && (word[0] == '~' || word[0] == '-')) {
+                negated = !negated;
+                word.erase(0, 1);
+            }
+            if (word.empty()) {
+                error = "missing atom after negation";
+                return false;
+            }
+            auto it = index.find(word);
+            int v;
+            if (it != index.end()) {
+                v = it->second;
+            } else if (createAtoms) {
+                v = db.numVars++;
+                db.names.push_back(word);
+                index[word] = v;
+            } else {
+                error = "unknown atom '" + word + "'";
+                return false;
+            }
+            lits.push_back(makeLiteral(v, negated));
+        }
+        return true;
+    }
+
+    /**
+     * \brief Adds a clause permanently.
+     * \param clause The literals.
+     * \return false if the formula became unsatisfiable.
+     */
+    bool addClause(const vector<int>& clause) {
+        db.clauses.push_back(clause);
+        return solver.addClause(clause);
+    }
+
+    /**
+     * \brief Solves under assumptions, reusing everything learnt so far.
+     * \param assumptions Literals assumed true for this query only.
+     * \return The outcome; on UNSAT see \ref failedAssumptions.
+     */
+    SolveResult solve(const vector<int>& assumptions) {
+        auto start = chrono::steady_clock::now();
+        // Learnt clauses pile up over many short queries and slow propagation down; a single
+        // solve rarely reaches its first reduction, so bound them here as well.
+        if (solver.learnts.size() > learntLimit * max<size_t>(solver.originals.size(), 1000)) solver.reduceLearnts();
+        SolveResult result = solver.solve(assumptions);
+        lastMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    /** \brief After UNSAT: assumptions that are inconsistent together (empty if the clauses alone are UNSAT). */
+    const vector<int>& failedAssumptions() const { return solver.failedAssumptions; }
+
+    /** \brief Model of the last SAT answer. */
+    const vector<char>& model() const { return solver.model; }
+
+    /**
+     * \brief Answers a query with a freshly built solver, for latency comparison.
+     * \param assumptions Literals assumed true.
+     * \param ms Receives the time including loading the clauses.
+     * \return The outcome.
+     */
+    SolveResult solveCold(const vector<int>& assumptions, double& ms) const {
+        auto start = chrono::steady_clock::now();
+        CDCLSolver cold(db, solver.options);
+        SolveResult result = cold.solve(assumptions);
+        ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+/**
+ * \brief Prints a list of literals with atom names.
+ * \param db Supplies the atom names.
+ * \param lits The literals.
+ */
+void printLiteralList(const ClauseDB& db, const vector<int>& lits) {
+    for (size_t i = 0; i < lits.size(); ++i) cout << (i ? " " : "") << literalToString(db, lits[i]);
+}
+
+/* ---------------- END Incremental Solving ---------------- */
+
+/* ---------------- SAT-BASED VALIDITY AND EQUIVALENCE ---------------- */
+
+/**
+ * \struct TseitinEncoder
+ * \brief Encodes parse trees into an equisatisfiable clause database (Tseitin transformation).
+ *
+ * Every AND/OR gate gets a fresh variable constrained to equal the gate's value; chains of the
+ * same operator are flattened into one n-ary gate, negation costs no variable, and A > B is
+ * encoded as the gate ~A + B. The encoding is linear in the size of the tree, unlike
+ * \ref convertToCNF. Shared subtrees (DAGs) are encoded once. Atoms keep their names; gate
+ * variables are named "_g<n>", and the constants 1 and 0 are the two literals of a variable
+ * "_true" fixed by a unit clause.
+ */
+struct TseitinEncoder {
+    ClauseDB db;                          /**< Atoms and gate variables with their defining clauses. */
+    vector<int> atomVars;                 /**< Variables that stand for atoms, in order of appearance. */
+    unordered_map<string, int> atomIndex; /**< Atom name to variable. */
+    unordered_map<Node*, int> literalOf;  /**< Literal already assigned to an encoded subtree. */
+    int trueVar = -1;                     /**< Variable of the constants, -1 until one occurs. */
+
+    /** \brief Returns the variable of an atom, creating it on first use. */
+    int atom(const string& name) {
+        auto it = atomIndex.find(name);
+        if (it != atomIndex.end()) return it->second;
+        int v = db.numVars++;
+        db.names.push_back(name);
+        atomIndex[name] = v;
+        atomVars.push_back(v);
+        return v;
+    }
+
+    /** \brief Returns a variable fixed to true by a unit clause (for the constants 1 and 0). */
+    int constantTrue() {
+        if (trueVar < 0) {
+            trueVar = db.numVars++;
+            db.names.push_back("_true");
+            db.clauses.push_back({makeLiteral(trueVar, false)});
+        }
+        return trueVar;
+    }
+
+    /** \brief Collects the operands of a node; chains of the same AND/OR operator are flattened. */
+    static void operands(Node* node, vector<Node*>& out) {
+        out.clear();
+        if (node->value != "*" && node->value != "+") {
+            if (node->left) out.push_back(node->left);
+            if (node->right) out.push_back(node->right);
+            return;
+        }
+        vector<Node*> pending{node->right, node->left};
+        while (!pending.empty()) {
+            Node* n = pending.back();
+            pending.pop_back();
+            if (n->value == node->value && n->left && n->right) {
+                pending.push_back(n->right);
+                pending.push_back(n->left);
+            } else {
+                out.push_back(n);
+            }
+        }
+    }
+
+    /**
+     * \brief Encodes a formula and returns the literal equivalent to it.
+     *
+     * Iterative post-order traversal, so deep trees do not exhaust the call stack.
+     * \param root Root of the parse tree.
+     * \return A literal that is true exactly when the formula is (under the added clauses).
+     */
+    int encode(Node* root) {
+        vector<pair<Node*, bool>> stack{{root, false}};
+        vector<Node*> children;
+        vector<int> inputs;
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            if (literalOf.count(node)) continue;
+            if (!node->left && !node->right) {
+                literalOf[node] = isConstant(node->value) ? makeLiteral(constantTrue(), node->value == "0")
+                                                          : makeLiteral(atom(node->value), false);
+                continue;
+            }
+            operands(node, children);
+            if (!expanded) {
+                stack.push_back({node, true});
+                for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                    if (!literalOf.count(*it)) stack.push_back({*it, false}); // leftmost is encoded first
+                }
+                continue;
+            }
+
+            inputs.clear();
+            for (Node* child : children) inputs.push_back(literalOf[child]);
+            if (node->value == "~") {
+                literalOf[node] = negateLiteral(inputs[0]);
+                continue;
+            }
+            bool isAnd = (node->value == "*");
+            if (node->value == ">") inputs[0] = negateLiteral(inputs[0]); // A > B == ~A + B
+
+            int gate = makeLiteral(db.numVars++, false);
+            db.names.push_back("_g" + to_string(db.numVars - atomVars.size()));
+            // AND: gate -> every input, all inputs -> gate; OR is the dual
+            vector<int> big{isAnd ? gate : negateLiteral(gate)};
+            for (int in : inputs) {
+                if (isAnd) {
+                    db.clauses.push_back({negateLiteral(gate), in});
+                    big.push_back(negateLiteral(in));
+                } else {
+                    db.clauses.push_back({gate, negateLiteral(in)});
+                    big.push_back(in);
+                }
+            }
+            db.clauses.push_back(big);
+            literalOf[node] = gate;
+        }
+        return literalOf[root];
+    }
+
+    /**
+     * \brief Extracts the atom part of a model.
+     * \param model A model of \ref db.
+     * \return Every atom with its value, in order of appearance.
+     */
+    vector<pair<string, bool>> atomAssignment(const vector<char>& model) const {
+        vector<pair<string, bool>> out;
+        for (int v : atomVars) out.push_back({db.names[v], v < (int)model.size() && model[v]});
+        return out;
+    }
+};
+
+/**
+ * \struct SatCheckResult
+ * \brief Outcome of \ref checkValidity or \ref checkEquivalence.
+ */
+struct SatCheckResult {
+    bool holds = false;                         /**< true if the formula is valid (or the formulas are equivalent). */
+    bool decided = false;                       /**< false if the solver gave up (budget). */
+    vector<pair<string, bool>> counterexample;  /**< Assignment of all atoms refuting the claim, if any. */
+    size_t variables = 0;                       /**< Variables of the encoding (atoms and gates). */
+    size_t clauses = 0;                         /**< Clauses of the encoding. */
+    double ms = 0;                              /**< Encoding plus solving time. */
+};
+
+/**
+ * \brief Solves an encoding with a unit assumption and fills a \ref SatCheckResult.
+ * \param encoder The encoding.
+ * \param goal Literal whose satisfiability refutes the claim.
+ * \param start Start time of the check.
+ * \return The result.
+ */
+SatCheckResult solveSatCheck(const TseitinEncoder& encoder, int goal, chrono::steady_clock::time_point start) {
+    SatCheckResult out;
+    out.variables = encoder.db.numVars;
+    out.clauses = encoder.db.clauses.size() + 1;
+    CDCLSolver solver(encoder.db, SolverOptions());
+    SolveResult result = solver.solve({goal});
+    out.decided = (result != SolveResult::UNKNOWN);
+    out.holds = (result == SolveResult::UNSAT);
+    if (result == SolveResult::SAT) out.counterexample = encoder.atomAssignment(solver.model);
+    out.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+/**
+ * \brief Decides whether a formula is valid (a tautology) with a SAT solver.
+ *
+ * The formula is valid iff its negation is unsatisfiable. The negation is Tseitin-encoded and
+ * solved by \ref CDCLSolver; a model is a counterexample. Unlike \ref generateTruthTable and the
+ * CNF clause check, nothing here is exponential in the number of atoms up front.
+ * \param formula Root of the parse tree (not modified).
+ * \return The verdict and, if the formula is not valid, an assignment that falsifies it.
+ */
+SatCheckResult checkValidity(Node* formula) {
+    auto start = chrono::steady_clock::now();
+    TseitinEncoder encoder;
+    int root = encoder.encode(formula);
+    return solveSatCheck(encoder, negateLiteral(root), start);
+}
+
+/**
+ * \brief Decides whether two formulas are equivalent with a miter.
+ *
+ * Both formulas are encoded over shared atoms and a XOR gate of their outputs is asserted; the
+ * formulas are equivalent iff that is unsatisfiable. A model assigns the atoms so that the
+ * formulas differ.
+ * \param a Root of the first parse tree.
+ * \param b Root of the second parse tree.
+ * \return The verdict and, if they differ, a distinguishing assignment.
+ */
+SatCheckResult checkEquivalence(Node* a, Node* b) {
+    auto start = chrono::steady_clock::now();
+    TseitinEncoder encoder;
+    int left = encoder.encode(a);
+    int right = encoder.encode(b);
+    int miter = makeLiteral(encoder.db.numVars++, false);
+    encoder.db.names.push_back("_miter");
+    // miter <-> (left xor right)
+    encoder.db.clauses.push_back({negateLiteral(miter), left, right});
+    encoder.db.clauses.push_back({negateLiteral(miter), negateLiteral(left), negateLiteral(right)});
+    encoder.db.clauses.push_back({miter, negateLiteral(left), right});
+    encoder.db.clauses.push_back({miter, left, negateLiteral(right)});
+    return solveSatCheck(encoder, miter, start);
+}
+
+/**
+ * \brief Prints a counterexample assignment.
+ * \param assignment Atom values.
+ */
+void printAssignment(const vector<pair<string, bool>>& assignment) {
+    for (const auto& [name, value] : assignment) cout << " " << name << "=" << (value ? 1 : 0);
+    cout << endl;
+}
+
+/* ---------------- END SAT-Based Validity and Equivalence ---------------- */
+
+/* ---------------- DRAT PROOF CHECKER ---------------- */
+
+/**
+ * \struct DratCheckResult
+ * \brief Outcome and statistics of \ref checkDratProof.
+ */
+struct DratCheckResult {
+    bool verified = false;        /**< true if the proof refutes the formula. */
+    string message;               /**< Why verification failed (empty on success). */
+    size_t lemmas = 0;            /**< Clauses added by the proof up to the empty clause. */
+    size_t deletions = 0;         /**< Deletions applied. */
+    size_t ignoredDeletions = 0;  /**< Deletions of clauses that were not present. */
+    size_t coreLemmas = 0;        /**< Lemmas that had to be checked (used by the refutation). */
+    size_t coreOriginals = 0;     /**< Original clauses used by the refutation (an unsatisfiable core). */
+    size_t ratLemmas = 0;         /**< Lemmas that needed a RAT check. */
+    double parseMs = 0;           /**< Reading the proof. */
+    double checkMs = 0;           /**< Backward checking. */
+};
+
+/**
+ * \struct DratChecker
+ * \brief Backward DRAT checker with core-first unit propagation.
+ *
+ * The proof is replayed forward up to the empty clause, only updating which clauses are active.
+ * Checking then runs backward: every lemma is deactivated in turn and, if an already verified
+ * step used it (it is in the core), checked by reverse unit propagation (RUP): its negation is
+ * assigned and propagation must reach a conflict. Propagation prefers core clauses, so the
+ * clauses marked while explaining each conflict stay few. Lemmas that are not RUP are checked
+ * for the RAT property on their first literal; the resolution candidates come from per-literal
+ * occurrence lists and are split over threads when there are many. Every propagation starts from
+ * an empty assignment, so lemmas and deletions only toggle flags and watch lists never have to
+ * be repaired.
+ *
+ * Propagation reorders clause literals, so each RAT thread needs its own checker. The helpers are
+ * copied once, at the first RAT lemma that uses them, and afterwards only replay the log of
+ * active/core flag changes (\ref setActive, \ref markCore) they have not seen yet.
+ */
+struct DratChecker {
+    int numVars = 0;               /**< Number of variables. */
+    vector<int> literals;          /**< Literals of all clauses, clause after clause. */
+    vector<size_t> start;          /**< Offset of each clause in \ref literals. */
+    vector<int> length;            /**< Length of each clause. */
+    vector<int> pivot;             /**< First literal of each lemma as written (RAT pivot), or -1. */
+    vector<char> active;           /**< Clause is part of the current formula. */
+    vector<char> core;             /**< Clause was used by a verified step. */
+    size_t numOriginal = 0;        /**< Clauses 0..numOriginal-1 are the input formula. */
+    vector<pair<int, bool>> steps; /**< Proof steps: clause and whether it is a deletion. */
+    int emptyClause = -1;          /**< Clause id of the empty clause, or -1. */
+    size_t ignoredDeletions = 0;   /**< Deletions that matched no active clause. */
+
+    vector<vector<int>> watches;   /**< watches[l]: clauses watching l, visited when l becomes false. */
+    vector<int> units;             /**< Unit clauses. */
+    vector<int8_t> value;          /**< value[lit]: 1 true, -1 false, 0 unassigned. */
+    vector<int> reason;            /**< Clause that implied each variable, or -1. */
+    vector<int> trail;             /**< Assigned literals. */
+    vector<char> seen;             /**< Scratch marks for conflict analysis. */
+    vector<int> used;              /**< Clauses used by the last explained conflict. */
+    vector<vector<int>> occurs;    /**< occurs[l]: clauses containing l (active or not). */
+
+    vector<int> changes;           /**< Clauses whose active or core flag changed, in order. */
+    size_t synced = 0;             /**< In a helper: entries of the main checker's \ref changes applied. */
+    vector<DratChecker> helpers;   /**< Checkers of the extra RAT threads, created on first use. */
+
+    /** \brief Literals of clause \p id. */
+    int* lits(int id) { return &literals[start[id]]; }
+
+    /** \brief Adds variables so that there are at least \p n. */
+    void growTo(int n) {
+        if (n <= numVars) return;
+        numVars = n;
+        watches.resize(2 * (size_t)n);
+        occurs.resize(2 * (size_t)n);
+        value.resize(2 * (size_t)n, 0);
+        reason.resize(n, -1);
+        seen.resize(n, 0);
+    }
+
+    /**
+     * \brief Stores and watches a clause.
+     * \param clause Sorted, duplicate-free literals.
+     * \param first The first literal as written (RAT pivot), or -1.
+     * \return The clause id.
+     */
+    int storeClause(const vector<int>& clause, int first) {
+        for (int lit : clause) growTo(literalVar(lit) + 1);
+        int id = (int)start.size();
+        start.push_back(literals.size());
+        length.push_back((int)clause.size());
+        pivot.push_back(first);
+        active.push_back(1);
+        core.push_back(0);
+        literals.insert(literals.end(), clause.begin(), clause.end());
+        for (int lit : clause) occurs[lit].push_back(id);
+        if (clause.size() == 1) units.push_back(id);
+        if (clause.size() >= 2) {
+            watches[clause[0]].push_back(id);
+            watches[clause[1]].push_back(id);
+        }
+        return id;
+    }
+
+    /**
+     * \brief Loads the formula and a binary DRAT proof, replaying it up to the empty clause.
+     * \param db The formula.
+     * \param path The proof file.
+     * \param error Receives a message on failure.
+     * \return true if the proof could be read.
+     */
+    bool load(const ClauseDB& db, const string& path, string& error) {
+        growTo(db.numVars);
+        unordered_map<uint64_t, vector<int>> byHash;
+        vector<int> clause;
+        auto normalize = [&](vector<int>& c) {
+            sort(c.begin(), c.end());
+            c.erase(unique(c.begin(), c.end()), c.end());
+        };
+        for (const auto& original : db.clauses) {
+            clause = original;
+            normalize(clause);
+            int id = storeClause(clause, -1);
+            byHash[clauseHash(clause)].push_back(id);
+            if (clause.empty() && emptyClause < 0) emptyClause = id;
+        }
+        numOriginal = start.size();
+
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            error = "cannot open proof file " + path;
+            return false;
+        }
+        vector<uint8_t> data;
+        uint8_t chunk[1 << 16];
+        size_t got;
+        while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + got);
+        fclose(file);
+
+        size_t pos = 0;
+        while (pos < data.size() && emptyClause < 0) {
+            uint8_t kind = data[pos++];
+            if (kind != 'a' && kind != 'd') {
+                error = "not a binary DRAT proof (byte " + to_string(pos - 1) + ")";
+                return false;
+            }
+            clause.clear();
+            while (true) {
+                unsigned u = 0;
+                int shift = 0;
+                uint8_t byte;
+                do {
+                    if (pos >= data.size()) {
+                        error = "truncated proof";
+                        return false;
+                    }
+                    byte = data[pos++];
+                    u |= (unsigned)(byte & 127) << shift;
+                    shift += 7;
+                } while ((byte & 128) && shift < 32);
+                if (u == 0) break;
+                if (u < 2) {
+                    error = "invalid literal in proof";
+                    return false;
+                }
+                clause.push_back((int)u - 2);
+            }
+            int first = clause.empty() ? -1 : clause[0];
+            normalize(clause);
+            if (kind == 'a') {
+                int id = storeClause(clause, first);
+                byHash[clauseHash(clause)].push_back(id);
+                steps.push_back({id, false});
+                if (clause.empty()) emptyClause = id;
+                continue;
+            }
+            auto it = byHash.find(clauseHash(clause));
+            int match = -1;
+            if (it != byHash.end()) {
+                for (size_t k = it->second.size(); k-- > 0;) {
+                    int id = it->second[k];
+                    if (length[id] == (int)clause.size() && equal(clause.begin(), clause.end(), lits(id))) {
+                        match = id;
+                        it->second.erase(it->second.begin() + k);
+                        break;
+                    }
+                }
+            }
+            if (match < 0) {
+                ignoredDeletions++;
+                continue;
+            }
+            active[match] = 0;
+            steps.push_back({match, true});
+        }
+        if (emptyClause < 0) {
+            error = "the proof does not derive the empty clause";
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief Activates or deactivates clause \p id, logging the change for the helpers. */
+    void setActive(int id, bool on) {
+        if ((bool)active[id] == on) return;
+        active[id] = on;
+        changes.push_back(id);
+    }
+
+    /** \brief Adds clause \p id to the core, logging the change for the helpers. */
+    void markCore(int id) {
+        if (core[id]) return;
+        core[id] = 1;
+        changes.push_back(id);
+    }
+
+    /** \brief In a helper: applies the flag changes of \p main made since the last call. */
+    void syncFrom(const DratChecker& main) {
+        for (; synced < main.changes.size(); ++synced) {
+            int id = main.changes[synced];
+            active[id] = main.active[id];
+            core[id] = main.core[id];
+        }
+    }
+
+    /** \brief Assigns \p lit true. */
+    void assign(int lit, int from) {
+        value[lit] = 1;
+        value[negateLiteral(lit)] = -1;
+        reason[literalVar(lit)] = from;
+        trail.push_back(lit);
+    }
+
+    /** \brief Clears the assignment. */
+    void reset() {
+        for (int lit : trail) {
+            value[lit] = 0;
+            value[negateLiteral(lit)] = 0;
+            reason[literalVar(lit)] = -1;
+        }
+        trail.clear();
+    }
+
+    /**
+     * \brief Visits the clauses watching ~p of one kind (core or not) after p became true.
+     * \return A conflicting clause, or -1.
+     */
+    int visit(int p, bool coreClauses) {
+        int falseLit = negateLiteral(p);
+        vector<int>& ws = watches[falseLit];
+        size_t i = 0, j = 0, n = ws.size();
+        while (i < n) {
+            int id = ws[i];
+            if (!active[id] || (bool)core[id] != coreClauses) {
+                ws[j++] = ws[i++];
+                continue;
+            }
+            int* c = lits(id);
+            if (c[0] == falseLit) swap(c[0], c[1]);
+            i++;
+            if (value[c[0]] == 1) {
+                ws[j++] = id;
+                continue;
+            }
+            bool moved = false;
+            for (int k = 2; k < length[id]; ++k) {
+                if (value[c[k]] != -1) {
+                    swap(c[1], c[k]);
+                    watches[c[1]].push_back(id);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved) continue;
+            ws[j++] = id;
+            if (value[c[0]] == -1) {
+                while (i < n) ws[j++] = ws[i++];
+                ws.resize(j);
+                return id;
+            }
+            assign(c[0], id);
+        }
+        ws.resize(j);
+        return -1;
+    }
+
+    /**
+     * \brief Core-first unit propagation: core clauses run to a fixpoint before each step that
+     * needs a non-core clause.
+     * \return A conflicting clause, or -1.
+     */
+    int propagate() {
+        size_t coreHead = 0, otherHead = 0;
+        while (true) {
+            while (coreHead < trail.size()) {
+                int conflict = visit(trail[coreHead++], true);
+                if (conflict >= 0) return conflict;
+            }
+            if (otherHead >= trail.size()) return -1;
+            int conflict = visit(trail[otherHead++], false);
+            if (conflict >= 0) return conflict;
+        }
+    }
+
+    /**
+     * \brief Assigns the negation of a clause plus all active units and propagates.
+     * \return A conflicting clause, -1 if there is no conflict, or -2 if the clause is a tautology.
+     */
+    int refute(const int* c, int size) {
+        for (int i = 0; i < size; ++i) {
+            int lit = negateLiteral(c[i]);
+            if (value[lit] == -1) return -2;
+            if (value[lit] == 0) assign(lit, -1);
+        }
+        for (int pass = 1; pass >= 0; --pass) { // core units first
+            for (int id : units) {
+                if (!active[id] || core[id] != pass) continue;
+                int u = lits(id)[0];
+                if (value[u] == -1) return id;
+                if (value[u] == 0) assign(u, id);
+            }
+        }
+        return propagate();
+    }
+
+    /** \brief Collects into \ref used the clauses that led to \p conflict. */
+    void explain(int conflict) {
+        used.push_back(conflict);
+        for (int k = 0; k < length[conflict]; ++k) seen[literalVar(lits(conflict)[k])] = 1;
+        for (size_t i = trail.size(); i-- > 0;) {
+            int v = literalVar(trail[i]);
+            if (!seen[v]) continue;
+            seen[v] = 0;
+            int from = reason[v];
+            if (from < 0) continue;
+            used.push_back(from);
+            for (int k = 0; k < length[from]; ++k) {
+                int w = literalVar(lits(from)[k]);
+                if (w != v) seen[w] = 1;
+            }
+        }
+    }
+
+    /**
+     * \brief RUP check of a clause; on success the clauses used are appended to \ref used.
+     * \return true if the clause is implied by unit propagation.
+     */
+    bool isRUP(const int* c, int size) {
+        int conflict = refute(c, size);
+        if (conflict >= 0) explain(conflict);
+        reset();
+        return conflict != -1;
+    }
+
+    /**
+     * \brief RAT check of lemma \p id on \p pivotLit over candidates [lo, hi).
+     * \param stop Set (and polled) when some resolvent fails.
+     * \return true if every resolvent is RUP.
+     */
+    bool checkResolvents(int id, int pivotLit, const vector<int>& candidates, size_t lo, size_t hi,
+                         atomic<bool>& stop) {
+        vector<int> resolvent;
+        for (size_t k = lo; k < hi && !stop; ++k) {
+            int other = candidates[k];
+            resolvent.assign(lits(id), lits(id) + length[id]);
+            for (int j = 0; j < length[other]; ++j) {
+                if (lits(other)[j] != negateLiteral(pivotLit)) resolvent.push_back(lits(other)[j]);
+            }
+            used.push_back(other);
+            if (!isRUP(resolvent.data(), (int)resolvent.size())) {
+                stop = true;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Checks lemma \p id by RUP, falling back to RAT on its first literal.
+     * \param threads Threads for RAT candidates.
+     * \param ratLemmas Incremented when RAT is needed.
+     * \return true if the lemma is valid.
+     */
+    bool checkLemma(int id, int threads, size_t& ratLemmas) {
+        used.clear();
+        bool ok = isRUP(lits(id), length[id]);
+        if (!ok && pivot[id] >= 0) {
+            ratLemmas++;
+            int pivotLit = pivot[id];
+            vector<int> candidates;
+            for (int other : occurs[negateLiteral(pivotLit)]) {
+                if (active[other]) candidates.push_back(other);
+            }
+            atomic<bool> stop{false};
+            int workers = (candidates.size() >= 64) ? max(1, threads) : 1;
+            if (workers == 1) {
+                ok = checkResolvents(id, pivotLit, candidates, 0, candidates.size(), stop);
+            } else {
+                if (helpers.size() < (size_t)workers - 1) {
+                    DratChecker prototype(*this); // copied while helpers is empty, so it has none
+                    prototype.synced = changes.size();
+                    helpers.assign(workers - 1, prototype);
+                }
+                vector<char> results(workers, 1);
+                vector<thread> pool;
+                size_t chunk = (candidates.size() + workers - 1) / workers;
+                for (int w = 1; w < workers; ++w) {
+                    pool.emplace_back([&, w] {
+                        DratChecker& helper = helpers[w - 1];
+                        size_t lo = min(candidates.size(), w * chunk), hi = min(candidates.size(), lo + chunk);
+                        helper.syncFrom(*this);
+                        helper.used.clear();
+                        results[w] = helper.checkResolvents(id, pivotLit, candidates, lo, hi, stop);
+                    });
+                }
+                results[0] = checkResolvents(id, pivotLit, candidates, 0, min(candidates.size(), chunk), stop);
+                for (thread& t : pool) t.join();
+                ok = all_of(results.begin(), results.end(), [](char r) { return r != 0; });
+                for (int w = 1; w < workers; ++w) used.insert(used.end(), helpers[w - 1].used.begin(), helpers[w - 1].used.end());
+            }
+        }
+        if (ok) {
+            for (int c : used) markCore(c);
+        }
+        return ok;
+    }
+};
+
+/**
+ * \brief Verifies a binary DRAT refutation of a clause database.
+ * \param db The formula.
+ * \param path The proof file (as written by \ref DratProofWriter).
+ * \param threads Threads used for RAT checks.
+ * \return Verdict and statistics.
+ */
+DratCheckResult checkDratProof(const ClauseDB& db, const string& path, int threads = 1) {
+    DratCheckResult out;
+    DratChecker checker;
+    auto start = chrono::steady_clock::now();
+    bool loaded = checker.load(db, path, out.message);
+    out.parseMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out.ignoredDeletions = checker.ignoredDeletions;
+    if (!loaded) return out;
+    for (const auto& s : checker.steps) {
+        if (s.second) out.deletions++;
+        else out.lemmas++;
+    }
+
+    start = chrono::steady_clock::now();
+    int last = (int)checker.steps.size() - 1;
+    if (checker.emptyClause < (int)checker.numOriginal) {
+        last = -1; // the formula itself contains the empty clause
+    } else {
+        checker.setActive(checker.emptyClause, false);
+        last--;
+        checker.used.clear();
+        if (!checker.isRUP(nullptr, 0)) {
+            out.message = "the empty clause is not implied by unit propagation";
+            return out;
+        }
+        for (int c : checker.used) checker.markCore(c);
+    }
+    for (int i = last; i >= 0; --i) {
+        auto [id, deletion] = checker.steps[i];
+        if (deletion) {
+            checker.setActive(id, true);
+            continue;
+        }
+        checker.setActive(id, false);
+        if (!checker.core[id]) continue;
+        out.coreLemmas++;
+        if (!checker.checkLemma(id, threads, out.ratLemmas)) {
+            out.message = "lemma " + to_string(id - checker.numOriginal + 1) + " is neither RUP nor RAT";
+            out.checkMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            return out;
+        }
+    }
+    out.checkMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    for (size_t c = 0; c < checker.numOriginal; ++c) out.coreOriginals += checker.core[c];
+    out.verified = true;
+    return out;
+}
+
+/* ---------------- END DRAT Proof Checker ---------------- */
+
+/* ---------------- PREPROCESSING (BVE / BCE / SUBSUMPTION) ---------------- */
+
+/**
+ * \struct PreprocessOptions
+ * \brief Switches and budgets of \ref Preprocessor.
+ */
+struct PreprocessOptions {
+    bool subsumption = true;           /**< Backward subsumption and self-subsuming resolution. */
+    bool variableElimination = true;   /**< Bounded variable elimination. */
+    bool blockedClauses = true;        /**< Blocked clause elimination. */
+    int maxResolventLength = 20;       /**< Do not eliminate a variable that yields a longer resolvent. */
+    int maxOccurrences = 64;           /**< Skip variables (and blocking literals) with more occurrences per polarity. */
+    int maxRounds = 3;                 /**< Rounds of subsumption, elimination and BCE. */
+    long long stepBudget = 100000000;  /**< Literal visits before giving up. */
+    double timeLimitMs = 5000;         /**< Wall-clock budget. */
+};
+
+/**
+ * \struct PreprocessStats
+ * \brief What \ref Preprocessor removed.
+ */
+struct PreprocessStats {
+    size_t originalVars = 0, originalClauses = 0;   /**< Size of the input. */
+    size_t remainingVars = 0, remainingClauses = 0; /**< Size of the output (variables that still occur). */
+    size_t eliminatedVars = 0;                      /**< Variables removed by resolution. */
+    size_t resolvents = 0;                          /**< Resolvents added by elimination. */
+    size_t blockedClauses = 0;                      /**< Clauses removed as blocked. */
+    size_t subsumedClauses = 0;                     /**< Clauses removed by subsumption. */
+    size_t strengthenedClauses = 0;                 /**< Literals removed by self-subsuming resolution. */
+    size_t units = 0;                               /**< Variables fixed by unit propagation. */
+    long long steps = 0;                            /**< Literal visits spent. */
+    bool budgetExhausted = false;                   /**< Stopped by the step or time budget. */
+    double ms = 0;                                  /**< Run time. */
+};
+
+/**
+ * \struct Preprocessor
+ * \brief SatELite-style CNF preprocessing with model reconstruction.
+ *
+ * Clauses are kept sorted with exact occurrence lists per literal. Three techniques run in
+ * rounds until nothing changes or a budget is exhausted:
+ * - backward subsumption and self-subsuming resolution (strengthening) from every new or
+ *   changed clause, filtered by 64-bit variable signatures;
+ * - bounded variable elimination in order of increasing occ(x) * occ(~x) (a \ref VarOrderHeap
+ *   on negated costs): x is replaced by all non-tautological resolvents if they are no more
+ *   than the clauses they replace;
+ * - blocked clause elimination: a clause is dropped if all resolvents on one of its literals are
+ *   tautologies.
+ *
+ * Every removed clause that is not implied by the rest goes on an elimination stack together
+ * with a witness literal; \ref extendModel walks it backwards and flips witnesses to turn a model
+ * of the simplified formula into a model of the original.
+ */
+struct Preprocessor {
+    PreprocessOptions options;               /**< Configuration. */
+    PreprocessStats stats;                   /**< Counters. */
+    int numVars = 0;                         /**< Number of variables. */
+    bool unsat = false;                      /**< The empty clause was derived. */
+
+    vector<vector<int>> clauses;             /**< Sorted clauses (empty once removed). */
+    vector<char> removed;                    /**< Clause was removed. */
+    vector<uint64_t> signature;              /**< Variable signature of each clause. */
+    vector<vector<int>> occurrences;         /**< occurrences[lit]: clauses containing lit. */
+    vector<int8_t> value;                    /**< Top-level assignment: value[lit] 1, -1 or 0. */
+    vector<int> unitQueue;                   /**< Assigned literals not yet propagated. */
+    vector<char> eliminated;                 /**< Variable was eliminated. */
+    vector<char> frozen;                     /**< Variable must be kept (e.g. used in assumptions). */
+    vector<int> subsumeQueue;                /**< Clauses to subsume/strengthen others with. */
+    vector<char> queued;                     /**< Clause is in \ref subsumeQueue. */
+    vector<pair<int, vector<int>>> eliminationStack; /**< (witness literal, removed clause). */
+
+    vector<double> cost;                     /**< Negated elimination cost, the key of \ref order. */
+    VarOrderHeap order;                      /**< Elimination candidates, cheapest first. */
+    bool ordering = false;                   /**< Keep \ref order up to date with occurrence changes. */
+    vector<uint32_t> mark;                   /**< Literal stamps for tautology and subset tests. */
+    uint32_t stamp = 0;                      /**< Current stamp. */
+    chrono::steady_clock::time_point start;  /**< Start of \ref run. */
+
+    /**
+     * \brief Loads a clause database.
+     * \param db The formula.
+     * \param opts Options.
+     * \param frozenVars Variables that must not be eliminated (may be empty).
+     */
+    Preprocessor(const ClauseDB& db, const PreprocessOptions& opts = PreprocessOptions(),
+                 const vector<int>& frozenVars = {})
+        : options(opts), numVars(db.numVars) {
+        occurrences.resize(2 * (size_t)numVars);
+        value.assign(2 * (size_t)numVars, 0);
+        eliminated.assign(numVars, 0);
+        frozen.assign(numVars, 0);
+        for (int v : frozenVars) frozen[v] = 1;
+        mark.assign(2 * (size_t)numVars, 0);
+        cost.assign(numVars, 0.0);
+        order.activity = &cost;
+        order.position.assign(numVars, -1);
+        stats.originalVars = numVars;
+        stats.originalClauses = db.clauses.size();
+        for (const auto& clause : db.clauses) {
+            addClause(clause);
+            if (unsat) break;
+        }
+    }
+
+    /** \brief Starts a new literal stamp. */
+    void newStamp() {
+        if (++stamp == 0) {
+            fill(mark.begin(), mark.end(), 0);
+            stamp = 1;
+        }
+    }
+
+    /** \brief true once the step or time budget is used up. */
+    bool outOfBudget() {
+        if (stats.budgetExhausted) return true;
+        if (stats.steps > options.stepBudget ||
+            chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() > options.timeLimitMs)
+            stats.budgetExhausted = true;
+        return stats.budgetExhausted;
+    }
+
+    /** \brief Updates the elimination cost of v after its occurrences changed. */
+    void touch(int v) {
+        if (!ordering || eliminated[v] || frozen[v] || value[makeLiteral(v, false)] != 0) return;
+        double before = cost[v];
+        cost[v] = -(double)occurrences[makeLiteral(v, false)].size() * (double)occurrences[makeLiteral(v, true)].size();
+        if (!order.contains(v)) order.insert(v);
+        else if (cost[v] > before) order.increased(v);
+        else order.decreased(v);
+    }
+
+    /** \brief Assigns \p lit at the top level. */
+    void assign(int lit) {
+        if (value[lit] == 1) return;
+        if (value[lit] == -1) {
+            unsat = true;
+            return;
+        }
+        value[lit] = 1;
+        value[negateLiteral(lit)] = -1;
+        unitQueue.push_back(lit);
+        stats.units++;
+    }
+
+    /** \brief Removes \p id from the occurrence list of \p lit. */
+    void dropOccurrence(int lit, int id) {
+        vector<int>& list = occurrences[lit];
+        auto it = find(list.begin(), list.end(), id);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+        stats.steps += list.size();
+        touch(literalVar(lit));
+    }
+
+    /** \brief Recomputes the variable signature of clause \p id. */
+    void computeSignature(int id) {
+        uint64_t sig = 0;
+        for (int lit : clauses[id]) sig |= 1ULL << (literalVar(lit) & 63);
+        signature[id] = sig;
+    }
+
+    /** \brief Queues clause \p id for subsumption checks. */
+    void enqueueSubsumption(int id) {
+        if (options.subsumption && !queued[id]) {
+            queued[id] = 1;
+            subsumeQueue.push_back(id);
+        }
+    }
+
+    /**
+     * \brief Adds a clause: false literals are dropped, satisfied and tautological clauses are
+     * ignored, units are assigned.
+     * \param lits The literals.
+     */
+    void addClause(vector<int> lits) {
+        sort(lits.begin(), lits.end());
+        lits.erase(unique(lits.begin(), lits.end()), lits.end());
+        size_t keep = 0;
+        for (size_t i = 0; i < lits.size(); ++i) {
+            if (value[lits[i]] == 1 || (i + 1 < lits.size() && lits[i + 1] == negateLiteral(lits[i]))) return;
+            if (value[lits[i]] == 0) lits[keep++] = lits[i];
+        }
+        lits.resize(keep);
+        if (lits.empty()) {
+            unsat = true;
+            return;
+        }
+        if (lits.size() == 1) {
+            assign(lits[0]);
+            return;
+        }
+        int id = (int)clauses.size();
+        clauses.push_back(std::move(lits));
+        removed.push_back(0);
+        signature.push_back(0);
+        queued.push_back(0);
+        computeSignature(id);
+        for (int lit : clauses[id]) {
+            occurrences[lit].push_back(id);
+            touch(literalVar(lit));
+        }
+        enqueueSubsumption(id);
+    }
+
+    /** \brief Removes clause \p id (optionally saving it on the elimination stack first). */
+    void removeClause(int id, int witness = -1) {
+        if (removed[id]) return;
+        removed[id] = 1;
+        if (witness >= 0) eliminationStack.push_back({witness, clauses[id]});
+        for (int lit : clauses[id]) dropOccurrence(lit, id);
+        clauses[id].clear();
+        clauses[id].shrink_to_fit();
+    }
+
+    /** \brief Removes literal \p lit from clause \p id. */
+    void strengthen(int id, int lit) {
+        vector<int>& c = clauses[id];
+        c.erase(find(c.begin(), c.end(), lit));
+        dropOccurrence(lit, id);
+        if (c.size() == 1) {
+            assign(c[0]);
+            removeClause(id);
+            return;
+        }
+        computeSignature(id);
+        enqueueSubsumption(id);
+    }
+
+    /** \brief Propagates queued units: satisfied clauses are removed, false literals dropped. */
+    void propagateUnits() {
+        while (!unitQueue.empty() && !unsat) {
+            int lit = unitQueue.back();
+            unitQueue.pop_back();
+            vector<int> satisfied = occurrences[lit];
+            for (int id : satisfied) removeClause(id);
+            vector<int> shortened = occurrences[negateLiteral(lit)];
+            for (int id : shortened) {
+                if (!removed[id]) strengthen(id, negateLiteral(lit));
+            }
+        }
+    }
+
+    /**
+     * \brief Uses clause \p id to remove the clauses it subsumes and to strengthen those it
+     * self-subsumes.
+     */
+    void subsumeWith(int id) {
+        if (removed[id]) return;
+        const vector<int> c = clauses[id];
+        int best = c[0];
+        for (int lit : c) {
+            size_t size = occurrences[lit].size() + occurrences[negateLiteral(lit)].size();
+            if (size < occurrences[best].size() + occurrences[negateLiteral(best)].size()) best = lit;
+        }
+        newStamp();
+        for (int lit : c) mark[lit] = stamp;
+        for (int polarity = 0; polarity < 2; ++polarity) {
+            vector<int> candidates = occurrences[polarity ? negateLiteral(best) : best];
+            stats.steps += candidates.size();
+            for (int other : candidates) {
+                if (other == id || removed[other] || clauses[other].size() < c.size()) continue;
+                if (signature[id] & ~signature[other]) continue;
+                // Count literals of c in other; at most one may appear negated
+                size_t found = 0;
+                int flipped = -1;
+                for (int lit : clauses[other]) {
+                    if (mark[lit] == stamp) found++;
+                    else if (mark[negateLiteral(lit)] == stamp && flipped < 0) {
+                        flipped = lit;
+                        found++;
+                    }
+                }
+                stats.steps += clauses[other].size();
+                if (found < c.size()) continue;
+                if (flipped < 0) {
+                    removeClause(other);
+                    stats.subsumedClauses++;
+                } else {
+                    strengthen(other, flipped);
+                    stats.strengthenedClauses++;
+                }
+                if (unsat) return;
+            }
+        }
+    }
+
+    /** \brief Processes the subsumption queue and pending units. */
+    void drainQueues() {
+        propagateUnits();
+        while (!subsumeQueue.empty() && !unsat && !outOfBudget()) {
+            int id = subsumeQueue.back();
+            subsumeQueue.pop_back();
+            queued[id] = 0;
+            subsumeWith(id);
+            propagateUnits();
+        }
+    }
+
+    /**
+     * \brief Resolves two clauses on variable \p v.
+     * \return false if the resolvent is a tautology.
+     */
+    bool resolve(const vector<int>& a, const vector<int>& b, int v, vector<int>& out) {
+        out.clear();
+        size_t i = 0, j = 0;
+        while (i < a.size() || j < b.size()) {
+            int lit;
+            if (j >= b.size() || (i < a.size() && a[i] < b[j])) lit = a[i++];
+            else if (i >= a.size() || b[j] < a[i]) lit = b[j++];
+            else {
+                lit = a[i++];
+                j++;
+            }
+            if (literalVar(lit) == v) continue;
+            if (!out.empty() && out.back() == negateLiteral(lit)) return false; // sorted: ~l follows l
+            out.push_back(lit);
+        }
+        stats.steps += a.size() + b.size();
+        return true;
+    }
+
+    /**
+     * \brief Eliminates variable \p v if its resolvents are no more than its clauses.
+     * \return true if v was eliminated.
+     */
+    bool tryEliminate(int v) {
+        if (eliminated[v] || frozen[v] || value[makeLiteral(v, false)] != 0) return false;
+        const vector<int>& pos = occurrences[makeLiteral(v, false)];
+        const vector<int>& neg = occurrences[makeLiteral(v, true)];
+        if ((int)pos.size() > options.maxOccurrences || (int)neg.size() > options.maxOccurrences) return false;
+        size_t limit = pos.size() + neg.size();
+        vector<vector<int>> resolvents;
+        vector<int> resolvent;
+        for (int p : pos) {
+            for (int n : neg) {
+                if (!resolve(clauses[p], clauses[n], v, resolvent)) continue;
+                if ((int)resolvent.size() > options.maxResolventLength || resolvents.size() >= limit) return false;
+                resolvents.push_back(resolvent);
+            }
+        }
+        vector<int> posCopy = pos, negCopy = neg;
+        eliminated[v] = 1;
+        for (int id : posCopy) removeClause(id, makeLiteral(v, false));
+        for (int id : negCopy) removeClause(id, makeLiteral(v, true));
+        stats.eliminatedVars++;
+        stats.resolvents += resolvents.size();
+        for (auto& r : resolvents) {
+            addClause(std::move(r));
+            if (unsat) break;
+        }
+        return true;
+    }
+
+    /** \brief Runs variable elimination over all candidates in cost order. */
+    bool eliminateVariables() {
+        bool changed = false;
+        ordering = true;
+        for (int v = 0; v < numVars; ++v) touch(v);
+        while (!order.heap.empty() && !unsat && !outOfBudget()) {
+            int v = order.pop();
+            if (tryEliminate(v)) {
+                changed = true;
+                drainQueues();
+            }
+        }
+        ordering = false;
+        order.heap.clear();
+        fill(order.position.begin(), order.position.end(), -1);
+        return changed;
+    }
+
+    /**
+     * \brief true if every resolvent of clause \p id on \p lit is a tautology.
+     */
+    bool isBlocked(int id, int lit) {
+        const vector<int>& others = occurrences[negateLiteral(lit)];
+        if ((int)others.size() > options.maxOccurrences) return false;
+        newStamp();
+        for (int l : clauses[id]) mark[l] = stamp;
+        for (int other : others) {
+            bool tautology = false;
+            for (int l : clauses[other]) {
+                if (l != negateLiteral(lit) && mark[negateLiteral(l)] == stamp) {
+                    tautology = true;
+                    break;
+                }
+            }
+            stats.steps += clauses[other].size();
+            if (!tautology) return false;
+        }
+        return true;
+    }
+
+    /** \brief Removes blocked clauses. */
+    bool eliminateBlocked() {
+        bool changed = false;
+        for (int id = 0; id < (int)clauses.size() && !outOfBudget(); ++id) {
+            if (removed[id]) continue;
+            for (int lit : clauses[id]) {
+                if (frozen[literalVar(lit)] || !isBlocked(id, lit)) continue;
+                removeClause(id, lit);
+                stats.blockedClauses++;
+                changed = true;
+                break;
+            }
+        }
+        return changed;
+    }
+
+    /**
+     * \brief Runs the preprocessing rounds.
+     * \return false if the formula was found unsatisfiable.
+     */
+    bool run() {
+        start = chrono::steady_clock::now();
+        for (int round = 0; round < options.maxRounds && !unsat && !outOfBudget(); ++round) {
+            drainQueues();
+            bool changed = false;
+            if (options.variableElimination && !unsat) changed |= eliminateVariables();
+            if (options.blockedClauses && !unsat) changed |= eliminateBlocked();
+            drainQueues();
+            if (!changed) break;
+        }
+        stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return !unsat;
+    }
+
+    /**
+     * \brief Returns the simplified formula: the fixed units and the remaining clauses, over the
+     * original variables and names.
+     * \param original Supplies the names.
+     */
+    ClauseDB result(const ClauseDB& original) {
+        ClauseDB out;
+        out.numVars = numVars;
+        out.names = original.names;
+        if (unsat) {
+            out.clauses.push_back({});
+            return out;
+        }
+        vector<char> occurs(numVars, 0);
+        for (int v = 0; v < numVars; ++v) {
+            int lit = makeLiteral(v, false);
+            if (value[lit] != 0) out.clauses.push_back({value[lit] == 1 ? lit : negateLiteral(lit)});
+        }
+        for (size_t id = 0; id < clauses.size(); ++id) {
+            if (removed[id]) continue;
+            out.clauses.push_back(clauses[id]);
+            for (int lit : clauses[id]) occurs[literalVar(lit)] = 1;
+        }
+        stats.remainingClauses = out.clauses.size();
+        stats.remainingVars = count(occurs.begin(), occurs.end(), 1);
+        return out;
+    }
+
+    /**
+     * \brief Turns a model of the simplified formula into a model of the original one.
+     * \param model Model indexed by variable; values of eliminated variables are overwritten.
+     */
+    void extendModel(vector<char>& model) const {
+        model.resize(numVars, 0);
+        for (int v = 0; v < numVars; ++v) {
+            int lit = makeLiteral(v, false);
+            if (value[lit] != 0) model[v] = (value[lit] == 1);
+        }
+        for (size_t i = eliminationStack.size(); i-- > 0;) {
+            const auto& [witness, clause] = eliminationStack[i];
+            bool satisfied = false;
+            for (int lit : clause) {
+                if (model[literalVar(lit)] != (char)literalIsNegated(lit)) {
+                    satisfied = true;
+                    break;
+                }
+            }
+            if (!satisfied) model[literalVar(witness)] = !literalIsNegated(witness);
+        }
+    }
+};
+
+/**
+ * \brief Prints the counters of a preprocessing run.
+ * \param stats The counters.
+ */
+void printPreprocessStats(const PreprocessStats& stats) {
+    cout << "Variables: " << stats.originalVars << " -> " << stats.remainingVars << " occurring ("
+         << stats.eliminatedVars << " eliminated, " << stats.units << " fixed)" << endl;
+    cout << "Clauses: " << stats.originalClauses << " -> " << stats.remainingClauses << " ("
+         << stats.resolvents << " resolvents added, " << stats.blockedClauses << " blocked, "
+         << stats.subsumedClauses << " subsumed, " << stats.strengthenedClauses << " strengthened)" << endl;
+    cout << "Steps: " << stats.steps << (stats.budgetExhausted ? " (budget exhausted)" : "")
+         << ", time: " << stats.ms << " ms" << endl;
+}
+
+/* ---------------- END Preprocessing ---------------- */
+
+/* ---------------- EQUIVALENT LITERAL SUBSTITUTION ---------------- */
+
+/**
+ * \struct EquivalenceStats
+ * \brief What \ref EquivalenceReducer::apply removed.
+ */
+struct EquivalenceStats {
+    size_t originalVars = 0, originalClauses = 0;   /**< Size of the input (variables that occur). */
+    size_t remainingVars = 0, remainingClauses = 0; /**< Size of the output (variables that occur). */
+    size_t substitutedVars = 0;                     /**< Variables replaced by a representative. */
+    size_t components = 0;                          /**< Non-trivial SCCs found (in total). */
+    double ms = 0;                                  /**< Time of the SCC runs and the substitution. */
+};
+
+/**
+ * \struct EquivalenceReducer
+ * \brief Finds equivalent literals in the binary implication graph and substitutes them.
+ *
+ * Every binary clause (a + b) gives the implications ~a -> b and ~b -> a. Literals in one strongly
+ * connected component are equivalent; each component is replaced by its literal with the lowest
+ * variable, which makes the choice consistent between a component and its complement. A literal
+ * and its negation in one component mean the formula is UNSAT.
+ *
+ * Components are found with an iterative Tarjan. Merged literals hand their edges to their
+ * representative, so the graph shrinks as components are found. New binary clauses can be added
+ * later: every new component contains a new edge, so \ref run only starts Tarjan from the
+ * sources of edges added since the previous run.
+ */
+struct EquivalenceReducer {
+    int numVars = 0;                  /**< Number of variables. */
+    bool unsat = false;               /**< A literal is equivalent to its negation. */
+    vector<int> representative;       /**< Parent of each literal (itself for representatives). */
+    vector<vector<int>> implications; /**< Outgoing implications of each representative literal. */
+    vector<int> pendingRoots;         /**< Sources of edges added since the last run. */
+    EquivalenceStats stats;           /**< Counters. */
+
+    /**
+     * \brief Creates a reducer with the binary clauses of a clause database.
+     * \param db The formula.
+     */
+    explicit EquivalenceReducer(const ClauseDB& db) : numVars(db.numVars) {
+        representative.resize(2 * (size_t)numVars);
+        iota(representative.begin(), representative.end(), 0);
+        implications.resize(2 * (size_t)numVars);
+        for (const auto& clause : db.clauses) {
+            if (clause.size() == 2) addBinary(clause[0], clause[1]);
+        }
+    }
+
+    /** \brief Representative of \p lit (with path halving). */
+    int find(int lit) {
+        while (representative[lit] != lit) {
+            representative[lit] = representative[representative[lit]];
+            lit = representative[lit];
+        }
+        return lit;
+    }
+
+    /** \brief Adds the binary clause (a + b). */
+    void addBinary(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == negateLiteral(b)) return; // tautology
+        implications[negateLiteral(a)].push_back(b);
+        if (a != b) implications[negateLiteral(b)].push_back(a);
+        pendingRoots.push_back(negateLiteral(a));
+        pendingRoots.push_back(negateLiteral(b));
+    }
+
+    /** \brief Links representative \p from (and its complement) below \p to, moving its edges. */
+    void link(int from, int to) {
+        for (int sign = 0; sign < 2; ++sign) {
+            int a = sign ? negateLiteral(from) : from;
+            int b = sign ? negateLiteral(to) : to;
+            representative[a] = b;
+            implications[b].insert(implications[b].end(), implications[a].begin(), implications[a].end());
+            vector<int>().swap(implications[a]);
+        }
+        stats.substitutedVars++;
+    }
+
+    /**
+     * \brief Finds the components reachable from the pending roots and merges them.
+     *
+     * Components are collected first and merged after the traversal, so edge lists never change
+     * under the DFS.
+     * \return false if the formula is UNSAT.
+     */
+    bool run() {
+        auto start = chrono::steady_clock::now();
+        const int UNVISITED = -1;
+        vector<int> index(2 * (size_t)numVars, UNVISITED), low(2 * (size_t)numVars, 0);
+        vector<char> onStack(2 * (size_t)numVars, 0);
+        vector<int> sccStack;
+        vector<vector<int>> components;
+        vector<pair<int, size_t>> frames; // (literal, next edge)
+        int counter = 0;
+
+        for (int root : pendingRoots) {
+            root = find(root);
+            if (index[root] != UNVISITED) continue;
+            frames.push_back({root, 0});
+            index[root] = low[root] = counter++;
+            sccStack.push_back(root);
+            onStack[root] = 1;
+            while (!frames.empty()) {
+                int node = frames.back().first;
+                size_t& next = frames.back().second;
+                if (next < implications[node].size()) {
+                    int target = find(implications[node][next++]);
+                    if (index[target] == UNVISITED) {
+                        index[target] = low[target] = counter++;
+                        sccStack.push_back(target);
+                        onStack[target] = 1;
+                        frames.push_back({target, 0});
+                    } else if (onStack[target]) {
+                        low[node] = min(low[node], index[target]);
+                    }
+                    continue;
+                }
+                frames.pop_back();
+                if (!frames.empty()) low[frames.back().first] = min(low[frames.back().first], low[node]);
+                if (low[node] != index[node]) continue;
+
+                vector<int> component;
+                int member;
+                do {
+                    member = sccStack.back();
+                    sccStack.pop_back();
+                    onStack[member] = 0;
+                    component.push_back(member);
+                } while (member != node);
+                if (component.size() > 1) components.push_back(std::move(component));
+            }
+        }
+        pendingRoots.clear();
+
+        for (const auto& component : components) {
+            int target = find(component[0]);
+            for (int lit : component) {
+                if (literalVar(find(lit)) < literalVar(target)) target = find(lit);
+            }
+            bool merged = false;
+            for (int lit : component) {
+                int rep = find(lit);
+                if (rep == negateLiteral(target)) unsat = true;
+                if (rep == target || unsat) continue;
+                link(rep, target);
+                merged = true;
+            }
+            if (unsat) break;
+            stats.components += merged; // a component and its complement count once
+        }
+        stats.ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return !unsat;
+    }
+
+    /**
+     * \brief Substitutes representatives into a clause database.
+     *
+     * Literals are replaced by their representatives, duplicates removed and tautologies dropped
+     * (the binary clauses inside a component become tautologies this way).
+     * \param db The formula.
+     * \return The reduced formula over the same variables and names (a single empty clause if UNSAT).
+     */
+    ClauseDB apply(const ClauseDB& db) {
+        auto start = chrono::steady_clock::now();
+        ClauseDB out;
+        out.numVars = db.numVars;
+        out.names = db.names;
+        vector<char> before(numVars, 0), after(numVars, 0);
+        stats.originalClauses = db.clauses.size();
+        if (unsat) {
+            out.clauses.push_back({});
+        } else {
+            vector<int> clause;
+            for (const auto& original : db.clauses) {
+                clause.clear();
+                for (int lit : original) {
+                    before[literalVar(lit)] = 1;
+                    clause.push_back(find(lit));
+                }
+                size_t removedLiterals = 0;
+                if (normalizeClause(clause, removedLiterals)) continue; // tautology
+                for (int lit : clause) after[literalVar(lit)] = 1;
+                out.clauses.push_back(clause);
+            }
+            // Clauses that became equal (e.g. both copies of a binary clause) appear once
+            sort(out.clauses.begin(), out.clauses.end());
+            out.clauses.erase(unique(out.clauses.begin(), out.clauses.end()), out.clauses.end());
+        }
+        stats.originalVars = count(before.begin(), before.end(), 1);
+        stats.remainingVars = count(after.begin(), after.end(), 1);
+        stats.remainingClauses = out.clauses.size();
+        stats.ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return out;
+    }
+
+    /**
+     * \brief Gives every substituted variable the value of its representative.
+     * \param model Model of the reduced formula, indexed by variable.
+     */
+    void extendModel(vector<char>& model) {
+        model.resize(numVars, 0);
+        for (int v = 0; v < numVars; ++v) {
+            int rep = find(makeLiteral(v, false));
+            if (literalVar(rep) != v) model[v] = (model[literalVar(rep)] != (char)literalIsNegated(rep));
+        }
+    }
+};
+
+/* ---------------- END Equivalent Literal Substitution ---------------- */
+
+/* ---------------- SPECIAL-CASE SOLVERS (2-SAT / HORN-SAT) ---------------- */
+
+/**
+ * \brief Syntactic class of a clause database, in the order the dispatcher tries them.
+ */
+enum class FormulaClass { TRIVIAL, TWO_CNF, HORN, DUAL_HORN, GENERAL };
+
+/**
+ * \brief Returns a printable name of a formula class.
+ * \param cls The class.
+ * \return Its name.
+ */
+string formulaClassName(FormulaClass cls) {
+    switch (cls) {
+    case FormulaClass::TRIVIAL: return "trivial (empty formula or empty clause)";
+    case FormulaClass::TWO_CNF: return "2-CNF";
+    case FormulaClass::HORN: return "Horn";
+    case FormulaClass::DUAL_HORN: return "dual Horn";
+    default: return "general";
+    }
+}
+
+/**
+ * \struct FormulaProfile
+ * \brief Clause shape counts of a database and the class they imply.
+ */
+struct FormulaProfile {
+    FormulaClass cls = FormulaClass::GENERAL; /**< The most specific class that applies. */
+    size_t units = 0, binaries = 0, longer = 0; /**< Clauses by length. */
+    size_t emptyClauses = 0;                  /**< Clauses without literals. */
+    size_t hornClauses = 0;                   /**< Clauses with at most one positive literal. */
+    size_t dualHornClauses = 0;               /**< Clauses with at most one negative literal. */
+    size_t maxLength = 0;                     /**< Longest clause. */
+    double ms = 0;                            /**< Time of the classification. */
+};
+
+/**
+ * \brief Classifies a clause database in one pass over its literals.
+ * \param db The formula.
+ * \return The profile; 2-CNF wins over Horn when both apply.
+ */
+FormulaProfile classifyClauseDB(const ClauseDB& db) {
+    auto start = chrono::steady_clock::now();
+    FormulaProfile profile;
+    for (const auto& clause : db.clauses) {
+        size_t positive = 0;
+        for (int lit : clause) positive += !literalIsNegated(lit);
+        size_t negative = clause.size() - positive;
+        profile.maxLength = max(profile.maxLength, clause.size());
+        if (clause.empty()) profile.emptyClauses++;
+        else if (clause.size() == 1) profile.units++;
+        else if (clause.size() == 2) profile.binaries++;
+        else profile.longer++;
+        profile.hornClauses += (positive <= 1);
+        profile.dualHornClauses += (negative <= 1);
+    }
+    size_t total = db.clauses.size();
+    if (total == 0 || profile.emptyClauses > 0) profile.cls = FormulaClass::TRIVIAL;
+    else if (profile.longer == 0) profile.cls = FormulaClass::TWO_CNF;
+    else if (profile.hornClauses == total) profile.cls = FormulaClass::HORN;
+    else if (profile.dualHornClauses == total) profile.cls = FormulaClass::DUAL_HORN;
+    profile.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return profile;
+}
+
+/**
+ * \brief Solves a 2-CNF formula in linear time.
+ *
+ * Each clause (a + b) gives the implications ~a -> b and ~b -> a (a unit (a) gives ~a -> a), stored
+ * in compressed rows. An iterative Tarjan numbers the strongly connected components in reverse
+ * topological order; the formula is UNSAT iff some x and ~x share a component, and otherwise
+ * setting x true iff comp(x) < comp(~x) is a model.
+ * \param db The formula; every clause must have one or two literals.
+ * \param model Receives the model on SAT.
+ * \return SAT or UNSAT.
+ */
+SolveResult solveTwoSat(const ClauseDB& db, vector<char>& model) {
+    const size_t numLits = 2 * (size_t)db.numVars;
+    vector<int> rowStart(numLits + 1, 0), edges;
+    auto forEachEdge = [&](auto&& emit) {
+        for (const auto& clause : db.clauses) {
+            int a = clause[0], b = clause.size() == 2 ? clause[1] : clause[0];
+            emit(negateLiteral(a), b);
+            if (a != b) emit(negateLiteral(b), a);
+        }
+    };
+    forEachEdge([&](int from, int) { rowStart[from + 1]++; });
+    for (size_t i = 0; i < numLits; ++i) rowStart[i + 1] += rowStart[i];
+    edges.resize(rowStart[numLits]);
+    vector<int> fill(rowStart.begin(), rowStart.end() - 1);
+    forEachEdge([&](int from, int to) { edges[fill[from]++] = to; });
+
+    const int UNVISITED = -1;
+    vector<int> index(numLits, UNVISITED), low(numLits, 0), component(numLits, UNVISITED);
+    vector<int> sccStack, frames, nextEdge(numLits, 0);
+    int counter = 0, components = 0;
+    for (int root = 0; root < (int)numLits; ++root) {
+        if (index[root] != UNVISITED) continue;
+        index[root] = low[root] = counter++;
+        nextEdge[root] = rowStart[root];
+        sccStack.push_back(root);
+        frames.push_back(root);
+        while (!frames.empty()) {
+            int node = frames.back();
+            if (nextEdge[node] < rowStart[node + 1]) {
+                int target = edges[nextEdge[node]++];
+                if (index[target] == UNVISITED) {
+                    index[target] = low[target] = counter++;
+                    nextEdge[target] = rowStart[target];
+                    sccStack.push_back(target);
+                    frames.push_back(target);
+                } else if (component[target] == UNVISITED) {
+                    low[node] = min(low[node], index[target]); // still on the stack
+                }
+                continue;
+            }
+            frames.pop_back();
+            if (!frames.empty()) low[frames.back()] = min(low[frames.back()], low[node]);
+            if (low[node] != index[node]) continue;
+            int member;
+            do {
+                member = sccStack.back();
+                sccStack.pop_back();
+                component[member] = components;
+            } while (member != node);
+            components++;
+        }
+    }
+
+    model.assign(db.numVars, 0);
+    for (int v = 0; v < db.numVars; ++v) {
+        int pos = component[makeLiteral(v, false)], neg = component[makeLiteral(v, true)];
+        if (pos == neg) return SolveResult::UNSAT;
+        model[v] = (pos < neg);
+    }
+    return SolveResult::SAT;
+}
+
+/**
+ * \brief Solves a Horn formula in linear time (Dowling-Gallier).
+ *
+ * All variables start false. Each clause counts its negative literals whose variable is still
+ * false; a clause whose count reaches zero forces its positive literal, and if it has none the
+ * formula is UNSAT. Every variable is set at most once and every occurrence is visited at most
+ * once, and the result is the minimal model.
+ * \param db The formula; every clause must have at most one positive literal.
+ * \param model Receives the model on SAT.
+ * \param flip Solve the formula with every literal negated (used for dual-Horn formulas); the
+ *        model is flipped back.
+ * \return SAT or UNSAT.
+ */
+SolveResult solveHornSat(const ClauseDB& db, vector<char>& model, bool flip = false) {
+    const size_t numClauses = db.clauses.size();
+    vector<int> pending(numClauses, 0), head(numClauses, -1);
+    vector<int> rowStart(db.numVars + 1, 0), occurrences;
+    for (size_t c = 0; c < numClauses; ++c) {
+        for (int lit : db.clauses[c]) {
+            if (flip) lit = negateLiteral(lit);
+            if (literalIsNegated(lit)) {
+                pending[c]++;
+                rowStart[literalVar(lit) + 1]++;
+            } else {
+                head[c] = literalVar(lit);
+            }
+        }
+    }
+    for (int v = 0; v < db.numVars; ++v) rowStart[v + 1] += rowStart[v];
+    occurrences.resize(rowStart[db.numVars]);
+    vector<int> fill(rowStart.begin(), rowStart.end() - 1);
+    for (size_t c = 0; c < numClauses; ++c) {
+        for (int lit : db.clauses[c]) {
+            if (flip) lit = negateLiteral(lit);
+            if (literalIsNegated(lit)) occurrences[fill[literalVar(lit)]++] = (int)c;
+        }
+    }
+
+    model.assign(db.numVars, 0);
+    vector<int> queue;
+    auto fire = [&](size_t c) {
+        if (head[c] < 0) return false;
+        if (!model[head[c]]) {
+            model[head[c]] = 1;
+            queue.push_back(head[c]);
+        }
+        return true;
+    };
+    for (size_t c = 0; c < numClauses; ++c) {
+        if (pending[c] == 0 && !fire(c)) return SolveResult::UNSAT;
+    }
+    for (size_t i = 0; i < queue.size(); ++i) {
+        int v = queue[i];
+        for (int k = rowStart[v]; k < rowStart[v + 1]; ++k) {
+            int c = occurrences[k];
+            if (--pending[c] == 0 && !fire(c)) return SolveResult::UNSAT;
+        }
+    }
+    if (flip) {
+        for (auto& value : model) value = !value;
+    }
+    return SolveResult::SAT;
+}
+
+/**
+ * \struct DispatchResult
+ * \brief Outcome of \ref solveWithDispatch.
+ */
+struct DispatchResult {
+    FormulaProfile profile;                   /**< Classification of the input. */
+    string path;                              /**< Solver that answered. */
+    SolveResult result = SolveResult::UNKNOWN; /**< The answer. */
+    vector<char> model;                       /**< Model on SAT, indexed by variable. */
+    double ms = 0;                            /**< Solve time (without classification). */
+};
+
+/**
+ * \brief Classifies a formula and solves it with the cheapest applicable solver.
+ *
+ * 2-CNF goes to \ref solveTwoSat, Horn and dual-Horn formulas to \ref solveHornSat, and everything
+ * else to the CDCL solver.
+ * \param db The formula.
+ * \return The classification, the chosen path, the answer and timings.
+ */
+DispatchResult solveWithDispatch(const ClauseDB& db) {
+    DispatchResult out;
+    out.profile = classifyClauseDB(db);
+    auto start = chrono::steady_clock::now();
+    switch (out.profile.cls) {
+    case FormulaClass::TRIVIAL:
+        out.path = "none";
+        out.result = out.profile.emptyClauses ? SolveResult::UNSAT : SolveResult::SAT;
+        if (out.result == SolveResult::SAT) out.model.assign(db.numVars, 0);
+        break;
+    case FormulaClass::TWO_CNF:
+        out.path = "2-SAT (implication graph SCCs)";
+        out.result = solveTwoSat(db, out.model);
+        break;
+    case FormulaClass::HORN:
+    case FormulaClass::DUAL_HORN:
+        out.path = "Horn-SAT (counter-based unit propagation)";
+        out.result = solveHornSat(db, out.model, out.profile.cls == FormulaClass::DUAL_HORN);
+        break;
+    default: {
+        out.path = "CDCL";
+        CDCLSolver solver(db, SolverOptions());
+        out.result = solver.solve();
+        if (out.result == SolveResult::SAT) out.model = solver.model;
+        break;
+    }
+    }
+    if (out.result != SolveResult::SAT) out.model.clear();
+    out.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+/**
+ * \brief Prints the clause shape counts and the class of a formula.
+ * \param profile The classification.
+ */
+void printFormulaProfile(const FormulaProfile& profile) {
+    cout << "Formula class: " << formulaClassName(profile.cls) << " (units: " << profile.units
+         << ", binary: " << profile.binaries << ", longer: " << profile.longer
+         << ", Horn: " << profile.hornClauses << ", dual Horn: " << profile.dualHornClauses
+         << ", classified in " << profile.ms << " ms)" << endl;
+}
+
+/* ---------------- END Special-Case Solvers ---------------- */
+
+/* ---------------- MODEL COUNTING (#SAT) ---------------- */
+
+/**
+ * \struct BigNat
+ * \brief An arbitrary-precision natural number (base 2^32 limbs, least significant first).
+ */
+struct BigNat {
+    vector<uint32_t> limbs; /**< Limbs without leading zeros; empty for zero. */
+
+    /** \brief Creates the number \p value. */
+    BigNat(uint64_t value = 0) {
+        while (value) {
+            limbs.push_back((uint32_t)value);
+            value >>= 32;
+        }
+    }
+
+    /** \brief Returns true for zero. */
+    bool isZero() const { return limbs.empty(); }
+
+    /** \brief Adds \p other to this number. */
+    BigNat& operator+=(const BigNat& other) {
+        if (other.limbs.size() > limbs.size()) limbs.resize(other.limbs.size(), 0);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < limbs.size(); ++i) {
+            carry += (uint64_t)limbs[i] + (i < other.limbs.size() ? other.limbs[i] : 0);
+            limbs[i] = (uint32_t)carry;
+            carry >>= 32;
+            if (!carry && i >= other.limbs.size()) break;
+        }
+        if (carry) limbs.push_back((uint32_t)carry);
+        return *this;
+    }
+
+    /** \brief Returns the product of two numbers (schoolbook). */
+    friend BigNat operator*(const BigNat& a, const BigNat& b) {
+        BigNat out;
+        if (a.isZero() || b.isZero()) return out;
+        out.limbs.assign(a.limbs.size() + b.limbs.size(), 0);
+        for (size_t i = 0; i < a.limbs.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.limbs.size(); ++j) {
+                carry += (uint64_t)a.limbs[i] * b.limbs[j] + out.limbs[i + j];
+                out.limbs[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            out.limbs[i + b.limbs.size()] = (uint32_t)carry;
+        }
+        while (!out.limbs.empty() && out.limbs.back() == 0) out.limbs.pop_back();
+        return out;
+    }
+
+    /** \brief Multiplies this number by 2^\p bits. */
+    BigNat& shiftLeft(size_t bits) {
+        if (isZero() || bits == 0) return *this;
+        limbs.insert(limbs.begin(), bits / 32, 0);
+        if (bits % 32) {
+            uint32_t carry = 0;
+            for (auto& limb : limbs) {
+                uint32_t next = limb >> (32 - bits % 32);
+                limb = (limb << (bits % 32)) | carry;
+                carry = next;
+            }
+            if (carry) limbs.push_back(carry);
+        }
+        return *this;
+    }
+
+    /** \brief Returns the decimal representation. */
+    string toString() const {
+        if (isZero()) return "0";
+        vector<uint32_t> rest = limbs;
+        vector<uint32_t> chunks; // base 10^9, least significant first
+        while (!rest.empty()) {
+            uint64_t remainder = 0;
+            for (size_t i = rest.size(); i-- > 0;) {
+                uint64_t cur = (remainder << 32) | rest[i];
+                rest[i] = (uint32_t)(cur / 1000000000u);
+                remainder = cur % 1000000000u;
+            }
+            chunks.push_back((uint32_t)remainder);
+            while (!rest.empty() && rest.back() == 0) rest.pop_back();
+        }
+        string out = to_string(chunks.back());
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            string part = to_string(chunks[i]);
+            out += string(9 - part.size(), '0') + part;
+        }
+        return out;
+    }
+};
+
+/** \brief Approximate heap size of a count (for the cache budget). */
+inline size_t countBytes(const BigNat& value) { return sizeof(BigNat) + value.limbs.size() * sizeof(uint32_t); }
+/** \brief Approximate size of a weighted count (for the cache budget). */
+inline size_t countBytes(double) { return sizeof(double); }
+/** \brief Returns true if a count is zero. */
+inline bool countIsZero(const BigNat& value) { return value.isZero(); }
+/** \brief Returns true if a weighted count is zero. */
+inline bool countIsZero(double value) { return value == 0.0; }
+/** \brief Returns true if a count is one. */
+inline bool countIsOne(const BigNat& value) { return value.limbs.size() == 1 && value.limbs[0] == 1; }
+/** \brief Returns true if a weighted count is one. */
+inline bool countIsOne(double value) { return value == 1.0; }
+
+/**
+ * \struct CountOptions
+ * \brief Tuning of \ref ModelCounter.
+ */
+struct CountOptions {
+    size_t cacheBytes = 256u << 20; /**< Budget of the component cache; older entries are evicted beyond it. */
+    double orderWidthRatio = 0.125; /**< Branch along a min-degree elimination order if its width is at most this
+                                         fraction of the variables; otherwise by occurrences. */
+    double activityDecay = 0.5;     /**< Decay of the conflict activity added to the occurrence score. */
+    int probeMinVars = 40;          /**< Probe for failed literals in components with at least this many variables. */
+};
+
+/**
+ * \struct CountStats
+ * \brief Counters of a model counting run.
+ */
+struct CountStats {
+    uint64_t decisions = 0;     /**< Branches taken. */
+    uint64_t propagations = 0;  /**< Literals assigned by unit propagation. */
+    uint64_t conflicts = 0;     /**< Branches closed by a conflict. */
+    uint64_t failedLiterals = 0; /**< Literals whose probe failed, so their negation was implied. */
+    uint64_t components = 0;    /**< Components counted (including cache hits). */
+    uint64_t cacheHits = 0;     /**< Components answered by the cache. */
+    uint64_t cacheEvictions = 0; /**< Entries dropped to stay within the budget. */
+    size_t cacheEntries = 0, cacheBytes = 0; /**< Final cache size. */
+    int orderWidth = -1;        /**< Width of the elimination order used for branching (-1 if not used). */
+    double ms = 0;              /**< Counting time. */
+};
+
+/**
+ * \struct ModelCounter
+ * \brief Exact (weighted) model counter: DPLL with unit propagation, dynamic component
+ * decomposition and a component cache.
+ *
+ * After every decision and its propagation the unsatisfied clauses of the current component are
+ * split into variable-disjoint components, whose counts multiply. A component is identified by
+ * its unassigned variables and its unsatisfied clauses, which determine its residual clauses
+ * exactly, so the cache key is that pair of sorted id lists, stored as varint-encoded gaps (mostly
+ * one byte per id). The cache is bounded; when it
+ * outgrows \ref CountOptions::cacheBytes the least recently used half is dropped.
+ *
+ * Branching follows a min-degree elimination order of the primal graph, last-eliminated variable
+ * first, when that order has small width: such variables separate the formula, so components
+ * split early and recur often (banded and circuit-like formulas). On formulas without that
+ * structure (random ones), and in components no larger than the order's width, where it no longer
+ * separates anything, a dynamic VSADS score is used instead: occurrences in the component plus a
+ * decaying activity bumped by the variables of conflicting clauses.
+ *
+ * Components with at least \ref CountOptions::probeMinVars variables are first probed for failed
+ * literals (both values of each variable of a binary clause the last assignment created are
+ * propagated); an implied literal is assigned without branching, and a variable failing both ways
+ * closes the component. Components of at most \ref TABLE_VARS variables are neither searched nor
+ * cached: their clauses are evaluated as a truth table, 64 assignments per machine word, which is
+ * cheaper than a cache lookup.
+ *
+ * \tparam Count BigNat for exact counts or double for weighted counts.
+ */
+template <class Count>
+struct ModelCounter {
+    /** \brief A variable-disjoint part of the residual formula. */
+    struct Component {
+        vector<int> vars;    /**< Unassigned variables (sorted). */
+        vector<int> clauses; /**< Unsatisfied clause ids (sorted). */
+    };
+
+    /** \brief A cache entry. */
+    struct CacheEntry {
+        Count count;     /**< Count of the component. */
+        uint64_t stamp;  /**< Last use, for eviction. */
+    };
+
+    static constexpr int TABLE_VARS = 14; /**< Components up to this size are counted by \ref countByTable. */
+
+    const ClauseDB& db;                 /**< The formula. */
+    vector<Count> weights;              /**< weights[lit]; both 1 for plain counting. */
+    bool unitWeights = true;            /**< true if every weight is 1 (models are counted by popcount). */
+    CountOptions options;               /**< Tuning. */
+    CountStats stats;                   /**< Counters. */
+    vector<vector<int>> occurrences;    /**< Clause ids containing each literal. */
+    vector<signed char> value;          /**< -1 unassigned, else 0/1 per variable. */
+    vector<int> trail;                  /**< Assigned literals in order. */
+    unordered_map<string, CacheEntry> cache; /**< Component counts by packed key. */
+    size_t cacheBytes = 0;              /**< Estimated size of the cache. */
+    uint64_t clock = 0;                 /**< Use stamp source. */
+    vector<int> localIndex, parent, occurrenceCount; /**< Scratch arrays indexed by variable. */
+    vector<pair<int, int>> active;      /**< Scratch for \ref split: unsatisfied clauses and one unassigned variable of each. */
+    vector<int> slot, unassignedVars;   /**< Scratch for \ref split. */
+    vector<int> priority;               /**< Elimination position of each variable (empty if unused). */
+    vector<double> activity;            /**< Conflict activity of each variable (VSADS score). */
+    double activityIncrement = 1;       /**< Current bump; grows instead of decaying every activity. */
+    int conflictClause = -1;            /**< Clause falsified by the last failed propagation. */
+    size_t recentStart = 0, recentEnd = 0; /**< Trail range assigned just before the component being entered. */
+
+    /**
+     * \brief Prepares a counter.
+     * \param db The formula.
+     * \param weights weights[lit] for every literal (2 * numVars entries).
+     * \param options Tuning.
+     */
+    ModelCounter(const ClauseDB& db, vector<Count> weights, const CountOptions& options = CountOptions())
+        : db(db), weights(std::move(weights)), options(options) {
+        occurrences.resize(2 * (size_t)db.numVars);
+        for (size_t c = 0; c < db.clauses.size(); ++c) {
+            for (int lit : db.clauses[c]) {
+                if (occurrences[lit].empty() || occurrences[lit].back() != (int)c) occurrences[lit].push_back((int)c);
+            }
+        }
+        value.assign(db.numVars, -1);
+        localIndex.assign(db.numVars, -1);
+        parent.assign(db.numVars, 0);
+        occurrenceCount.assign(db.numVars, 0);
+        activity.assign(db.numVars, 0);
+        for (const Count& w : this->weights) unitWeights = unitWeights && countIsOne(w);
+        buildEliminationOrder();
+    }
+
+    /**
+     * \brief Computes a min-degree elimination order of the primal graph into \ref priority.
+     *
+     * Gives up (leaving \ref priority empty) as soon as a variable with more neighbours than
+     * \ref CountOptions::orderWidthRatio allows is eliminated.
+     */
+    void buildEliminationOrder() {
+        int n = db.numVars;
+        int maxWidth = (int)(options.orderWidthRatio * n);
+        vector<set<int>> adjacent(n);
+        for (const auto& clause : db.clauses) {
+            for (int a : clause) {
+                for (int b : clause) {
+                    if (literalVar(a) != literalVar(b)) adjacent[literalVar(a)].insert(literalVar(b));
+                }
+            }
+        }
+        priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> byDegree;
+        for (int v = 0; v < n; ++v) byDegree.push({(int)adjacent[v].size(), v});
+        vector<int> order(n, -1);
+        int position = 0, width = 0;
+        while (!byDegree.empty()) {
+            auto [degree, v] = byDegree.top();
+            byDegree.pop();
+            if (order[v] >= 0 || degree != (int)adjacent[v].size()) continue; // stale entry
+            if (degree > maxWidth) return;
+            width = max(width, degree);
+            order[v] = position++;
+            vector<int> neighbours(adjacent[v].begin(), adjacent[v].end());
+            for (int a : neighbours) adjacent[a].erase(v);
+            for (int a : neighbours) {
+                for (int b : neighbours) {
+                    if (a < b && adjacent[a].insert(b).second) adjacent[b].insert(a); // fill-in edge
+                }
+            }
+            for (int a : neighbours) byDegree.push({(int)adjacent[a].size(), a});
+            set<int>().swap(adjacent[v]);
+        }
+        priority = std::move(order);
+        stats.orderWidth = width;
+    }
+
+    /** \brief Value of a literal: 1 true, 0 false, -1 unassigned. */
+    int literalValue(int lit) const {
+        int v = value[literalVar(lit)];
+        return v < 0 ? -1 : (v ^ (int)literalIsNegated(lit));
+    }
+
+    /** \brief Makes \p lit true. */
+    void assign(int lit) {
+        value[literalVar(lit)] = !literalIsNegated(lit);
+        trail.push_back(lit);
+    }
+
+    /** \brief Undoes assignments down to trail size \p size. */
+    void undo(size_t size) {
+        while (trail.size() > size) {
+            value[literalVar(trail.back())] = -1;
+            trail.pop_back();
+        }
+    }
+
+    /**
+     * \brief Unit propagation of the trail from position \p head.
+     * \return false on a conflict.
+     */
+    bool propagate(size_t head) {
+        for (; head < trail.size(); ++head) {
+            for (int c : occurrences[negateLiteral(trail[head])]) {
+                int unassigned = 0, last = -1;
+                bool isSatisfied = false;
+                for (int lit : db.clauses[c]) {
+                    int val = literalValue(lit);
+                    if (val == 1) {
+                        isSatisfied = true;
+                        break;
+                    }
+                    if (val < 0 && lit != last) {
+                        unassigned++;
+                        last = lit;
+                    }
+                }
+                if (isSatisfied) continue;
+                if (unassigned == 0) {
+                    conflictClause = c;
+                    return false;
+                }
+                if (unassigned == 1) {
+                    assign(last);
+                    stats.propagations++;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** \brief Bumps the activity of the variables of the last conflicting clause. */
+    void bumpConflict() {
+        for (int lit : db.clauses[conflictClause]) activity[literalVar(lit)] += activityIncrement;
+        activityIncrement /= options.activityDecay;
+        if (activityIncrement > 1e100) {
+            for (double& a : activity) a *= 1e-100;
+            activityIncrement *= 1e-100;
+        }
+    }
+
+    /** \brief Weight of assigning variable \p v either way. */
+    Count freeWeight(int v) const {
+        Count w = weights[makeLiteral(v, false)];
+        w += weights[makeLiteral(v, true)];
+        return w;
+    }
+
+    /** \brief Union-find root over local variable indices. */
+    int root(int i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    }
+
+    /**
+     * \brief Splits the unsatisfied clauses of \p of into components.
+     * \param of The component the current assignment was made in.
+     * \param parts Receives the components with at least one clause.
+     * \param free Multiplied by the weights of variables left in no clause.
+     * \param freeVars If given, receives those variables.
+     */
+    void split(const Component& of, vector<Component>& parts, Count& free, vector<int>* freeVars = nullptr) {
+        int n = 0;
+        for (int v : of.vars) {
+            if (value[v] >= 0) continue;
+            localIndex[v] = n;
+            parent[n] = n;
+            occurrenceCount[v] = 0;
+            n++;
+        }
+        active.clear();
+        for (int c : of.clauses) {
+            size_t mark = unassignedVars.size();
+            bool isSatisfied = false;
+            for (int lit : db.clauses[c]) {
+                int val = literalValue(lit);
+                if (val == 1) {
+                    isSatisfied = true;
+                    break;
+                }
+                if (val < 0) unassignedVars.push_back(literalVar(lit));
+            }
+            if (isSatisfied) {
+                unassignedVars.resize(mark);
+                continue;
+            }
+            active.push_back({c, unassignedVars[mark]});
+            int first = root(localIndex[unassignedVars[mark]]);
+            for (size_t k = mark; k < unassignedVars.size(); ++k) {
+                int v = unassignedVars[k];
+                occurrenceCount[v]++;
+                parent[root(localIndex[v])] = first;
+            }
+            unassignedVars.resize(mark);
+        }
+        slot.assign(n, -1);
+        for (int v : of.vars) {
+            if (value[v] >= 0) continue;
+            if (occurrenceCount[v] == 0) {
+                free = free * freeWeight(v);
+                if (freeVars) freeVars->push_back(v);
+                continue;
+            }
+            int r = root(localIndex[v]);
+            if (slot[r] < 0) {
+                slot[r] = (int)parts.size();
+                parts.emplace_back();
+            }
+            parts[slot[r]].vars.push_back(v);
+        }
+        for (auto [c, v] : active) parts[slot[root(localIndex[v])]].clauses.push_back(c);
+    }
+
+    /** \brief Drops the least recently used half of the cache. */
+    void evict() {
+        vector<uint64_t> stamps;
+        stamps.reserve(cache.size());
+        for (const auto& entry : cache) stamps.push_back(entry.second.stamp);
+        nth_element(stamps.begin(), stamps.begin() + stamps.size() / 2, stamps.end());
+        uint64_t cutoff = stamps[stamps.size() / 2];
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (it->second.stamp < cutoff) {
+                cacheBytes -= it->first.size() + countBytes(it->second.count) + 64;
+                it = cache.erase(it);
+                stats.cacheEvictions++;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * \brief Cache key of a component: its sorted variable and clause ids as varint-encoded gaps.
+     * \param component The component.
+     * \return The packed key.
+     */
+    static string packKey(const Component& component) {
+        string key;
+        auto pack = [&key](const vector<int>& ids) {
+            uint32_t previous = 0;
+            for (int id : ids) {
+                uint32_t gap = (uint32_t)id + 1 - previous; // ids are sorted and distinct, so gap >= 1
+                previous = (uint32_t)id + 1;
+                for (; gap >= 0x80; gap >>= 7) key.push_back((char)(gap | 0x80));
+                key.push_back((char)gap);
+            }
+        };
+        pack(component.vars);
+        key.push_back(0); // a gap is never 0, so this separates the lists
+        pack(component.clauses);
+        return key;
+    }
+
+    /**
+     * \brief Picks the branching variable of a component: the latest-eliminated one while the
+     * component is larger than the order's width, otherwise the best VSADS score (occurrences in
+     * the component, counted by \ref split, plus activity relative to the current bump).
+     */
+    int pickBranch(const Component& component) const {
+        int branch = component.vars[0];
+        if (!priority.empty() && (int)component.vars.size() > stats.orderWidth) {
+            for (int v : component.vars) {
+                if (priority[v] > priority[branch]) branch = v;
+            }
+            return branch;
+        }
+        double best = -1;
+        for (int v : component.vars) {
+            double score = occurrenceCount[v] + activity[v] / activityIncrement;
+            if (score > best) {
+                best = score;
+                branch = v;
+            }
+        }
+        return branch;
+    }
+
+    /**
+     * \brief Failed-literal probing of a component. Both values of every variable of a binary
+     * residual clause shortened by the last assignment (trail[\ref recentStart, \ref recentEnd)) are
+     * propagated; when one conflicts, the other is assigned. Passes repeat until none finds a
+     * failed literal. The implied literals stay on the trail.
+     * \param component The component.
+     * \return false if both values of a variable fail, i.e. the component has no model.
+     */
+    bool probe(const Component& component) {
+        vector<int> candidates;
+        for (size_t t = recentStart; t < recentEnd; ++t) {
+            for (int c : occurrences[negateLiteral(trail[t])]) {
+                int unassigned = 0, first = -1;
+                bool isSatisfied = false;
+                for (int lit : db.clauses[c]) {
+                    int val = literalValue(lit);
+                    if (val == 1) {
+                        isSatisfied = true;
+                        break;
+                    }
+                    if (val < 0 && unassigned++ == 0) first = literalVar(lit);
+                }
+                if (isSatisfied || unassigned != 2 ||
+                    !binary_search(component.vars.begin(), component.vars.end(), first))
+                    continue; // not binary, or in a sibling component
+                for (int lit : db.clauses[c]) {
+                    if (literalValue(lit) < 0) candidates.push_back(literalVar(lit));
+                }
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+        for (bool found = true; found;) {
+            found = false;
+            for (int v : candidates) {
+                if (value[v] >= 0) continue;
+                for (int sign = 0; sign < 2; ++sign) {
+                    size_t mark = trail.size();
+                    assign(makeLiteral(v, sign));
+                    bool consistent = propagate(mark);
+                    undo(mark);
+                    if (consistent) continue;
+                    bumpConflict();
+                    stats.failedLiterals++;
+                    assign(makeLiteral(v, !sign));
+                    if (!propagate(mark)) {
+                        bumpConflict();
+                        return false;
+                    }
+                    found = true;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Counts a component of at most \ref TABLE_VARS variables without search.
+     *
+     * Local variable i is bit i of an assignment index; bits 0-5 select the bit within a word and
+     * the others the word. The table starts all true and is ANDed with every clause (its assigned
+     * literals are all false): a clause is true in a whole word when one of its other literals is
+     * true at that word index, and otherwise on the OR of the bit patterns of its low literals.
+     * \param component The component.
+     * \return Its (weighted) count.
+     */
+    Count countByTable(const Component& component) {
+        static const uint64_t PATTERN[6] = {0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+                                            0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+        int k = (int)component.vars.size();
+        for (int i = 0; i < k; ++i) localIndex[component.vars[i]] = i;
+        size_t words = k > 6 ? (size_t)1 << (k - 6) : 1;
+        uint64_t table[(size_t)1 << (TABLE_VARS - 6)];
+        fill(table, table + words, k >= 6 ? ~0ULL : (1ULL << (1 << k)) - 1);
+        for (int c : component.clauses) {
+            uint64_t lowTrue = 0;
+            size_t highPositive = 0, highNegative = 0; // word-index bits of the other literals
+            for (int lit : db.clauses[c]) {
+                int v = literalVar(lit);
+                if (value[v] >= 0) continue;
+                int i = localIndex[v];
+                if (i < 6) lowTrue |= literalIsNegated(lit) ? ~PATTERN[i] : PATTERN[i];
+                else if (literalIsNegated(lit)) highNegative |= (size_t)1 << (i - 6);
+                else highPositive |= (size_t)1 << (i - 6);
+            }
+            for (size_t j = 0; j < words; ++j) {
+                if (!((j & highPositive) | (~j & highNegative))) table[j] &= lowTrue;
+            }
+        }
+        if (unitWeights) {
+            uint64_t models = 0;
+            for (size_t j = 0; j < words; ++j) models += __builtin_popcountll(table[j]);
+            return Count(models);
+        }
+        // Weighted: sum the weights of the set bits of each word, times the weight of the word's high variables
+        int low = min(k, 6);
+        Count lowWeight[64];
+        for (int b = 0; b < (1 << low); ++b) {
+            lowWeight[b] = Count(1);
+            for (int i = 0; i < low; ++i) lowWeight[b] = lowWeight[b] * weights[makeLiteral(component.vars[i], !((b >> i) & 1))];
+        }
+        Count total(0);
+        for (size_t j = 0; j < words; ++j) {
+            if (!table[j]) continue;
+            Count sum(0);
+            for (uint64_t bits = table[j]; bits; bits &= bits - 1) sum += lowWeight[__builtin_ctzll(bits)];
+            for (int i = 6; i < k; ++i) sum = sum * weights[makeLiteral(component.vars[i], !((j >> (i - 6)) & 1))];
+            total += sum;
+        }
+        return total;
+    }
+
+    /**
+     * \brief Count of a component under the literals assigned since \p mark: their weights times
+     * the counts of the components they leave.
+     * \param component The component the literals were assigned in.
+     * \param mark Trail size before the assignment.
+     */
+    Count countAssigned(const Component& component, size_t mark) {
+        Count product(1);
+        for (size_t i = mark; i < trail.size(); ++i) product = product * weights[trail[i]];
+        vector<Component> parts;
+        split(component, parts, product);
+        size_t end = trail.size();
+        for (const auto& part : parts) {
+            if (countIsZero(product)) break;
+            recentStart = mark;
+            recentEnd = end;
+            product = product * countComponent(part);
+        }
+        return product;
+    }
+
+    /**
+     * \brief Counts the models of one component (the current assignment restricted to it).
+     * \param component Its variables and clauses; every clause has two or more unassigned literals.
+     * \return The (weighted) number of assignments to its variables that satisfy its clauses.
+     */
+    Count countComponent(const Component& component) {
+        stats.components++;
+        if ((int)component.vars.size() <= TABLE_VARS) return countByTable(component); // cheaper than a cache lookup
+        string key = packKey(component);
+        auto hit = cache.find(key);
+        if (hit != cache.end()) {
+            stats.cacheHits++;
+            hit->second.stamp = ++clock;
+            return hit->second.count;
+        }
+
+        Count total(0);
+        size_t mark = trail.size();
+        bool consistent = (int)component.vars.size() < options.probeMinVars || probe(component);
+        if (consistent && trail.size() > mark) {
+            total = countAssigned(component, mark);
+        } else if (consistent) {
+            int branch = pickBranch(component);
+            for (int sign = 0; sign < 2; ++sign) {
+                stats.decisions++;
+                assign(makeLiteral(branch, sign));
+                if (propagate(mark)) {
+                    total += countAssigned(component, mark);
+                } else {
+                    stats.conflicts++;
+                    bumpConflict();
+                }
+                undo(mark);
+            }
+        }
+        undo(mark);
+
+        size_t bytes = key.size() + countBytes(total) + 64;
+        cache.emplace(std::move(key), CacheEntry{total, ++clock});
+        cacheBytes += bytes;
+        if (cacheBytes > options.cacheBytes) evict();
+        return total;
+    }
+
+    /**
+     * \brief Counts the models of the whole formula.
+     * \return The (weighted) model count over all \c db.numVars variables.
+     */
+    Count count() {
+        auto start = chrono::steady_clock::now();
+        Count result(0);
+        bool conflict = false;
+        for (const auto& clause : db.clauses) {
+            if (clause.empty()) conflict = true;
+        }
+        // Top-level units
+        for (const auto& clause : db.clauses) {
+            if (conflict || clause.size() != 1) continue;
+            int val = literalValue(clause[0]);
+            if (val == 0) conflict = true;
+            else if (val < 0) assign(clause[0]);
+        }
+        if (!conflict && propagate(0)) {
+            Component all;
+            all.vars.resize(db.numVars);
+            iota(all.vars.begin(), all.vars.end(), 0);
+            all.clauses.resize(db.clauses.size());
+            iota(all.clauses.begin(), all.clauses.end(), 0);
+            result = countAssigned(all, 0);
+        }
+        undo(0);
+        stats.cacheEntries = cache.size();
+        stats.cacheBytes = cacheBytes;
+        stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+/**
+ * \brief Counts the models of a clause database exactly.
+ * \param db The formula.
+ * \param stats Receives the counters.
+ * \param options Tuning.
+ * \return The number of satisfying assignments of its \c numVars variables.
+ */
+BigNat countModels(const ClauseDB& db, CountStats& stats, const CountOptions& options = CountOptions()) {
+    ModelCounter<BigNat> counter(db, vector<BigNat>(2 * (size_t)db.numVars, BigNat(1)), options);
+    BigNat result = counter.count();
+    stats = counter.stats;
+    return result;
+}
+
+/**
+ * \brief Weighted model count: the sum over models of the product of their literal weights.
+ *
+ * With weights w(x) = p and w(~x) = 1 - p this is the probability that the formula holds when
+ * every atom is independently true with its probability p.
+ * \param db The formula.
+ * \param weights weights[lit] for every literal (2 * numVars entries).
+ * \param stats Receives the counters.
+ * \param options Tuning.
+ * \return The weighted count.
+ */
+double countModelsWeighted(const ClauseDB& db, const vector<double>& weights, CountStats& stats,
+                           const CountOptions& options = CountOptions()) {
+    ModelCounter<double> counter(db, weights, options);
+    double result = counter.count();
+    stats = counter.stats;
+    return result;
+}
+
+/**
+ * \brief Prints the counters of a model counting run.
+ * \param stats The counters.
+ */
+void printCountStats(const CountStats& stats) {
+    cout << "Decisions: " << stats.decisions << ", propagations: " << stats.propagations
+         << ", conflicts: " << stats.conflicts << ", failed literals: " << stats.failedLiterals << endl;
+    cout << "Components: " << stats.components << ", cache hits: " << stats.cacheHits
+         << ", cache entries: " << stats.cacheEntries << " (" << stats.cacheBytes / 1024 << " KB, "
+         << stats.cacheEvictions << " evicted)" << endl;
+    cout << "Branching: " << (stats.orderWidth >= 0 ? "elimination order (width " + to_string(stats.orderWidth) +
+                                                            "), then VSADS score"
+                                                      : string("VSADS score")) << endl;
+    cout << "Counting time: " << stats.ms << " ms" << endl;
+}
+
+/* ---------------- END Model Counting ---------------- */
+
+/* ---------------- BINARY DECISION DIAGRAMS ---------------- */
+
+/**
+ * \struct BddNode
+ * \brief An internal BDD node: if \c var then \c high else \c low.
+ */
+struct BddNode {
+    uint32_t var;  /**< Decision variable (UINT32_MAX for the terminal). */
+    uint32_t high; /**< Edge taken when var is true; never complemented. */
+    uint32_t low;  /**< Edge taken when var is false. */
+    uint32_t refs; /**< Parent nodes plus external references; 0 means dead. */
+    uint32_t next; /**< Next node in the same unique-table bucket (0 ends the chain). */
+};
+
+/**
+ * \struct BddStats
+ * \brief Size and cache counters of a \ref BddManager.
+ */
+struct BddStats {
+    size_t liveNodes = 0;         /**< Nodes in the unique tables (including dead ones not yet collected). */
+    size_t peakNodes = 0;         /**< Maximum of liveNodes. */
+    size_t memoryBytes = 0;       /**< Node array, unique tables and computed table. */
+    uint64_t cacheLookups = 0;    /**< Computed-table lookups. */
+    uint64_t cacheHits = 0;       /**< Computed-table hits. */
+    uint64_t collections = 0;     /**< Garbage collections. */
+    uint64_t reclaimed = 0;       /**< Nodes freed by garbage collection. */
+    double collectMs = 0;         /**< Time spent collecting. */
+    uint64_t reorderings = 0;     /**< Sifting runs. */
+    uint64_t swaps = 0;           /**< Adjacent level exchanges. */
+    double reorderMs = 0;         /**< Time spent sifting. */
+};
+
+/**
+ * \struct SiftOptions
+ * \brief Limits of one sifting run (\ref BddManager::sift).
+ */
+struct SiftOptions {
+    double maxGrowth = 1.2;     /**< Stop moving a variable once the BDD grows past this factor of the best size. */
+    int maxVars = 1000;         /**< Variables sifted per run (largest subtables first). */
+    double timeLimitMs = 10000; /**< Stop starting new variables after this long. */
+};
+
+/**
+ * \struct BddManager
+ * \brief A reduced ordered BDD package with complement edges.
+ *
+ * An edge is a 32-bit value: node index << 1 plus a complement bit. Node 0 is the terminal, so
+ * \ref ONE is edge 0 and \ref ZERO is edge 1, and negation is `edge ^ 1`. The high edge of a stored
+ * node is never complemented, which keeps the representation canonical.
+ *
+ * Every variable has its own unique subtable, and nodes refer to variables rather than levels, so
+ * two adjacent levels can be exchanged by touching only their subtables. The computed table is a
+ * lossy direct-mapped ITE cache.
+ *
+ * Reference counting: a node counts its parents and external references. Every edge returned by a
+ * public method carries one reference owned by the caller (release it with \ref deref). Garbage
+ * collection only runs at the start of public operations, when no unreferenced intermediate
+ * results exist; it frees dead nodes level by level from the top, so freeing a parent can
+ * cascade to its children in the same sweep, and then clears the computed table.
+ *
+ * Variable reordering (Rudell sifting) runs at the same points, either on request or when
+ * \ref autoReorder is set and the node count doubles. It is built on \ref swapLevels, which
+ * rewrites nodes in place, so every edge keeps denoting the same function.
+ */
+struct BddManager {
+    static const uint32_t ONE = 0;  /**< The constant true. */
+    static const uint32_t ZERO = 1; /**< The constant false. */
+    static const uint32_t TERMINAL = UINT32_MAX; /**< Variable of the terminal node. */
+
+    /** \brief A unique subtable: hash buckets chained through BddNode::next. */
+    struct Subtable {
+        vector<uint32_t> buckets; /**< First node of each chain (0 for empty). */
+        size_t count = 0;         /**< Nodes in the subtable. */
+    };
+
+    /** \brief A computed-table entry: ite(f, g, h) = result. */
+    struct CacheEntry {
+        uint32_t f = UINT32_MAX, g = 0, h = 0, result = 0;
+    };
+
+    vector<BddNode> nodes;          /**< Node storage; index 0 is the terminal. */
+    vector<uint32_t> freeList;      /**< Reusable node indices. */
+    vector<Subtable> subtables;     /**< One unique subtable per variable. */
+    vector<int> varToLevel;         /**< Position of each variable in the order. */
+    vector<int> levelToVar;         /**< Variable at each position. */
+    vector<string> names;           /**< Variable names. */
+    unordered_map<string, int> varIndex; /**< Variable number by name. */
+    vector<CacheEntry> cache;       /**< Computed table (size is a power of two). */
+    size_t collectThreshold = 1 << 16; /**< Live node count that triggers the next collection. */
+    bool autoReorder = false;       /**< Sift automatically when the node count passes \ref reorderThreshold. */
+    size_t reorderThreshold = 4096; /**< Live node count that triggers the next automatic sifting. */
+    SiftOptions siftOptions;        /**< Limits of automatic sifting. */
+    size_t nodeLimit = SIZE_MAX;    /**< Live nodes beyond which operations give up. */
+    bool overflowed = false;        /**< An operation hit \ref nodeLimit; later results are meaningless. */
+    BddStats stats;                 /**< Counters. */
+
+    /** \brief Creates an empty manager. */
+    BddManager() {
+        nodes.push_back(BddNode{TERMINAL, 0, 0, UINT32_MAX / 2, 0});
+        cache.resize(1 << 16);
+    }
+
+    /** \brief Node index of an edge. */
+    static uint32_t nodeOf(uint32_t e) { return e >> 1; }
+    /** \brief Returns true if the edge is complemented. */
+    static bool isComplemented(uint32_t e) { return e & 1; }
+    /** \brief Returns true for the constants. */
+    static bool isConstant(uint32_t e) { return nodeOf(e) == 0; }
+
+    /** \brief Level of the node an edge points to (the number of variables for the terminal). */
+    int level(uint32_t e) const {
+        uint32_t var = nodes[nodeOf(e)].var;
+        return var == TERMINAL ? (int)levelToVar.size() : varToLevel[var];
+    }
+
+    /** \brief Number of variables. */
+    int numVars() const { return (int)names.size(); }
+
+    /**
+     * \brief Returns the variable called \p name, appending it at the bottom of the order if new.
+     * \param name The atom name.
+     * \return Its variable number.
+     */
+    int variable(const string& name) {
+        auto it = varIndex.find(name);
+        if (it != varIndex.end()) return it->second;
+        int var = numVars();
+        varIndex.emplace(name, var);
+        names.push_back(name);
+        varToLevel.push_back(var);
+        levelToVar.push_back(var);
+        subtables.emplace_back();
+        subtables.back().buckets.assign(64, 0);
+        return var;
+    }
+
+    /** \brief Adds a reference to an edge and returns it. */
+    uint32_t ref(uint32_t e) {
+        if (!isConstant(e)) nodes[nodeOf(e)].refs++;
+        return e;
+    }
+
+    /** \brief Releases a reference obtained from a public method or \ref ref. */
+    void deref(uint32_t e) {
+        if (!isConstant(e)) nodes[nodeOf(e)].refs--;
+    }
+
+    /** \brief Bucket of (high, low) in a subtable. */
+    static size_t bucketOf(const Subtable& table, uint32_t high, uint32_t low) {
+        uint64_t h = ((uint64_t)high * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)low * 0xC2B2AE3D27D4EB4FULL);
+        return (size_t)(h >> 32) & (table.buckets.size() - 1);
+    }
+
+    /** \brief Doubles the buckets of a subtable. */
+    void growSubtable(Subtable& table) {
+        vector<uint32_t> old(table.buckets.size() * 2, 0);
+        old.swap(table.buckets);
+        for (uint32_t head : old) {
+            while (head) {
+                uint32_t next = nodes[head].next;
+                size_t b = bucketOf(table, nodes[head].high, nodes[head].low);
+                nodes[head].next = table.buckets[b];
+                table.buckets[b] = head;
+                head = next;
+            }
+        }
+    }
+
+    /**
+     * \brief Returns the edge for (var ? high : low), creating the node if needed.
+     *
+     * Applies both reduction rules and the complement-edge normal form. The result carries no
+     * reference.
+     */
+    uint32_t makeNode(uint32_t var, uint32_t high, uint32_t low) {
+        if (high == low) return high;
+        if (isComplemented(high)) return makeNode(var, high ^ 1, low ^ 1) ^ 1;
+        const Subtable& table = subtables[var];
+        for (uint32_t i = table.buckets[bucketOf(table, high, low)]; i; i = nodes[i].next) {
+            if (nodes[i].high == high && nodes[i].low == low) return i << 1;
+        }
+        uint32_t index;
+        if (!freeList.empty()) {
+            index = freeList.back();
+            freeList.pop_back();
+        } else {
+            index = (uint32_t)nodes.size();
+            nodes.emplace_back();
+        }
+        nodes[index] = BddNode{var, high, low, 0, 0};
+        insertNode(index);
+        ref(high);
+        ref(low);
+        stats.liveNodes++;
+        stats.peakNodes = max(stats.peakNodes, stats.liveNodes);
+        return index << 1;
+    }
+
+    /** \brief Links node \p index into the subtable of its variable. */
+    void insertNode(uint32_t index) {
+        Subtable& table = subtables[nodes[index].var];
+        size_t b = bucketOf(table, nodes[index].high, nodes[index].low);
+        nodes[index].next = table.buckets[b];
+        table.buckets[b] = index;
+        if (++table.count > table.buckets.size()) growSubtable(table);
+    }
+
+    /** \brief Returns a node to the free list, releasing its children. */
+    void freeNode(uint32_t index) {
+        deref(nodes[index].high);
+        deref(nodes[index].low);
+        freeList.push_back(index);
+        stats.liveNodes--;
+        stats.reclaimed++;
+    }
+
+    /**
+     * \brief Exchanges the variables at levels \p lvl and \p lvl + 1.
+     *
+     * With x above y, an x-node whose children do not test y just moves down a level. Any other
+     * x-node (x ? F1 : F0) is rewritten in place as (y ? (x ? F11 : F01) : (x ? F10 : F00)), so its
+     * index, and therefore every edge to it, keeps its meaning; F11 is regular, so the normal form
+     * holds. y-nodes that lose their last parent are freed at once, keeping the node count exact.
+     * Only the two subtables are touched. Dead nodes must have been collected beforehand.
+     * \param lvl The upper level.
+     */
+    void swapLevels(int lvl) {
+        uint32_t x = (uint32_t)levelToVar[lvl], y = (uint32_t)levelToVar[lvl + 1];
+        vector<uint32_t> moving, staying;
+        for (auto& head : subtables[x].buckets) {
+            for (uint32_t i = head; i; i = nodes[i].next) {
+                bool testsY = nodes[nodeOf(nodes[i].high)].var == y || nodes[nodeOf(nodes[i].low)].var == y;
+                (testsY ? moving : staying).push_back(i);
+            }
+            head = 0;
+        }
+        subtables[x].count = 0;
+        for (uint32_t i : staying) insertNode(i);
+
+        swap(levelToVar[lvl], levelToVar[lvl + 1]);
+        varToLevel[x] = lvl + 1;
+        varToLevel[y] = lvl;
+
+        auto cofactorY = [&](uint32_t e, uint32_t& high, uint32_t& low) {
+            if (nodes[nodeOf(e)].var != y) {
+                high = low = e;
+                return;
+            }
+            high = nodes[nodeOf(e)].high ^ (e & 1);
+            low = nodes[nodeOf(e)].low ^ (e & 1);
+        };
+        for (uint32_t i : moving) {
+            uint32_t f1 = nodes[i].high, f0 = nodes[i].low, f11, f10, f01, f00;
+            cofactorY(f1, f11, f10);
+            cofactorY(f0, f01, f00);
+            uint32_t high = ref(makeNode(x, f11, f01));
+            uint32_t low = ref(makeNode(x, f10, f00));
+            deref(f1);
+            deref(f0);
+            nodes[i].var = y;
+            nodes[i].high = high;
+            nodes[i].low = low;
+            insertNode(i);
+        }
+
+        Subtable& ys = subtables[y];
+        for (auto& head : ys.buckets) {
+            uint32_t* link = &head;
+            while (*link) {
+                uint32_t i = *link;
+                if (nodes[i].refs == 0) {
+                    *link = nodes[i].next;
+                    ys.count--;
+                    freeNode(i);
+                } else {
+                    link = &nodes[i].next;
+                }
+            }
+        }
+        stats.swaps++;
+    }
+
+    /**
+     * \brief Reorders the variables by Rudell sifting.
+     *
+     * Variables are taken largest subtable first. Each one is moved towards the nearer end of the
+     * order, then to the other end, and finally back to the level where the BDD was smallest;
+     * a direction is abandoned once the size exceeds \ref SiftOptions::maxGrowth times the best.
+     * Edges keep their functions; the computed table is cleared.
+     * \param options Limits of this run.
+     * \return The number of live nodes afterwards.
+     */
+    size_t sift(const SiftOptions& options = SiftOptions()) {
+        auto start = chrono::steady_clock::now();
+        collectGarbage();
+        int n = numVars();
+        vector<int> vars(n);
+        iota(vars.begin(), vars.end(), 0);
+        stable_sort(vars.begin(), vars.end(), [&](int a, int b) { return subtables[a].count > subtables[b].count; });
+        if ((int)vars.size() > options.maxVars) vars.resize(options.maxVars);
+
+        for (int var : vars) {
+            if (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() > options.timeLimitMs) break;
+            size_t best = stats.liveNodes;
+            int bestLevel = varToLevel[var];
+            auto moveTo = [&](int target, bool limited) {
+                while (varToLevel[var] != target) {
+                    int lvl = varToLevel[var];
+                    swapLevels(lvl < target ? lvl : lvl - 1);
+                    if (stats.liveNodes < best) {
+                        best = stats.liveNodes;
+                        bestLevel = varToLevel[var];
+                    }
+                    if (limited && stats.liveNodes > options.maxGrowth * best) break;
+                }
+            };
+            bool downFirst = varToLevel[var] >= n / 2;
+            moveTo(downFirst ? n - 1 : 0, true);
+            moveTo(downFirst ? 0 : n - 1, true);
+            moveTo(bestLevel, false);
+        }
+        fill(cache.begin(), cache.end(), CacheEntry());
+        stats.reorderings++;
+        stats.reorderMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return stats.liveNodes;
+    }
+
+    /** \brief Cofactors of \p e with respect to the variable at level \p lvl (e itself twice if it does not test it). */
+    void cofactors(uint32_t e, int lvl, uint32_t& high, uint32_t& low) const {
+        if (level(e) != lvl) {
+            high = low = e;
+            return;
+        }
+        const BddNode& n = nodes[nodeOf(e)];
+        high = n.high ^ (e & 1);
+        low = n.low ^ (e & 1);
+    }
+
+    /** \brief If-then-else without garbage collection or references (the recursive core). */
+    uint32_t iteRec(uint32_t f, uint32_t g, uint32_t h) {
+        if (overflowed || stats.liveNodes >= nodeLimit) {
+            overflowed = true;
+            return ZERO; // unwind quickly
+        }
+        if (f == ONE) return g;
+        if (f == ZERO) return h;
+        if (g == f) g = ONE;
+        else if (g == (f ^ 1)) g = ZERO;
+        if (h == f) h = ZERO;
+        else if (h == (f ^ 1)) h = ONE;
+        if (g == h) return g;
+        if (g == ONE && h == ZERO) return f;
+        if (g == ZERO && h == ONE) return f ^ 1;
+        // Normalize: f regular, g regular (complementing the result if needed)
+        if (isComplemented(f)) {
+            f ^= 1;
+            swap(g, h);
+        }
+        uint32_t complement = 0;
+        if (isComplemented(g)) {
+            g ^= 1;
+            h ^= 1;
+            complement = 1;
+        }
+
+        size_t slot = (((uint64_t)f * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)g * 0xC2B2AE3D27D4EB4FULL) ^
+                       ((uint64_t)h * 0x165667B19E3779F9ULL)) >> 20 & (cache.size() - 1);
+        stats.cacheLookups++;
+        CacheEntry& entry = cache[slot];
+        if (entry.f == f && entry.g == g && entry.h == h) {
+            stats.cacheHits++;
+            return entry.result ^ complement;
+        }
+
+        int top = min(level(f), min(level(g), level(h)));
+        uint32_t f1, f0, g1, g0, h1, h0;
+        cofactors(f, top, f1, f0);
+        cofactors(g, top, g1, g0);
+        cofactors(h, top, h1, h0);
+        uint32_t high = iteRec(f1, g1, h1);
+        uint32_t low = iteRec(f0, g0, h0);
+        uint32_t result = makeNode((uint32_t)levelToVar[top], high, low);
+        cache[slot] = CacheEntry{f, g, h, result}; // the recursion may have overwritten the slot
+        return result ^ complement;
+    }
+
+    /**
+     * \brief Collects garbage if the live node count passed the threshold, and sifts if automatic
+     * reordering is due. Called before and after every public operation, when all live edges
+     * are referenced.
+     */
+    void maybeCollect() {
+        if (stats.liveNodes >= collectThreshold) {
+            collectGarbage();
+            collectThreshold = max(collectThreshold, 2 * stats.liveNodes);
+            // Keep the computed table at roughly a quarter of the node count
+            size_t wanted = cache.size();
+            while (wanted < stats.liveNodes / 4 && wanted < ((size_t)1 << 24)) wanted *= 2;
+            if (wanted != cache.size()) cache.assign(wanted, CacheEntry());
+        }
+        if (autoReorder && !overflowed && stats.liveNodes >= reorderThreshold) {
+            sift(siftOptions);
+            reorderThreshold = max(reorderThreshold, 2 * stats.liveNodes);
+        }
+    }
+
+    /** \brief Frees every dead node (cascading from the top level down) and clears the computed table. */
+    void collectGarbage() {
+        auto start = chrono::steady_clock::now();
+        for (int lvl = 0; lvl < (int)levelToVar.size(); ++lvl) {
+            Subtable& table = subtables[levelToVar[lvl]];
+            for (auto& head : table.buckets) {
+                uint32_t* link = &head;
+                while (*link) {
+                    uint32_t i = *link;
+                    if (nodes[i].refs == 0) {
+                        *link = nodes[i].next;
+                        table.count--;
+                        freeNode(i);
+                    } else {
+                        link = &nodes[i].next;
+                    }
+                }
+            }
+        }
+        fill(cache.begin(), cache.end(), CacheEntry());
+        stats.collections++;
+        stats.collectMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    /** \brief if f then g else h (referenced). */
+    uint32_t ite(uint32_t f, uint32_t g, uint32_t h) {
+        maybeCollect();
+        uint32_t result = ref(iteRec(f, g, h));
+        maybeCollect(); // a single operation can be where the BDD blows up
+        return result;
+    }
+    /** \brief Conjunction (referenced). */
+    uint32_t bddAnd(uint32_t a, uint32_t b) { return ite(a, b, ZERO); }
+    /** \brief Disjunction (referenced). */
+    uint32_t bddOr(uint32_t a, uint32_t b) { return ite(a, ONE, b); }
+    /** \brief Exclusive or (referenced). */
+    uint32_t bddXor(uint32_t a, uint32_t b) { return ite(a, b ^ 1, b); }
+    /** \brief Implication a > b (referenced). */
+    uint32_t bddImplies(uint32_t a, uint32_t b) { return ite(a, b, ONE); }
+    /** \brief Negation (referenced). */
+    uint32_t bddNot(uint32_t a) { return ref(a ^ 1); }
+
+    /** \brief The BDD of a single variable (referenced). */
+    uint32_t varBdd(int var) {
+        maybeCollect();
+        return ref(makeNode((uint32_t)var, ONE, ZERO));
+    }
+
+    /**
+     * \brief Conjoins (or disjoins) a list of BDDs pairwise in a balanced tree.
+     *
+     * Folding left to right would combine an ever larger BDD with each new operand; pairing
+     * keeps the operands of similar size.
+     * \param parts Referenced operands; their references are consumed.
+     * \param isAnd Conjunction if true, disjunction otherwise.
+     * \return The result (referenced).
+     */
+    uint32_t combineBalanced(vector<uint32_t> parts, bool isAnd) {
+        if (parts.empty()) return isAnd ? ONE : ZERO;
+        while (parts.size() > 1) {
+            vector<uint32_t> next;
+            for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+                next.push_back(isAnd ? bddAnd(parts[i], parts[i + 1]) : bddOr(parts[i], parts[i + 1]));
+                deref(parts[i]);
+                deref(parts[i + 1]);
+            }
+            if (parts.size() % 2) next.push_back(parts.back());
+            parts.swap(next);
+        }
+        return parts[0];
+    }
+
+    /**
+     * \brief Builds the BDD of a parse tree.
+     *
+     * The tree is walked iteratively in post-order, so deep trees (long DIMACS conjunctions) do
+     * not exhaust the stack. Chains of the same AND/OR operator are flattened (as in
+     * \ref TseitinEncoder) and combined with \ref combineBalanced. Atoms become variables in order
+     * of first appearance.
+     * \param root The formula.
+     * \return Its BDD (referenced).
+     */
+    uint32_t fromTree(Node* root) {
+        vector<pair<Node*, bool>> stack{{root, false}};
+        unordered_map<Node*, uint32_t> edgeOf; // referenced results of finished subtrees
+        vector<Node*> children;
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            if (!node->left && !node->right) {
+                if (::isConstant(node->value)) edgeOf[node] = node->value == "1" ? uint32_t(ONE) : uint32_t(ZERO);
+                else edgeOf[node] = varBdd(variable(node->value));
+                continue;
+            }
+            TseitinEncoder::operands(node, children);
+            if (!expanded) {
+                stack.push_back({node, true});
+                for (auto it = children.rbegin(); it != children.rend(); ++it) stack.push_back({*it, false});
+                continue;
+            }
+            vector<uint32_t> inputs;
+            for (Node* child : children) {
+                inputs.push_back(edgeOf[child]);
+                edgeOf.erase(child);
+            }
+            uint32_t result;
+            if (node->value == "~") {
+                result = inputs[0] ^ 1; // the reference moves to the complement
+            } else if (node->value == ">") {
+                result = bddImplies(inputs[0], inputs[1]);
+                deref(inputs[0]);
+                deref(inputs[1]);
+            } else {
+                result = combineBalanced(inputs, node->value == "*");
+            }
+            edgeOf[node] = result;
+        }
+        return edgeOf[root];
+    }
+
+    /**
+     * \brief Builds the BDD of a clause database.
+     *
+     * Clauses are built bottom-up in the variable order and conjoined with \ref combineBalanced.
+     * \param db The formula.
+     * \return Its BDD (referenced).
+     */
+    uint32_t fromClauses(const ClauseDB& db) {
+        vector<int> vars(db.numVars);
+        for (int v = 0; v < db.numVars; ++v) vars[v] = variable(db.names[v]);
+        vector<uint32_t> parts;
+        for (const auto& clause : db.clauses) {
+            vector<int> lits;
+            for (int lit : clause) lits.push_back(makeLiteral(vars[literalVar(lit)], literalIsNegated(lit)));
+            sort(lits.begin(), lits.end(), [&](int a, int b) {
+                return varToLevel[literalVar(a)] > varToLevel[literalVar(b)];
+            });
+            maybeCollect();
+            uint32_t acc = ZERO;
+            for (int lit : lits) {
+                uint32_t x = makeNode((uint32_t)literalVar(lit), ONE, ZERO) ^ (uint32_t)literalIsNegated(lit);
+                acc = iteRec(x, ONE, acc); // no collection in this loop, so acc needs no reference
+            }
+            parts.push_back(ref(acc));
+        }
+        return combineBalanced(std::move(parts), true);
+    }
+
+    /** \brief Number of nodes reachable from an edge (including the terminal). */
+    size_t nodeCount(uint32_t e) const {
+        vector<uint32_t> stack{nodeOf(e)};
+        unordered_set<uint32_t> seen{nodeOf(e)};
+        while (!stack.empty()) {
+            uint32_t i = stack.back();
+            stack.pop_back();
+            if (i == 0) continue;
+            for (uint32_t child : {nodeOf(nodes[i].high), nodeOf(nodes[i].low)}) {
+                if (seen.insert(child).second) stack.push_back(child);
+            }
+        }
+        return seen.size();
+    }
+
+    /**
+     * \brief Counts the satisfying assignments of all \ref numVars variables.
+     *
+     * Each node keeps the counts of both of its polarities over the variables at and below its
+     * level, so complement edges need no subtraction.
+     * \param e The BDD.
+     * \return The number of models.
+     */
+    BigNat satCount(uint32_t e) {
+        unordered_map<uint32_t, pair<BigNat, BigNat>> memo; // node -> (true count, false count)
+        memo[0] = {BigNat(1), BigNat(0)};
+        // Count of edge x over the variables at levels >= from
+        auto countFrom = [&](uint32_t x, int from, bool positive) {
+            const auto& counts = memo[nodeOf(x)];
+            BigNat c = (positive != isComplemented(x)) ? counts.first : counts.second;
+            return c.shiftLeft((size_t)(level(x) - from));
+        };
+        vector<pair<uint32_t, bool>> stack{{nodeOf(e), false}};
+        while (!stack.empty()) {
+            auto [i, expanded] = stack.back();
+            stack.pop_back();
+            if (memo.count(i)) continue;
+            const BddNode node = nodes[i];
+            if (!expanded) {
+                stack.push_back({i, true});
+                stack.push_back({nodeOf(node.high), false});
+                stack.push_back({nodeOf(node.low), false});
+                continue;
+            }
+            int lvl = varToLevel[node.var];
+            BigNat t = countFrom(node.high, lvl + 1, true), f = countFrom(node.high, lvl + 1, false);
+            t += countFrom(node.low, lvl + 1, true);
+            f += countFrom(node.low, lvl + 1, false);
+            memo[i] = {t, f};
+        }
+        return countFrom(e, 0, true);
+    }
+
+    /**
+     * \brief Finds one satisfying assignment.
+     * \param e The BDD.
+     * \param assignment Receives (variable, value) pairs for the variables on one path to true;
+     *        other variables are don't-cares.
+     * \return false if \p e is unsatisfiable.
+     */
+    bool anySat(uint32_t e, vector<pair<int, bool>>& assignment) const {
+        assignment.clear();
+        if (e == ZERO) return false;
+        while (!isConstant(e)) {
+            const BddNode& node = nodes[nodeOf(e)];
+            uint32_t high = node.high ^ (e & 1), low = node.low ^ (e & 1);
+            bool takeHigh = (high != ZERO);
+            assignment.push_back({(int)node.var, takeHigh});
+            e = takeHigh ? high : low;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Restricts a BDD by fixing some variables (generalized cofactor by a cube).
+     * \param e The BDD.
+     * \param values (variable, value) pairs.
+     * \return The restricted BDD (referenced).
+     */
+    uint32_t restrictVars(uint32_t e, const vector<pair<int, bool>>& values) {
+        maybeCollect();
+        vector<signed char> fixed(numVars(), -1);
+        int deepest = -1;
+        for (auto [var, value] : values) {
+            fixed[var] = value;
+            deepest = max(deepest, varToLevel[var]);
+        }
+        unordered_map<uint32_t, uint32_t> memo; // regular edge -> result
+        function<uint32_t(uint32_t)> rec = [&](uint32_t x) -> uint32_t {
+            if (isConstant(x) || level(x) > deepest) return x;
+            uint32_t complement = x & 1, regular = x ^ complement;
+            auto it = memo.find(regular);
+            if (it != memo.end()) return it->second ^ complement;
+            const BddNode node = nodes[nodeOf(regular)];
+            uint32_t result;
+            if (fixed[node.var] >= 0) result = rec(fixed[node.var] ? node.high : node.low);
+            else result = makeNode(node.var, rec(node.high), rec(node.low));
+            memo[regular] = result;
+            return result ^ complement;
+        };
+        return ref(rec(e));
+    }
+
+    /** \brief Updates and returns the statistics. */
+    const BddStats& statistics() {
+        size_t buckets = 0;
+        for (const auto& table : subtables) buckets += table.buckets.size();
+        stats.memoryBytes = nodes.capacity() * sizeof(BddNode) + buckets * sizeof(uint32_t) +
+                            cache.size() * sizeof(CacheEntry) + freeList.capacity() * sizeof(uint32_t);
+        return stats;
+    }
+};
+
+/**
+ * \brief Prints the counters of a BDD manager.
+ * \param stats The counters (see \ref BddManager::statistics).
+ */
+void printBddStats(const BddStats& stats) {
+    cout << "Nodes: " << stats.liveNodes << " live, " << stats.peakNodes << " peak; memory: "
+         << stats.memoryBytes / 1024 << " KB" << endl;
+    cout << "Computed table: " << stats.cacheHits << " hits / " << stats.cacheLookups << " lookups" << endl;
+    cout << "Garbage collections: " << stats.collections << " (" << stats.reclaimed << " nodes freed, "
+         << stats.collectMs << " ms)" << endl;
+}
+
+/* ---------------- END Binary Decision Diagrams ---------------- */
+
+/* ---------------- BDD VARIABLE ORDERING ---------------- */
+
+/**
+ * \brief Atom order of first appearance in a left-to-right depth-first walk of the parse tree.
+ *
+ * Atoms that occur close together in the formula end up close together in the order, unlike the
+ * lexicographic order of \ref collectAtoms (where x10 comes before x2).
+ * \param root The formula.
+ * \return The atom names.
+ */
+vector<string> dfsAtomOrder(Node* root) {
+    vector<string> order;
+    unordered_set<string> seen;
+    vector<Node*> stack{root};
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        if (!node->left && !node->right) {
+            if (!isConstant(node->value) && seen.insert(node->value).second) order.push_back(node->value);
+            continue;
+        }
+        if (node->right) stack.push_back(node->right);
+        stack.push_back(node->left);
+    }
+    return order;
+}
+
+/**
+ * \brief Atom order computed by the FORCE heuristic (Aloul, Markov and Sakallah) on the parse tree.
+ *
+ * The formula is viewed as a circuit: every flattened AND/OR/implication node is a gate vertex
+ * and forms a hyperedge with its operands (negation is transparent). Starting from the DFS
+ * order, each iteration moves every vertex to the mean centre of gravity of its hyperedges and
+ * re-ranks the vertices; the ranking with the smallest total hyperedge span is kept.
+ * Hyperedges with more than \p maxEdgeSize vertices (such as the top-level conjunction of a
+ * CNF) are left out: they would pull every vertex towards the same centre.
+ * \param root The formula.
+ * \param span Receives the total span of the returned order.
+ * \param iterations Maximum number of iterations.
+ * \param maxEdgeSize Largest hyperedge taken into account.
+ * \return The atom names.
+ */
+vector<string> forceAtomOrder(Node* root, size_t& span, int iterations = 50, size_t maxEdgeSize = 64) {
+    vector<string> atoms;
+    unordered_map<string, int> atomVertex;
+    unordered_map<Node*, int> vertexOf;
+    vector<vector<int>> edges;
+    int numVertices = 0;
+    vector<int> creation; // vertex ids in creation order (atoms and gates mixed)
+
+    vector<pair<Node*, bool>> stack{{root, false}};
+    vector<Node*> children;
+    while (!stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+        if (!node->left && !node->right && isConstant(node->value)) {
+            vertexOf[node] = numVertices; // a vertex of its own that is not an atom
+            creation.push_back(numVertices++);
+            continue;
+        }
+        if (!node->left && !node->right) {
+            auto it = atomVertex.find(node->value);
+            if (it == atomVertex.end()) {
+                it = atomVertex.emplace(node->value, numVertices++).first;
+                atoms.push_back(node->value);
+                creation.push_back(it->second);
+            }
+            vertexOf[node] = it->second;
+            continue;
+        }
+        TseitinEncoder::operands(node, children);
+        if (!expanded) {
+            stack.push_back({node, true});
+            for (auto c = children.rbegin(); c != children.rend(); ++c) stack.push_back({*c, false});
+            continue;
+        }
+        if (node->value == "~") {
+            vertexOf[node] = vertexOf[children[0]];
+            continue;
+        }
+        int gate = numVertices++;
+        creation.push_back(gate);
+        vector<int> edge{gate};
+        for (Node* child : children) edge.push_back(vertexOf[child]);
+        if (edge.size() <= maxEdgeSize) edges.push_back(edge);
+        vertexOf[node] = gate;
+    }
+
+    vector<double> position(numVertices);
+    for (int i = 0; i < numVertices; ++i) position[creation[i]] = i;
+    vector<vector<int>> incident(numVertices);
+    for (int e = 0; e < (int)edges.size(); ++e) {
+        for (int v : edges[e]) incident[v].push_back(e);
+    }
+    auto totalSpan = [&](const vector<double>& pos) {
+        size_t total = 0;
+        for (const auto& edge : edges) {
+            double lo = pos[edge[0]], hi = lo;
+            for (int v : edge) lo = min(lo, pos[v]), hi = max(hi, pos[v]);
+            total += (size_t)(hi - lo);
+        }
+        return total;
+    };
+
+    vector<double> best = position, gravity(edges.size()), next(numVertices);
+    span = totalSpan(position);
+    vector<int> byPosition(numVertices);
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t e = 0; e < edges.size(); ++e) {
+            double sum = 0;
+            for (int v : edges[e]) sum += position[v];
+            gravity[e] = sum / edges[e].size();
+        }
+        for (int v = 0; v < numVertices; ++v) {
+            if (incident[v].empty()) {
+                next[v] = position[v];
+                continue;
+            }
+            double sum = 0;
+            for (int e : incident[v]) sum += gravity[e];
+            next[v] = sum / incident[v].size();
+        }
+        iota(byPosition.begin(), byPosition.end(), 0);
+        stable_sort(byPosition.begin(), byPosition.end(), [&](int a, int b) { return next[a] < next[b]; });
+        for (int rank = 0; rank < numVertices; ++rank) position[byPosition[rank]] = rank;
+        size_t current = totalSpan(position);
+        if (current >= span) break;
+        span = current;
+        best = position;
+    }
+
+    sort(atoms.begin(), atoms.end(), [&](const string& a, const string& b) {
+        return best[atomVertex[a]] < best[atomVertex[b]];
+    });
+    return atoms;
+}
+
+/**
+ * \struct OrderReport
+ * \brief Size and cost of building a BDD under one variable order.
+ */
+struct OrderReport {
+    string name;        /**< Name of the order. */
+    size_t nodes = 0;   /**< Nodes of the final BDD. */
+    size_t peak = 0;    /**< Peak live nodes during the build. */
+    uint64_t reorderings = 0; /**< Sifting runs during the build. */
+    bool aborted = false; /**< The build passed the node limit. */
+    double ms = 0;      /**< Build time (including any sifting). */
+};
+
+/**
+ * \brief Builds the BDD of a formula in a fresh manager under a given initial order.
+ * \param root The formula.
+ * \param order Atom names, top level first.
+ * \param name Name of the order for the report.
+ * \param autoReorder Enable sifting on node-count growth during the build.
+ * \param siftAtEnd Run one sifting pass on the finished BDD.
+ * \param nodeLimit Give up beyond this many live nodes.
+ * \return The report.
+ */
+OrderReport buildBddWithOrder(Node* root, const vector<string>& order, const string& name,
+                              bool autoReorder = false, bool siftAtEnd = false, size_t nodeLimit = 1 << 22) {
+    OrderReport report;
+    report.name = name;
+    auto start = chrono::steady_clock::now();
+    BddManager bdd;
+    for (const auto& atom : order) bdd.variable(atom);
+    bdd.autoReorder = autoReorder;
+    bdd.nodeLimit = nodeLimit;
+    uint32_t f = bdd.fromTree(root);
+    if (siftAtEnd && !bdd.overflowed) bdd.sift();
+    report.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    report.aborted = bdd.overflowed;
+    report.nodes = report.aborted ? nodeLimit : bdd.nodeCount(f);
+    report.peak = bdd.stats.peakNodes;
+    report.reorderings = bdd.stats.reorderings;
+    bdd.deref(f);
+    return report;
+}
+
+/**
+ * \brief Prints order reports relative to the smallest BDD among them.
+ * \param reports The reports.
+ */
+void printOrderReports(const vector<OrderReport>& reports) {
+    size_t best = SIZE_MAX;
+    for (const auto& r : reports) {
+        if (!r.aborted) best = min(best, r.nodes);
+    }
+    for (const auto& r : reports) {
+        cout << left << setw(30) << r.name << right;
+        if (r.aborted) {
+            cout << " gave up beyond " << r.nodes << " nodes after " << r.ms << " ms" << endl;
+            continue;
+        }
+        cout << setw(10) << r.nodes << " nodes (" << fixed << setprecision(2)
+             << (double)r.nodes / max<size_t>(best, 1) << "x best), peak " << r.peak << ", " << r.ms << " ms";
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+        if (r.reorderings) cout << ", " << r.reorderings << " sifting runs";
+        cout << endl;
+    }
+}
+
+/* ---------------- END BDD Variable Ordering ---------------- */
+
+/* ---------------- KNOWLEDGE COMPILATION (d-DNNF) ---------------- */
+
+/**
+ * \enum DnnfKind
+ * \brief Node kinds of a compiled \ref Dnnf circuit.
+ */
+enum class DnnfKind : uint8_t {
+    FALSE_CONST, /**< The constant false. */
+    TRUE_CONST,  /**< The constant true. */
+    LITERAL,     /**< A literal (\ref DnnfNode::value). */
+    FREE,        /**< Either value of a variable (\ref DnnfNode::value), i.e. x | ~x. */
+    AND,         /**< Conjunction of children over disjoint variables (decomposable). */
+    DECISION     /**< Disjunction of children that disagree on the variable \ref DnnfNode::value (deterministic). */
+};
+
+/**
+ * \struct DnnfNode
+ * \brief A node of a flat d-DNNF circuit; its children are
+ * <tt>children[first .. first + size)</tt> of the owning \ref Dnnf.
+ */
+struct DnnfNode {
+    DnnfKind kind;  /**< Node kind. */
+    int value;      /**< Literal (LITERAL) or variable (FREE, DECISION); unused otherwise. */
+    uint32_t first; /**< Offset of the first child. */
+    uint32_t size;  /**< Number of children. */
+};
+
+/**
+ * \struct Dnnf
+ * \brief A smooth decision-DNNF circuit in a flat array.
+ *
+ * Nodes are stored children first, so every query is one pass over \ref nodes in index order.
+ * The circuit is smooth: every variable of the formula occurs below the root, and both branches
+ * of a decision mention the same variables (free ones through FREE leaves). Counting is
+ * therefore a plain sum at decisions and product at conjunctions.
+ */
+struct Dnnf {
+    static const uint32_t FALSE_NODE = 0; /**< Index of the constant false. */
+    static const uint32_t TRUE_NODE = 1;  /**< Index of the constant true. */
+
+    int numVars = 0;           /**< Variables of the compiled formula. */
+    vector<DnnfNode> nodes;    /**< Nodes, children before parents. */
+    vector<uint32_t> children; /**< Child indices of all nodes. */
+    uint32_t root = FALSE_NODE; /**< The compiled formula. */
+    vector<string> names;      /**< Atom name of each variable. */
+
+    /** \brief Creates a circuit holding only the two constants. */
+    Dnnf() {
+        nodes.push_back({DnnfKind::FALSE_CONST, 0, 0, 0});
+        nodes.push_back({DnnfKind::TRUE_CONST, 0, 0, 0});
+    }
+
+    /**
+     * \brief Appends a node.
+     * \param kind Its kind.
+     * \param value Its literal or variable.
+     * \param kids Its children (already in the circuit).
+     * \return Its index.
+     */
+    uint32_t addNode(DnnfKind kind, int value, const vector<uint32_t>& kids = {}) {
+        nodes.push_back({kind, value, (uint32_t)children.size(), (uint32_t)kids.size()});
+        children.insert(children.end(), kids.begin(), kids.end());
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    /**
+     * \brief Number of models over the variables that occur in the circuit (all of them after
+     * compilation; the unconditioned ones after \ref condition).
+     *
+     * Counts are kept in 64 bits and only nodes whose count overflows switch to \ref BigNat.
+     */
+    BigNat count() const {
+        vector<uint64_t> small(nodes.size(), 0);
+        vector<BigNat> big(nodes.size());
+        vector<char> isBig(nodes.size(), 0);
+        auto asBig = [&](uint32_t i) { return isBig[i] ? big[i] : BigNat(small[i]); };
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const DnnfNode& node = nodes[i];
+            switch (node.kind) {
+            case DnnfKind::FALSE_CONST: break;
+            case DnnfKind::TRUE_CONST:
+            case DnnfKind::LITERAL: small[i] = 1; break;
+            case DnnfKind::FREE: small[i] = 2; break;
+            case DnnfKind::AND:
+            case DnnfKind::DECISION: {
+                bool product = node.kind == DnnfKind::AND;
+                uint64_t value = product ? 1 : 0;
+                bool overflow = false;
+                for (uint32_t k = node.first; k < node.first + node.size && !overflow; ++k) {
+                    uint32_t child = children[k];
+                    overflow = isBig[child] || (product ? __builtin_mul_overflow(value, small[child], &value)
+                                                        : __builtin_add_overflow(value, small[child], &value));
+                }
+                if (!overflow) {
+                    small[i] = value;
+                    break;
+                }
+                BigNat total(product ? 1 : 0);
+                for (uint32_t k = node.first; k < node.first + node.size; ++k) {
+                    if (product) total = total * asBig(children[k]);
+                    else total += asBig(children[k]);
+                }
+                big[i] = std::move(total);
+                isBig[i] = 1;
+                break;
+            }
+            }
+        }
+        return asBig(root);
+    }
+
+    /**
+     * \brief Weighted model count: the sum over models of the product of their literal weights.
+     *
+     * A zero weight on a literal conditions on its negation without rebuilding the circuit.
+     * \param weights weights[lit] for every literal (2 * numVars entries).
+     * \return The weighted count.
+     */
+    double weightedCount(const vector<double>& weights) const {
+        vector<double> values(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const DnnfNode& node = nodes[i];
+            switch (node.kind) {
+            case DnnfKind::FALSE_CONST: values[i] = 0; break;
+            case DnnfKind::TRUE_CONST: values[i] = 1; break;
+            case DnnfKind::LITERAL: values[i] = weights[node.value]; break;
+            case DnnfKind::FREE:
+                values[i] = weights[makeLiteral(node.value, false)] + weights[makeLiteral(node.value, true)];
+                break;
+            case DnnfKind::AND:
+                values[i] = 1;
+                for (uint32_t k = node.first; k < node.first + node.size; ++k) values[i] *= values[children[k]];
+                break;
+            case DnnfKind::DECISION:
+                values[i] = 0;
+                for (uint32_t k = node.first; k < node.first + node.size; ++k) values[i] += values[children[k]];
+                break;
+            }
+        }
+        return values[root];
+    }
+
+    /**
+     * \brief Evaluates the formula under a complete assignment.
+     * \param model model[v] is the value of variable v.
+     * \return The value of the formula.
+     */
+    bool evaluate(const vector<char>& model) const {
+        vector<char> values(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const DnnfNode& node = nodes[i];
+            switch (node.kind) {
+            case DnnfKind::FALSE_CONST: values[i] = 0; break;
+            case DnnfKind::TRUE_CONST:
+            case DnnfKind::FREE: values[i] = 1; break;
+            case DnnfKind::LITERAL: values[i] = (model[literalVar(node.value)] != 0) != literalIsNegated(node.value); break;
+            case DnnfKind::AND:
+                values[i] = 1;
+                for (uint32_t k = node.first; k < node.first + node.size && values[i]; ++k) values[i] = values[children[k]];
+                break;
+            case DnnfKind::DECISION:
+                values[i] = 0;
+                for (uint32_t k = node.first; k < node.first + node.size && !values[i]; ++k) values[i] = values[children[k]];
+                break;
+            }
+        }
+        return values[root];
+    }
+
+    /**
+     * \brief Conditions the circuit on a partial assignment.
+     *
+     * Literals of assigned variables become constants, which are then folded away. The result is
+     * again a smooth d-DNNF, over the unassigned variables, and holds only nodes reachable from
+     * its root.
+     * \param values values[v] is -1 for unassigned variables, else 0 or 1.
+     * \return The conditioned circuit.
+     */
+    Dnnf condition(const vector<signed char>& values) const {
+        vector<char> reachable(nodes.size(), 0);
+        reachable[root] = 1;
+        for (size_t i = nodes.size(); i-- > 0;) {
+            if (!reachable[i]) continue;
+            for (uint32_t k = nodes[i].first; k < nodes[i].first + nodes[i].size; ++k) reachable[children[k]] = 1;
+        }
+        Dnnf out;
+        out.numVars = numVars;
+        out.names = names;
+        vector<uint32_t> remap(nodes.size(), uint32_t(FALSE_NODE));
+        remap[TRUE_NODE] = TRUE_NODE;
+        vector<uint32_t> kids;
+        for (size_t i = 2; i < nodes.size(); ++i) {
+            if (!reachable[i]) continue;
+            const DnnfNode& node = nodes[i];
+            switch (node.kind) {
+            case DnnfKind::LITERAL: {
+                int v = values[literalVar(node.value)];
+                if (v < 0) remap[i] = out.addNode(DnnfKind::LITERAL, node.value);
+                else remap[i] = (v != 0) != literalIsNegated(node.value) ? TRUE_NODE : FALSE_NODE;
+                break;
+            }
+            case DnnfKind::FREE:
+                remap[i] = values[node.value] < 0 ? out.addNode(DnnfKind::FREE, node.value) : TRUE_NODE;
+                break;
+            case DnnfKind::AND: {
+                kids.clear();
+                bool isFalse = false;
+                for (uint32_t k = node.first; k < node.first + node.size && !isFalse; ++k) {
+                    uint32_t child = remap[children[k]];
+                    if (child == FALSE_NODE) isFalse = true;
+                    else if (child != TRUE_NODE) kids.push_back(child);
+                }
+                if (isFalse) remap[i] = FALSE_NODE;
+                else if (kids.size() <= 1) remap[i] = kids.empty() ? TRUE_NODE : kids[0];
+                else remap[i] = out.addNode(DnnfKind::AND, 0, kids);
+                break;
+            }
+            case DnnfKind::DECISION: {
+                kids.clear();
+                for (uint32_t k = node.first; k < node.first + node.size; ++k) {
+                    if (remap[children[k]] != FALSE_NODE) kids.push_back(remap[children[k]]);
+                }
+                // The decision variable is assigned iff at most one branch survives
+                if (kids.size() <= 1) remap[i] = kids.empty() ? FALSE_NODE : kids[0];
+                else remap[i] = out.addNode(DnnfKind::DECISION, node.value, kids);
+                break;
+            }
+            default: break;
+            }
+        }
+        out.root = remap[root];
+        return out;
+    }
+};
+
+/**
+ * \struct DnnfCompiler
+ * \brief Compiles a clause database to a smooth decision-DNNF.
+ *
+ * This is the trace of the exact model counter: the search (decisions, unit propagation,
+ * component splitting, branching heuristic) is that of \ref ModelCounter, but every component
+ * yields a circuit node instead of a number and the cache maps components to nodes, so a
+ * component met again is shared rather than recompiled.
+ */
+struct DnnfCompiler {
+    ModelCounter<double> search;           /**< Search state (unit weights, unused). */
+    Dnnf out;                              /**< The circuit being built. */
+    unordered_map<string, uint32_t> cache; /**< Compiled components by packed key. */
+    vector<uint32_t> literalNodes;         /**< Shared LITERAL leaf of each literal (0 if not created). */
+    vector<uint32_t> freeNodes;            /**< Shared FREE leaf of each variable (0 if not created). */
+
+    /**
+     * \brief Prepares a compiler.
+     * \param db The formula.
+     * \param options Branching heuristic tuning (the cache is not bounded: it only points into the circuit).
+     */
+    DnnfCompiler(const ClauseDB& db, const CountOptions& options = CountOptions())
+        : search(db, vector<double>(2 * (size_t)db.numVars, 1.0), options) {
+        out.numVars = db.numVars;
+        out.names = db.names;
+        literalNodes.assign(2 * (size_t)db.numVars, 0);
+        freeNodes.assign(db.numVars, 0);
+    }
+
+    /** \brief Shared leaf of a literal. */
+    uint32_t literalNode(int lit) {
+        if (!literalNodes[lit]) literalNodes[lit] = out.addNode(DnnfKind::LITERAL, lit);
+        return literalNodes[lit];
+    }
+
+    /** \brief Shared FREE leaf of a variable. */
+    uint32_t freeNode(int v) {
+        if (!freeNodes[v]) freeNodes[v] = out.addNode(DnnfKind::FREE, v);
+        return freeNodes[v];
+    }
+
+    /**
+     * \brief Conjoins the literals assigned since \p mark with the components of \p of.
+     * \param of The component the assignment was made in.
+     * \param mark Trail size before the assignment.
+     * \return The conjunction node (FALSE_NODE if a component is unsatisfiable).
+     */
+    uint32_t conjoin(const ModelCounter<double>::Component& of, size_t mark) {
+        vector<uint32_t> kids;
+        for (size_t i = mark; i < search.trail.size(); ++i) kids.push_back(literalNode(search.trail[i]));
+        vector<ModelCounter<double>::Component> parts;
+        vector<int> freeVars;
+        double unused = 1;
+        search.split(of, parts, unused, &freeVars);
+        for (int v : freeVars) kids.push_back(freeNode(v));
+        size_t end = search.trail.size();
+        for (const auto& part : parts) {
+            search.recentStart = mark;
+            search.recentEnd = end;
+            uint32_t node = compileComponent(part);
+            if (node == Dnnf::FALSE_NODE) return Dnnf::FALSE_NODE;
+            kids.push_back(node);
+        }
+        if (kids.size() <= 1) return kids.empty() ? Dnnf::TRUE_NODE : kids[0];
+        return out.addNode(DnnfKind::AND, 0, kids);
+    }
+
+    /**
+     * \brief Compiles one component under the current assignment.
+     * \param component Its variables and clauses; every clause has two or more unassigned literals.
+     * \return A node over exactly its variables.
+     */
+    uint32_t compileComponent(const ModelCounter<double>::Component& component) {
+        search.stats.components++;
+        string key = ModelCounter<double>::packKey(component);
+        auto hit = cache.find(key);
+        if (hit != cache.end()) {
+            search.stats.cacheHits++;
+            return hit->second;
+        }
+        uint32_t result = Dnnf::FALSE_NODE;
+        size_t mark = search.trail.size();
+        bool consistent = (int)component.vars.size() < search.options.probeMinVars || search.probe(component);
+        if (consistent && search.trail.size() > mark) {
+            result = conjoin(component, mark); // the implied literals and what they leave
+        } else if (consistent) {
+            int branch = search.pickBranch(component);
+            vector<uint32_t> branches;
+            for (int sign = 0; sign < 2; ++sign) {
+                search.stats.decisions++;
+                search.assign(makeLiteral(branch, sign));
+                if (!search.propagate(mark)) {
+                    search.stats.conflicts++;
+                    search.bumpConflict();
+                } else {
+                    uint32_t node = conjoin(component, mark);
+                    if (node != Dnnf::FALSE_NODE) branches.push_back(node);
+                }
+                search.undo(mark);
+            }
+            if (branches.size() == 1) result = branches[0];
+            else if (branches.size() == 2) result = out.addNode(DnnfKind::DECISION, branch, branches);
+        }
+        search.undo(mark);
+        cache.emplace(std::move(key), result);
+        return result;
+    }
+
+    /**
+     * \brief Compiles the whole formula.
+     * \return The circuit; its root is FALSE_NODE if the formula is unsatisfiable.
+     */
+    Dnnf compile() {
+        auto start = chrono::steady_clock::now();
+        const ClauseDB& db = search.db;
+        bool conflict = false;
+        for (const auto& clause : db.clauses) {
+            if (clause.empty()) conflict = true;
+        }
+        // Top-level units
+        for (const auto& clause : db.clauses) {
+            if (conflict || clause.size() != 1) continue;
+            int val = search.literalValue(clause[0]);
+            if (val == 0) conflict = true;
+            else if (val < 0) search.assign(clause[0]);
+        }
+        if (!conflict && search.propagate(0)) {
+            ModelCounter<double>::Component all;
+            all.vars.resize(db.numVars);
+            iota(all.vars.begin(), all.vars.end(), 0);
+            all.clauses.resize(db.clauses.size());
+            iota(all.clauses.begin(), all.clauses.end(), 0);
+            out.root = conjoin(all, 0);
+        }
+        search.undo(0);
+        search.stats.cacheEntries = cache.size();
+        search.stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return std::move(out);
+    }
+};
+
+/**
+ * \brief Compiles a clause database to a smooth decision-DNNF.
+ * \param db The formula.
+ * \param stats Receives the search counters.
+ * \param options Branching heuristic tuning.
+ * \return The circuit.
+ */
+Dnnf compileDnnf(const ClauseDB& db, CountStats& stats, const CountOptions& options = CountOptions()) {
+    DnnfCompiler compiler(db, options);
+    Dnnf result = compiler.compile();
+    stats = compiler.search.stats;
+    return result;
+}
+
+/**
+ * \brief Prints the size of a circuit and the counters of its compilation.
+ * \param dnnf The circuit.
+ * \param stats The compilation counters.
+ */
+void printDnnfStats(const Dnnf& dnnf, const CountStats& stats) {
+    size_t decisions = 0, ands = 0;
+    for (const auto& node : dnnf.nodes) {
+        decisions += node.kind == DnnfKind::DECISION;
+        ands += node.kind == DnnfKind::AND;
+    }
+    cout << "d-DNNF: " << dnnf.nodes.size() << " nodes (" << decisions << " decisions, " << ands
+         << " conjunctions), " << dnnf.children.size() << " edges, "
+         << (dnnf.nodes.size() * sizeof(DnnfNode) + dnnf.children.size() * sizeof(uint32_t)) / 1024 << " KB" << endl;
+    cout << "Compilation: " << stats.ms << " ms, " << stats.decisions << " decisions, " << stats.components
+         << " components, " << stats.cacheHits << " cache hits" << endl;
+}
+
+/* ---------------- END Knowledge Compilation ---------------- */
+
+/* ---------------- AND-INVERTER GRAPHS ---------------- */
+
+/**
+ * \struct AigNode
+ * \brief A node of an \ref Aig: a two-input AND of literals, an input, or the constant.
+ */
+struct AigNode {
+    uint32_t fanin0; /**< Smaller fanin literal (AND nodes only). */
+    uint32_t fanin1; /**< Larger fanin literal (AND nodes only). */
+    int input;       /**< Input index, or -1 for AND nodes and the constant. */
+};
+
+/**
+ * \struct AigStats
+ * \brief Size of an AIG cone next to the parse tree it came from.
+ */
+struct AigStats {
+    size_t treeNodes = 0; /**< Nodes of the parse tree. */
+    int treeDepth = 0;    /**< Operator levels of the parse tree. */
+    size_t inputs = 0;    /**< AIG inputs (atoms). */
+    size_t ands = 0;      /**< AND nodes in the cone of the output. */
+    int levels = 0;       /**< AND levels on the longest path to the output. */
+    size_t strashHits = 0; /**< AND requests answered by an existing node. */
+    size_t folded = 0;    /**< AND requests answered by constant propagation or a trivial identity. */
+    double ms = 0;        /**< Build time. */
+};
+
+/**
+ * \struct Aig
+ * \brief An And-Inverter Graph: two-input AND nodes with complemented edges and structural hashing.
+ *
+ * A literal is 2 * node + complement. Node 0 is the constant false, so literal 0 is false and
+ * literal 1 is true. AND nodes are created only through \ref andLit, which folds constants and
+ * trivial cases (x & x, x & ~x), orders the fanins and returns an existing node for a known
+ * fanin pair, so structurally equal subformulas are stored once. Fanins are always created
+ * before their fanouts, so node order is a topological order.
+ */
+struct Aig {
+    static const uint32_t FALSE_LIT = 0; /**< The constant false. */
+    static const uint32_t TRUE_LIT = 1;  /**< The constant true. */
+
+    vector<AigNode> nodes;                     /**< Nodes; node 0 is the constant. */
+    vector<uint32_t> inputs;                   /**< Node of each input. */
+    vector<string> inputNames;                 /**< Atom name of each input. */
+    unordered_map<string, uint32_t> inputIndex; /**< Atom name to input index. */
+    unordered_map<uint64_t, uint32_t> strash;  /**< Fanin pair to AND node. */
+    AigStats stats;                            /**< Build counters. */
+
+    /** \brief Creates an AIG holding only the constant. */
+    Aig() { nodes.push_back({0, 0, -1}); }
+
+    /** \brief Node of a literal. */
+    static uint32_t nodeOf(uint32_t lit) { return lit >> 1; }
+    /** \brief Returns true if a literal is complemented. */
+    static bool isComplemented(uint32_t lit) { return lit & 1; }
+    /** \brief Returns true if a node is an AND node. */
+    bool isAnd(uint32_t node) const { return node != 0 && nodes[node].input < 0; }
+
+    /** \brief Returns the literal of an atom, creating its input on first use. */
+    uint32_t input(const string& name) {
+        auto it = inputIndex.find(name);
+        if (it != inputIndex.end()) return 2 * inputs[it->second];
+        inputIndex[name] = (uint32_t)inputs.size();
+        inputs.push_back((uint32_t)nodes.size());
+        inputNames.push_back(name);
+        nodes.push_back({0, 0, (int)inputs.size() - 1});
+        return 2 * inputs.back();
+    }
+
+    /**
+     * \brief Returns a literal for a & b, reusing an existing node where possible.
+     * \param a First operand.
+     * \param b Second operand.
+     * \return The literal of the conjunction.
+     */
+    uint32_t andLit(uint32_t a, uint32_t b) {
+        if (a > b) swap(a, b);
+        if (a == FALSE_LIT || a == (b ^ 1)) {
+            stats.folded++;
+            return FALSE_LIT;
+        }
+        if (a == TRUE_LIT || a == b) {
+            stats.folded++;
+            return b;
+        }
+        uint64_t key = ((uint64_t)a << 32) | b;
+        auto it = strash.find(key);
+        if (it != strash.end()) {
+            stats.strashHits++;
+            return 2 * it->second;
+        }
+        uint32_t node = (uint32_t)nodes.size();
+        nodes.push_back({a, b, -1});
+        strash.emplace(key, node);
+        return 2 * node;
+    }
+
+    /**
+     * \brief Returns the literal \ref andLit would return for a & b if that needs no new node.
+     * \return The literal, or UINT32_MAX if a new node would be created.
+     */
+    uint32_t lookupAnd(uint32_t a, uint32_t b) const {
+        if (a > b) swap(a, b);
+        if (a == FALSE_LIT || a == (b ^ 1)) return FALSE_LIT;
+        if (a == TRUE_LIT || a == b) return b;
+        auto it = strash.find(((uint64_t)a << 32) | b);
+        return it == strash.end() ? UINT32_MAX : 2 * it->second;
+    }
+
+    /** \brief Returns a literal for a | b. */
+    uint32_t orLit(uint32_t a, uint32_t b) { return andLit(a ^ 1, b ^ 1) ^ 1; }
+
+    /**
+     * \brief Conjoins (or disjoins) literals as a balanced tree, which keeps the depth logarithmic.
+     *
+     * The operands are sorted first, so every ordering of the same chain (a * (b * c) and
+     * (c * a) * b) yields the same nodes, and duplicate or complementary operands meet and fold.
+     * \param lits The operands; consumed.
+     * \param isAnd true for AND, false for OR.
+     * \return The literal of the result.
+     */
+    uint32_t combineBalanced(vector<uint32_t>& lits, bool isAnd) {
+        if (lits.empty()) return isAnd ? TRUE_LIT : FALSE_LIT;
+        sort(lits.begin(), lits.end());
+        while (lits.size() > 1) {
+            size_t out = 0;
+            for (size_t i = 0; i + 1 < lits.size(); i += 2) lits[out++] = isAnd ? andLit(lits[i], lits[i + 1]) : orLit(lits[i], lits[i + 1]);
+            if (lits.size() % 2) lits[out++] = lits.back();
+            lits.resize(out);
+        }
+        return lits[0];
+    }
+
+    /**
+     * \brief Builds the AIG of a parse tree.
+     *
+     * Iterative post-order traversal; chains of the same AND/OR operator are flattened and
+     * rebuilt balanced, OR is lowered to ~(~a & ~b) and A > B to ~(A & ~B). Shared subtrees are
+     * built once.
+     * \param root Root of the parse tree.
+     * \return The literal of the formula.
+     */
+    uint32_t fromTree(Node* root) {
+        auto start = chrono::steady_clock::now();
+        unordered_map<Node*, uint32_t> literalOf;
+        vector<pair<Node*, bool>> stack{{root, false}};
+        vector<Node*> children;
+        vector<uint32_t> lits;
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            if (literalOf.count(node)) continue;
+            if (!node->left && !node->right) {
+                if (isConstant(node->value)) literalOf[node] = node->value == "1" ? uint32_t(TRUE_LIT) : uint32_t(FALSE_LIT);
+                else literalOf[node] = input(node->value);
+                continue;
+            }
+            TseitinEncoder::operands(node, children);
+            if (!expanded) {
+                stack.push_back({node, true});
+                for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                    if (!literalOf.count(*it)) stack.push_back({*it, false});
+                }
+                continue;
+            }
+            lits.clear();
+            for (Node* child : children) lits.push_back(literalOf[child]);
+            if (node->value == "~") literalOf[node] = lits[0] ^ 1;
+            else if (node->value == ">") literalOf[node] = andLit(lits[0], lits[1] ^ 1) ^ 1;
+            else literalOf[node] = combineBalanced(lits, node->value == "*");
+        }
+        stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return literalOf[root];
+    }
+
+    /**
+     * \brief Marks the nodes in the cone of a literal.
+     * \param lit The output.
+     * \return inCone[node] for every node.
+     */
+    vector<char> cone(uint32_t lit) const {
+        vector<char> inCone(nodes.size(), 0);
+        inCone[nodeOf(lit)] = 1;
+        for (size_t n = nodes.size(); n-- > 1;) {
+            if (!inCone[n] || !isAnd((uint32_t)n)) continue;
+            inCone[nodeOf(nodes[n].fanin0)] = 1;
+            inCone[nodeOf(nodes[n].fanin1)] = 1;
+        }
+        return inCone;
+    }
+
+    /**
+     * \brief Counts the references to every node from the AND nodes in the cone of a literal
+     * and from the output itself.
+     * \param lit The output.
+     * \return fanouts[node].
+     */
+    vector<int> fanouts(uint32_t lit) const {
+        vector<char> inCone = cone(lit);
+        vector<int> out(nodes.size(), 0);
+        out[nodeOf(lit)]++;
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!inCone[n] || !isAnd((uint32_t)n)) continue;
+            out[nodeOf(nodes[n].fanin0)]++;
+            out[nodeOf(nodes[n].fanin1)]++;
+        }
+        return out;
+    }
+
+    /**
+     * \brief Counts the AND nodes and levels in the cone of a literal into \ref stats.
+     * \param lit The output.
+     */
+    void measure(uint32_t lit) {
+        vector<char> inCone = cone(lit);
+        vector<int> level(nodes.size(), 0);
+        stats.inputs = inputs.size();
+        stats.ands = 0;
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!inCone[n] || !isAnd((uint32_t)n)) continue;
+            stats.ands++;
+            level[n] = 1 + max(level[nodeOf(nodes[n].fanin0)], level[nodeOf(nodes[n].fanin1)]);
+        }
+        stats.levels = level[nodeOf(lit)];
+    }
+
+    /**
+     * \brief Bit-parallel simulation: 64 input patterns per word, \p words words per node.
+     * \param inputWords inputWords[i * words + w] holds word w of the patterns of input i.
+     * \param words Words per node.
+     * \param values Receives values[node * words + w] for every node.
+     */
+    void simulate(const vector<uint64_t>& inputWords, size_t words, vector<uint64_t>& values) const {
+        values.assign(nodes.size() * words, 0);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            copy(inputWords.begin() + i * words, inputWords.begin() + (i + 1) * words, values.begin() + inputs[i] * words);
+        }
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!isAnd((uint32_t)n)) continue;
+            const uint64_t* a = &values[nodeOf(nodes[n].fanin0) * words];
+            const uint64_t* b = &values[nodeOf(nodes[n].fanin1) * words];
+            uint64_t maskA = isComplemented(nodes[n].fanin0) ? ~0ull : 0, maskB = isComplemented(nodes[n].fanin1) ? ~0ull : 0;
+            uint64_t* out = &values[n * words];
+            for (size_t w = 0; w < words; ++w) out[w] = (a[w] ^ maskA) & (b[w] ^ maskB);
+        }
+    }
+
+    /**
+     * \brief Value of a literal in a simulation.
+     * \param values Node values from \ref simulate.
+     * \param words Words per node.
+     * \param lit The literal.
+     * \param w The word.
+     * \return Word \p w of the literal's patterns.
+     */
+    static uint64_t literalWord(const vector<uint64_t>& values, size_t words, uint32_t lit, size_t w) {
+        return values[nodeOf(lit) * words + w] ^ (isComplemented(lit) ? ~0ull : 0);
+    }
+
+    /**
+     * \brief Evaluates a literal under one assignment of the atoms.
+     * \param lit The literal.
+     * \param values Atom values; missing atoms are false.
+     * \return The value.
+     */
+    bool evaluate(uint32_t lit, const unordered_map<string, bool>& values) const {
+        vector<uint64_t> inputWords(inputs.size(), 0), nodeValues;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            auto it = values.find(inputNames[i]);
+            if (it != values.end() && it->second) inputWords[i] = 1;
+        }
+        simulate(inputWords, 1, nodeValues);
+        return literalWord(nodeValues, 1, lit, 0) & 1;
+    }
+
+    /**
+     * \brief Tseitin export of the cone of a literal to CNF.
+     *
+     * Variables 0 .. inputs-1 are the atoms (named after them). A tree of AND nodes joined by
+     * uncomplemented single-fanout edges becomes one n-ary AND gate: one variable and n + 1
+     * clauses instead of n - 1 variables and 3(n - 1) clauses. Gate variables are named "_a<n>";
+     * a constant output gets a variable "_false" fixed by a unit clause.
+     * \param lit The output.
+     * \param output Receives the CNF literal equivalent to \p lit.
+     * \return The clause database.
+     */
+    ClauseDB toCnf(uint32_t lit, int& output) const {
+        ClauseDB db;
+        db.numVars = (int)inputs.size();
+        db.names = inputNames;
+        if (nodeOf(lit) == 0) {
+            db.names.push_back("_false");
+            db.clauses.push_back({makeLiteral(db.numVars, true)});
+            output = makeLiteral(db.numVars++, isComplemented(lit));
+            return db;
+        }
+        vector<char> inCone = cone(lit);
+        vector<int> refs = fanouts(lit);
+        // An AND node whose only fanout is an uncomplemented AND edge is absorbed into that AND
+        auto absorbed = [&](uint32_t l) { return !isComplemented(l) && isAnd(nodeOf(l)) && refs[nodeOf(l)] == 1; };
+        vector<int> varOf(nodes.size(), -1);
+        for (size_t i = 0; i < inputs.size(); ++i) varOf[inputs[i]] = (int)i;
+        vector<char> isGate(nodes.size(), 0);
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (inCone[n] && isAnd((uint32_t)n)) isGate[n] = 1;
+        }
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!isGate[n]) continue;
+            if (absorbed(nodes[n].fanin0)) isGate[nodeOf(nodes[n].fanin0)] = 0;
+            if (absorbed(nodes[n].fanin1)) isGate[nodeOf(nodes[n].fanin1)] = 0;
+        }
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!isGate[n]) continue;
+            varOf[n] = db.numVars++;
+            db.names.push_back("_a" + to_string(n));
+        }
+        vector<uint32_t> pending;
+        vector<int> big;
+        for (size_t n = 1; n < nodes.size(); ++n) {
+            if (!isGate[n]) continue;
+            int gate = makeLiteral(varOf[n], false);
+            big.assign(1, gate);
+            pending.assign({nodes[n].fanin1, nodes[n].fanin0});
+            while (!pending.empty()) {
+                uint32_t l = pending.back();
+                pending.pop_back();
+                if (absorbed(l)) {
+                    pending.push_back(nodes[nodeOf(l)].fanin1);
+                    pending.push_back(nodes[nodeOf(l)].fanin0);
+                    continue;
+                }
+                int leaf = makeLiteral(varOf[nodeOf(l)], isComplemented(l));
+                db.clauses.push_back({negateLiteral(gate), leaf});
+                big.push_back(negateLiteral(leaf));
+            }
+            db.clauses.push_back(big);
+        }
+        output = makeLiteral(varOf[nodeOf(lit)], isComplemented(lit));
+        return db;
+    }
+};
+
+/**
+ * \brief Counts the nodes and operator levels of a parse tree (iteratively).
+ * \param root Root of the tree.
+ * \param nodes Receives the number of nodes.
+ * \param depth Receives the number of operator levels on the longest path.
+ */
+void measureTree(Node* root, size_t& nodes, int& depth) {
+    nodes = 0;
+    depth = 0;
+    vector<pair<Node*, int>> stack{{root, 0}};
+    while (!stack.empty()) {
+        auto [node, level] = stack.back();
+        stack.pop_back();
+        nodes++;
+        if (!node->left && !node->right) {
+            depth = max(depth, level);
+            continue;
+        }
+        if (node->left) stack.push_back({node->left, level + 1});
+        if (node->right) stack.push_back({node->right, level + 1});
+    }
+}
+
+/**
+ * \brief Prints the size of an AIG next to its parse tree.
+ * \param stats The counts (see \ref Aig::measure and \ref measureTree).
+ */
+void printAigStats(const AigStats& stats) {
+    cout << "Parse tree: " << stats.treeNodes << " nodes, depth " << stats.treeDepth << endl;
+    cout << "AIG: " << stats.inputs << " inputs, " << stats.ands << " AND nodes, " << stats.levels
+         << " levels (built in " << stats.ms << " ms; " << stats.strashHits << " structural hash hits, "
+         << stats.folded << " folded)" << endl;
+}
+
+/* ---------------- END And-Inverter Graphs ---------------- */
+
+/* ---------------- AIG REWRITING ---------------- */
+
+/** \brief Truth tables of the four cut variables (bit m is the value under minterm m). */
+const uint16_t CUT_VAR_TRUTH[4] = {0xAAAA, 0xCCCC, 0xF0F0, 0xFF00};
+
+/** \brief Negative cofactor of a 4-input truth table in variable \p i (as a 4-input table). */
+inline uint16_t cofactor0(uint16_t f, int i) {
+    uint16_t low = f & (uint16_t)~CUT_VAR_TRUTH[i];
+    return low | (uint16_t)(low << (1 << i));
+}
+
+/** \brief Positive cofactor of a 4-input truth table in variable \p i (as a 4-input table). */
+inline uint16_t cofactor1(uint16_t f, int i) {
+    uint16_t high = f & CUT_VAR_TRUTH[i];
+    return high | (uint16_t)(high >> (1 << i));
+}
+
+/**
+ * \struct NpnTransform
+ * \brief Relates a 4-input function f to its NPN class representative c:
+ * f(x) = outputNegated ^ c(z) with z_j = x_{perm[j]} ^ bit j of \ref negations.
+ */
+struct NpnTransform {
+    uint16_t canonical = 0;   /**< The class representative (smallest truth table of the class). */
+    uint8_t perm[4] = {0, 1, 2, 3}; /**< Input of f feeding input j of the representative. */
+    uint8_t negations = 0;    /**< Inputs of the representative that are complemented. */
+    bool outputNegated = false; /**< Whether the output is complemented. */
+};
+
+/**
+ * \struct NpnImplementation
+ * \brief A small AIG over four inputs. Local literals: 0/1 constants, 2 * (j + 1) input j,
+ * 2 * (5 + g) gate g; gates only refer to earlier gates.
+ */
+struct NpnImplementation {
+    vector<pair<uint8_t, uint8_t>> gates; /**< Fanin literals of each AND gate. */
+    uint8_t output = 0;                   /**< Output literal. */
+};
+
+/**
+ * \struct NpnLibrary
+ * \brief Canonical forms of 4-input functions under input negation, input permutation and output
+ * negation (NPN), and a small implementation of each class representative.
+ *
+ * There are only 222 NPN classes of 4-input functions, so implementations are computed once per
+ * class on first use: the smallest of several syntheses (Shannon expansion in every variable
+ * order, and the factored irredundant sum of products of the function and of its complement),
+ * each built with structural hashing. Transforms are memoized per truth table.
+ */
+struct NpnLibrary {
+    vector<array<uint8_t, 16>> maps;  /**< For every (permutation, negations): minterm z to minterm x. */
+    vector<array<uint8_t, 4>> perms;  /**< The permutation of each map. */
+    vector<NpnTransform> transforms;  /**< Memoized transform of each truth table. */
+    vector<char> known;               /**< Whether \ref transforms holds the entry. */
+    unordered_map<uint16_t, NpnImplementation> implementations; /**< Implementation of each representative. */
+
+    /** \brief Precomputes the 384 input transformations. */
+    NpnLibrary() : transforms(1 << 16), known(1 << 16, 0) {
+        array<uint8_t, 4> perm = {0, 1, 2, 3};
+        do {
+            for (int negations = 0; negations < 16; ++negations) {
+                array<uint8_t, 16> map;
+                for (int z = 0; z < 16; ++z) {
+                    int x = 0;
+                    for (int j = 0; j < 4; ++j) x |= (((z >> j) ^ (negations >> j)) & 1) << perm[j];
+                    map[z] = (uint8_t)x;
+                }
+                maps.push_back(map);
+                perms.push_back(perm);
+            }
+        } while (next_permutation(perm.begin(), perm.end()));
+    }
+
+    /**
+     * \brief Finds the NPN class of a function by trying all 768 transformations.
+     * \param f The truth table.
+     * \return The representative and the transform to it.
+     */
+    const NpnTransform& transform(uint16_t f) {
+        if (known[f]) return transforms[f];
+        NpnTransform best;
+        best.canonical = 0xFFFF;
+        bool first = true;
+        for (size_t t = 0; t < maps.size(); ++t) {
+            uint16_t g = 0;
+            for (int z = 0; z < 16; ++z) g |= (uint16_t)(((f >> maps[t][z]) & 1) << z);
+            for (int negate = 0; negate < 2; ++negate) {
+                uint16_t candidate = negate ? (uint16_t)~g : g;
+                if (first || candidate < best.canonical) {
+                    first = false;
+                    best.canonical = candidate;
+                    for (int j = 0; j < 4; ++j) best.perm[j] = perms[t][j];
+                    best.negations = (uint8_t)(t % 16);
+                    best.outputNegated = negate;
+                }
+            }
+        }
+        known[f] = 1;
+        return transforms[f] = best;
+    }
+
+    /**
+     * \brief Shannon expansion along a variable order, with complement-aware sharing.
+     * \param aig Scratch graph with the four inputs.
+     * \param f The function.
+     * \param order Variable order.
+     * \param memo Literal of each function built so far.
+     * \return The literal of \p f.
+     */
+    static uint32_t shannon(Aig& aig, uint16_t f, const array<int, 4>& order, unordered_map<uint16_t, uint32_t>& memo) {
+        if (f == 0) return Aig::FALSE_LIT;
+        if (f == 0xFFFF) return Aig::TRUE_LIT;
+        auto it = memo.find(f);
+        if (it != memo.end()) return it->second;
+        it = memo.find((uint16_t)~f);
+        if (it != memo.end()) return it->second ^ 1;
+        int x = -1;
+        for (int v : order) {
+            if (cofactor0(f, v) != cofactor1(f, v)) {
+                x = v;
+                break;
+            }
+        }
+        uint32_t input = 2 * (uint32_t)(x + 1);
+        uint32_t high = shannon(aig, cofactor1(f, x), order, memo);
+        uint32_t low = shannon(aig, cofactor0(f, x), order, memo);
+        uint32_t result = aig.orLit(aig.andLit(input, high), aig.andLit(input ^ 1, low));
+        memo[f] = result;
+        return result;
+    }
+
+    /** \brief A product term: bit j of \c pos / \c neg set if x_j / ~x_j occurs. */
+    struct Cube {
+        uint8_t pos, neg;
+    };
+
+    /**
+     * \brief Irredundant sum of products of an incompletely specified function (Minato-Morreale).
+     * \param lower Minterms that must be covered.
+     * \param upper Minterms that may be covered (a superset of \p lower).
+     * \param cubes Receives the cubes.
+     * \return The function of the cover.
+     */
+    static uint16_t isop(uint16_t lower, uint16_t upper, vector<Cube>& cubes) {
+        if (lower == 0) return 0;
+        if (upper == 0xFFFF) {
+            cubes.push_back({0, 0});
+            return 0xFFFF;
+        }
+        int x = 3;
+        while (cofactor0(lower, x) == cofactor1(lower, x) && cofactor0(upper, x) == cofactor1(upper, x)) x--;
+        uint16_t l0 = cofactor0(lower, x), l1 = cofactor1(lower, x), u0 = cofactor0(upper, x), u1 = cofactor1(upper, x);
+        size_t start0 = cubes.size();
+        uint16_t f0 = isop(l0 & (uint16_t)~u1, u0, cubes);
+        for (size_t i = start0; i < cubes.size(); ++i) cubes[i].neg |= 1 << x;
+        size_t start1 = cubes.size();
+        uint16_t f1 = isop(l1 & (uint16_t)~u0, u1, cubes);
+        for (size_t i = start1; i < cubes.size(); ++i) cubes[i].pos |= 1 << x;
+        uint16_t rest = isop((l0 & (uint16_t)~f0) | (l1 & (uint16_t)~f1), u0 & u1, cubes);
+        return (f0 & (uint16_t)~CUT_VAR_TRUTH[x]) | (f1 & CUT_VAR_TRUTH[x]) | rest;
+    }
+
+    /**
+     * \brief Builds a factored form of a cover: the literal shared by most cubes is factored out
+     * recursively.
+     * \param aig Scratch graph with the four inputs.
+     * \param cubes The cover.
+     * \return The literal of the cover.
+     */
+    static uint32_t factor(Aig& aig, const vector<Cube>& cubes) {
+        if (cubes.empty()) return Aig::FALSE_LIT;
+        int best = -1, bestCount = 1;
+        for (int l = 0; l < 8; ++l) {
+            int count = 0;
+            for (const Cube& cube : cubes) count += (((l & 1) ? cube.neg : cube.pos) >> (l / 2)) & 1;
+            if (count > bestCount) best = l, bestCount = count;
+        }
+        if (best < 0) {
+            vector<uint32_t> terms;
+            for (const Cube& cube : cubes) {
+                vector<uint32_t> lits;
+                for (int j = 0; j < 4; ++j) {
+                    if ((cube.pos >> j) & 1) lits.push_back(2 * (uint32_t)(j + 1));
+                    if ((cube.neg >> j) & 1) lits.push_back(2 * (uint32_t)(j + 1) + 1);
+                }
+                terms.push_back(aig.combineBalanced(lits, true));
+            }
+            return aig.combineBalanced(terms, false);
+        }
+        vector<Cube> quotient, remainder;
+        uint8_t bit = (uint8_t)(1 << (best / 2));
+        for (const Cube& cube : cubes) {
+            if (((best & 1) ? cube.neg : cube.pos) & bit) {
+                Cube rest = cube;
+                if (best & 1) rest.neg &= (uint8_t)~bit;
+                else rest.pos &= (uint8_t)~bit;
+                quotient.push_back(rest);
+            } else {
+                remainder.push_back(cube);
+            }
+        }
+        uint32_t literal = 2 * (uint32_t)(best / 2 + 1) + (best & 1);
+        return aig.orLit(aig.andLit(literal, factor(aig, quotient)), factor(aig, remainder));
+    }
+
+    /**
+     * \brief Returns the implementation of a class representative, synthesizing it on first use.
+     * \param canonical The representative.
+     * \return Its implementation.
+     */
+    const NpnImplementation& implementation(uint16_t canonical) {
+        auto it = implementations.find(canonical);
+        if (it != implementations.end()) return it->second;
+        Aig best;
+        uint32_t bestOutput = 0;
+        size_t bestSize = SIZE_MAX;
+        auto consider = [&](Aig& aig, uint32_t output) {
+            aig.measure(output);
+            if (aig.stats.ands < bestSize) {
+                bestSize = aig.stats.ands;
+                best = aig;
+                bestOutput = output;
+            }
+        };
+        auto scratch = []() {
+            Aig aig;
+            for (int j = 0; j < 4; ++j) aig.input(to_string(j));
+            return aig;
+        };
+        array<int, 4> order = {0, 1, 2, 3};
+        do {
+            Aig aig = scratch();
+            unordered_map<uint16_t, uint32_t> memo;
+            uint32_t output = shannon(aig, canonical, order, memo);
+            consider(aig, output);
+        } while (next_permutation(order.begin(), order.end()));
+        for (int negate = 0; negate < 2; ++negate) {
+            uint16_t f = negate ? (uint16_t)~canonical : canonical;
+            vector<Cube> cubes;
+            isop(f, f, cubes);
+            Aig aig = scratch();
+            uint32_t output = factor(aig, cubes) ^ (uint32_t)negate;
+            consider(aig, output);
+        }
+
+        // Renumber the cone of the output into local literals
+        NpnImplementation impl;
+        vector<char> inCone = best.cone(bestOutput);
+        vector<uint8_t> local(best.nodes.size(), 0);
+        for (uint32_t n = 1; n <= 4; ++n) local[n] = (uint8_t)n;
+        for (uint32_t n = 5; n < best.nodes.size(); ++n) {
+            if (!inCone[n]) continue;
+            auto localLit = [&](uint32_t lit) { return (uint8_t)(2 * local[Aig::nodeOf(lit)] + (lit & 1)); };
+            impl.gates.push_back({localLit(best.nodes[n].fanin0), localLit(best.nodes[n].fanin1)});
+            local[n] = (uint8_t)(4 + impl.gates.size());
+        }
+        impl.output = (uint8_t)(2 * local[Aig::nodeOf(bestOutput)] + (bestOutput & 1));
+        return implementations[canonical] = impl;
+    }
+};
+
+/**
+ * \struct AigCut
+ * \brief A cut of at most four leaves and the node's function over them (leaf i is variable i).
+ */
+struct AigCut {
+    uint32_t leaves[4]; /**< Leaf nodes, ascending. */
+    uint8_t size;       /**< Number of leaves. */
+    uint16_t truth;     /**< Truth table of the node over the leaves. */
+};
+
+/**
+ * \struct RewriteStats
+ * \brief Counters of \ref AigRewriter::optimize.
+ */
+struct RewriteStats {
+    size_t andsBefore = 0, andsAfter = 0;   /**< AND nodes in the output cone. */
+    int levelsBefore = 0, levelsAfter = 0;  /**< Levels of the output cone. */
+    int passes = 0;                         /**< Rewriting passes that reduced the graph. */
+    size_t cuts = 0;                        /**< Cuts evaluated. */
+    size_t replacements = 0;                /**< Subgraphs replaced. */
+    size_t classes = 0;                     /**< NPN classes implemented. */
+    double ms = 0;                          /**< Optimization time. */
+};
+
+/**
+ * \brief Copies the cone of a literal into a fresh graph with the same inputs (in the same order).
+ * \param in The graph.
+ * \param output The literal.
+ * \param newOutput Receives the literal in the copy.
+ * \return The copy, without nodes outside the cone.
+ */
+Aig compactAig(const Aig& in, uint32_t output, uint32_t& newOutput) {
+    Aig out;
+    for (const auto& name : in.inputNames) out.input(name);
+    vector<char> inCone = in.cone(output);
+    vector<uint32_t> map(in.nodes.size(), uint32_t(Aig::FALSE_LIT));
+    for (size_t i = 0; i < in.inputs.size(); ++i) map[in.inputs[i]] = 2 * out.inputs[i];
+    auto mapLit = [&](uint32_t lit) { return map[Aig::nodeOf(lit)] ^ (lit & 1); };
+    for (uint32_t n = 1; n < in.nodes.size(); ++n) {
+        if (inCone[n] && in.isAnd(n)) map[n] = out.andLit(mapLit(in.nodes[n].fanin0), mapLit(in.nodes[n].fanin1));
+    }
+    newOutput = mapLit(output);
+    out.stats = AigStats();
+    return out;
+}
+
+/**
+ * \brief Rebuilds a graph with smaller depth.
+ *
+ * Each maximal multi-input AND (a tree of AND nodes joined by uncomplemented single-fanout edges)
+ * is collected and rebuilt by repeatedly conjoining its two shallowest operands, so late-arriving
+ * operands end up near the top. Duplicate operands are merged and complementary ones give false.
+ * \param in The graph.
+ * \param output Its output literal.
+ * \param newOutput Receives the output literal of the result.
+ * \return The balanced graph.
+ */
+Aig balanceAig(const Aig& in, uint32_t output, uint32_t& newOutput) {
+    Aig out;
+    for (const auto& name : in.inputNames) out.input(name);
+    vector<int> level(out.nodes.size(), 0);
+    auto andLevel = [&](uint32_t a, uint32_t b) {
+        uint32_t lit = out.andLit(a, b);
+        if (out.nodes.size() > level.size()) level.push_back(1 + max(level[Aig::nodeOf(a)], level[Aig::nodeOf(b)]));
+        return lit;
+    };
+    vector<char> inCone = in.cone(output);
+    vector<int> refs = in.fanouts(output);
+    auto absorbed = [&](uint32_t lit) { return !Aig::isComplemented(lit) && in.isAnd(Aig::nodeOf(lit)) && refs[Aig::nodeOf(lit)] == 1; };
+    vector<char> isRoot(in.nodes.size(), 0);
+    for (uint32_t n = 1; n < in.nodes.size(); ++n) {
+        if (inCone[n] && in.isAnd(n)) isRoot[n] = 1;
+    }
+    for (uint32_t n = 1; n < in.nodes.size(); ++n) {
+        if (!isRoot[n]) continue;
+        if (absorbed(in.nodes[n].fanin0)) isRoot[Aig::nodeOf(in.nodes[n].fanin0)] = 0;
+        if (absorbed(in.nodes[n].fanin1)) isRoot[Aig::nodeOf(in.nodes[n].fanin1)] = 0;
+    }
+    vector<uint32_t> map(in.nodes.size(), uint32_t(Aig::FALSE_LIT));
+    for (size_t i = 0; i < in.inputs.size(); ++i) map[in.inputs[i]] = 2 * out.inputs[i];
+    vector<uint32_t> pending, leaves;
+    for (uint32_t n = 1; n < in.nodes.size(); ++n) {
+        if (!isRoot[n]) continue;
+        leaves.clear();
+        pending.assign({in.nodes[n].fanin0, in.nodes[n].fanin1});
+        while (!pending.empty()) {
+            uint32_t lit = pending.back();
+            pending.pop_back();
+            if (absorbed(lit)) {
+                pending.push_back(in.nodes[Aig::nodeOf(lit)].fanin0);
+                pending.push_back(in.nodes[Aig::nodeOf(lit)].fanin1);
+            } else {
+                leaves.push_back(map[Aig::nodeOf(lit)] ^ (lit & 1));
+            }
+        }
+        sort(leaves.begin(), leaves.end());
+        leaves.erase(unique(leaves.begin(), leaves.end()), leaves.end());
+        bool contradiction = false;
+        for (size_t i = 0; i + 1 < leaves.size(); ++i) contradiction |= (leaves[i] ^ 1) == leaves[i + 1];
+        if (contradiction || leaves[0] == Aig::FALSE_LIT) {
+            map[n] = Aig::FALSE_LIT;
+            continue;
+        }
+        priority_queue<pair<int, uint32_t>, vector<pair<int, uint32_t>>, greater<pair<int, uint32_t>>> byLevel;
+        for (uint32_t lit : leaves) byLevel.push({level[Aig::nodeOf(lit)], lit});
+        while (byLevel.size() > 1) {
+            uint32_t a = byLevel.top().second;
+            byLevel.pop();
+            uint32_t b = byLevel.top().second;
+            byLevel.pop();
+            uint32_t lit = andLevel(a, b);
+            byLevel.push({level[Aig::nodeOf(lit)], lit});
+        }
+        map[n] = byLevel.top().second;
+    }
+    newOutput = map[Aig::nodeOf(output)] ^ (output & 1);
+    return compactAig(out, newOutput, newOutput);
+}
+
+/**
+ * \struct AigRewriter
+ * \brief DAG-aware rewriting of an AIG with 4-input cuts and an NPN implementation library.
+ *
+ * A pass enumerates up to \ref MAX_CUTS cuts of at most four leaves per node, with their 16-bit
+ * truth tables, and rebuilds the graph in topological order. For every node and cut it weighs
+ * the nodes that would die with the node (its maximum fanout-free cone above the cut) against the
+ * nodes the library implementation of the cut function would add (gates already present in the
+ * rebuilt graph are free), and uses the best implementation if that saves nodes. Passes repeat
+ * while the graph shrinks.
+ */
+struct AigRewriter {
+    static const size_t MAX_CUTS = 8; /**< Cuts kept per node (besides the trivial one). */
+    static const int MAX_PASSES = 8;  /**< Rewriting passes at most. */
+
+    NpnLibrary library;          /**< NPN classes and their implementations. */
+    RewriteStats stats;          /**< Counters. */
+    vector<vector<AigCut>> cuts; /**< Cuts of each node; the trivial cut comes first. */
+
+    /**
+     * \brief Expresses a truth table over a subset of leaves as a table over a superset.
+     * \param truth The table over \p from.
+     * \param from Its leaves.
+     * \param to The superset (ascending).
+     * \return The table over \p to.
+     */
+    static uint16_t stretch(uint16_t truth, const AigCut& from, const AigCut& to) {
+        int position[4] = {0, 0, 0, 0};
+        for (int i = 0, j = 0; i < from.size; ++i) {
+            while (to.leaves[j] != from.leaves[i]) j++;
+            position[i] = j;
+        }
+        uint16_t out = 0;
+        for (int m = 0; m < 16; ++m) {
+            int index = 0;
+            for (int i = 0; i < from.size; ++i) index |= ((m >> position[i]) & 1) << i;
+            out |= (uint16_t)(((truth >> index) & 1) << m);
+        }
+        return out;
+    }
+
+    /**
+     * \brief Enumerates the cuts of every node in the cone of the output.
+     * \param aig The graph.
+     * \param inCone Cone membership of each node.
+     */
+    void computeCuts(const Aig& aig, const vector<char>& inCone) {
+        cuts.assign(aig.nodes.size(), {});
+        for (uint32_t n = 1; n < aig.nodes.size(); ++n) {
+            if (!inCone[n]) continue;
+            AigCut trivial{{n, 0, 0, 0}, 1, CUT_VAR_TRUTH[0]};
+            cuts[n].push_back(trivial);
+            if (!aig.isAnd(n)) continue;
+            uint32_t lit0 = aig.nodes[n].fanin0, lit1 = aig.nodes[n].fanin1;
+            vector<AigCut> found;
+            for (const AigCut& a : cuts[Aig::nodeOf(lit0)]) {
+                for (const AigCut& b : cuts[Aig::nodeOf(lit1)]) {
+                    AigCut merged;
+                    merged.size = 0;
+                    int i = 0, j = 0;
+                    bool tooLarge = false;
+                    while (i < a.size || j < b.size) {
+                        uint32_t next = (j >= b.size || (i < a.size && a.leaves[i] < b.leaves[j])) ? a.leaves[i++]
+                                      : (i >= a.size || b.leaves[j] < a.leaves[i]) ? b.leaves[j++]
+                                      : (j++, a.leaves[i++]);
+                        if (merged.size == 4) {
+                            tooLarge = true;
+                            break;
+                        }
+                        merged.leaves[merged.size++] = next;
+                    }
+                    if (tooLarge) continue;
+                    uint16_t ta = stretch(a.truth, a, merged), tb = stretch(b.truth, b, merged);
+                    if (Aig::isComplemented(lit0)) ta = (uint16_t)~ta;
+                    if (Aig::isComplemented(lit1)) tb = (uint16_t)~tb;
+                    merged.truth = ta & tb;
+                    auto subset = [](const AigCut& x, const AigCut& y) {
+                        return includes(y.leaves, y.leaves + y.size, x.leaves, x.leaves + x.size);
+                    };
+                    bool dominated = false;
+                    for (const AigCut& other : found) dominated |= subset(other, merged);
+                    if (dominated) continue;
+                    found.erase(remove_if(found.begin(), found.end(), [&](const AigCut& other) { return subset(merged, other); }),
+                                found.end());
+                    found.push_back(merged);
+                }
+            }
+            stable_sort(found.begin(), found.end(), [](const AigCut& x, const AigCut& y) { return x.size < y.size; });
+            if (found.size() > MAX_CUTS) found.resize(MAX_CUTS);
+            cuts[n].insert(cuts[n].end(), found.begin(), found.end());
+        }
+    }
+
+    /**
+     * \brief Builds an implementation in a graph.
+     * \param aig The graph.
+     * \param impl The implementation of the class representative.
+     * \param inputs Literals for the representative's inputs.
+     * \return The output literal.
+     */
+    static uint32_t instantiate(Aig& aig, const NpnImplementation& impl, const uint32_t inputs[4]) {
+        vector<uint32_t> lits(5 + impl.gates.size());
+        lits[0] = Aig::FALSE_LIT;
+        for (int j = 0; j < 4; ++j) lits[j + 1] = inputs[j];
+        auto map = [&](uint8_t local) { return lits[local >> 1] ^ (local & 1); };
+        for (size_t g = 0; g < impl.gates.size(); ++g) lits[5 + g] = aig.andLit(map(impl.gates[g].first), map(impl.gates[g].second));
+        return map(impl.output);
+    }
+
+    /**
+     * \brief One rewriting pass.
+     * \param in The graph.
+     * \param output Its output literal.
+     * \param newOutput Receives the output literal of the result.
+     * \return The rewritten graph (only the output cone).
+     */
+    Aig rewritePass(const Aig& in, uint32_t output, uint32_t& newOutput) {
+        vector<char> inCone = in.cone(output);
+        computeCuts(in, inCone);
+        vector<int> refs = in.fanouts(output);
+        Aig out;
+        for (const auto& name : in.inputNames) out.input(name);
+        vector<uint32_t> map(in.nodes.size(), uint32_t(Aig::FALSE_LIT));
+        for (size_t i = 0; i < in.inputs.size(); ++i) map[in.inputs[i]] = 2 * out.inputs[i];
+        auto mapLit = [&](uint32_t lit) { return map[Aig::nodeOf(lit)] ^ (lit & 1); };
+        vector<uint32_t> stack, mffc, decremented, mffcNew, trial;
+        for (uint32_t n = 1; n < in.nodes.size(); ++n) {
+            if (!inCone[n] || !in.isAnd(n)) continue;
+            int bestGain = 0;
+            const AigCut* bestCut = nullptr;
+            for (size_t c = 1; c < cuts[n].size(); ++c) {
+                const AigCut& cut = cuts[n][c];
+                stats.cuts++;
+                // Maximum fanout-free cone of n above the cut
+                auto isLeaf = [&](uint32_t m) { return find(cut.leaves, cut.leaves + cut.size, m) != cut.leaves + cut.size; };
+                mffc.clear();
+                decremented.clear();
+                stack.assign(1, n);
+                while (!stack.empty()) {
+                    uint32_t m = stack.back();
+                    stack.pop_back();
+                    mffc.push_back(m);
+                    for (uint32_t lit : {in.nodes[m].fanin0, in.nodes[m].fanin1}) {
+                        uint32_t k = Aig::nodeOf(lit);
+                        if (!in.isAnd(k) || isLeaf(k)) continue;
+                        decremented.push_back(k);
+                        if (--refs[k] == 0) stack.push_back(k);
+                    }
+                }
+                for (uint32_t k : decremented) refs[k]++;
+                int saved = (int)mffc.size();
+                if (saved <= bestGain) continue;
+                mffcNew.clear();
+                for (size_t i = 1; i < mffc.size(); ++i) mffcNew.push_back(Aig::nodeOf(map[mffc[i]]));
+
+                // Cost of the implementation: gates not already in the rebuilt graph, plus gates
+                // that exist only inside the cone about to die
+                const NpnTransform& t = library.transform(cut.truth);
+                const NpnImplementation& impl = library.implementation(t.canonical);
+                trial.assign(5 + impl.gates.size(), uint32_t(Aig::FALSE_LIT));
+                for (int j = 0; j < 4; ++j) {
+                    trial[j + 1] = t.perm[j] < cut.size ? map[cut.leaves[t.perm[j]]] ^ ((t.negations >> j) & 1) : Aig::FALSE_LIT;
+                }
+                int cost = 0;
+                for (size_t g = 0; g < impl.gates.size() && cost < saved - bestGain; ++g) {
+                    uint32_t a = trial[impl.gates[g].first >> 1], b = trial[impl.gates[g].second >> 1];
+                    uint32_t lit = UINT32_MAX;
+                    if (a != UINT32_MAX && b != UINT32_MAX) lit = out.lookupAnd(a ^ (impl.gates[g].first & 1), b ^ (impl.gates[g].second & 1));
+                    if (lit == UINT32_MAX || find(mffcNew.begin(), mffcNew.end(), Aig::nodeOf(lit)) != mffcNew.end()) cost++;
+                    trial[5 + g] = lit;
+                }
+                if (saved - cost > bestGain) {
+                    bestGain = saved - cost;
+                    bestCut = &cut;
+                }
+            }
+            if (!bestCut) {
+                map[n] = out.andLit(mapLit(in.nodes[n].fanin0), mapLit(in.nodes[n].fanin1));
+                continue;
+            }
+            const NpnTransform& t = library.transform(bestCut->truth);
+            uint32_t inputs[4];
+            for (int j = 0; j < 4; ++j) {
+                inputs[j] = t.perm[j] < bestCut->size ? map[bestCut->leaves[t.perm[j]]] ^ ((t.negations >> j) & 1) : Aig::FALSE_LIT;
+            }
+            map[n] = instantiate(out, library.implementation(t.canonical), inputs) ^ (uint32_t)t.outputNegated;
+            stats.replacements++;
+        }
+        newOutput = mapLit(output);
+        return compactAig(out, newOutput, newOutput);
+    }
+
+    /**
+     * \brief Balances, rewrites until no pass saves nodes, and balances again.
+     * \param in The graph.
+     * \param output Its output literal.
+     * \param newOutput Receives the output literal of the result.
+     * \return The optimized graph; never larger than the output cone of \p in.
+     */
+    Aig optimize(const Aig& in, uint32_t output, uint32_t& newOutput) {
+        auto start = chrono::steady_clock::now();
+        Aig current = compactAig(in, output, newOutput);
+        current.measure(newOutput);
+        stats.andsBefore = current.stats.ands;
+        stats.levelsBefore = current.stats.levels;
+        auto keepIfSmaller = [&](Aig next, uint32_t nextOutput, bool allowEqual) {
+            next.measure(nextOutput);
+            if (next.stats.ands < current.stats.ands || (allowEqual && next.stats.ands == current.stats.ands)) {
+                current = std::move(next);
+                newOutput = nextOutput;
+                return true;
+            }
+            return false;
+        };
+        uint32_t nextOutput;
+        Aig balanced = balanceAig(current, newOutput, nextOutput);
+        keepIfSmaller(std::move(balanced), nextOutput, true);
+        for (int pass = 0; pass < MAX_PASSES; ++pass) {
+            Aig rewritten = rewritePass(current, newOutput, nextOutput);
+            if (!keepIfSmaller(std::move(rewritten), nextOutput, false)) break;
+            stats.passes++;
+        }
+        balanced = balanceAig(current, newOutput, nextOutput);
+        keepIfSmaller(std::move(balanced), nextOutput, true);
+        current.measure(newOutput);
+        stats.andsAfter = current.stats.ands;
+        stats.levelsAfter = current.stats.levels;
+        stats.classes = library.implementations.size();
+        stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return current;
+    }
+};
+
+/**
+ * \brief Writes the function of an AIG literal as an infix formula (the DAG is expanded).
+ *
+ * Complemented ANDs are printed as disjunctions of the complemented fanins; the constants are
+ * printed as 1 and 0.
+ * \param aig The graph.
+ * \param lit The literal.
+ * \param maxNodes Largest expanded size to print.
+ * \return The formula, or an empty string if it would exceed \p maxNodes operators and atoms.
+ */
+string aigToInfix(const Aig& aig, uint32_t lit, size_t maxNodes = 500) {
+    if (Aig::nodeOf(lit) == 0) return lit == Aig::TRUE_LIT ? "1" : "0"; // constants the parser accepts
+    vector<char> inCone = aig.cone(lit);
+    vector<size_t> size(aig.nodes.size(), 1);
+    for (uint32_t n = 1; n < aig.nodes.size(); ++n) {
+        if (inCone[n] && aig.isAnd(n)) size[n] = min(maxNodes + 1, 3 + size[Aig::nodeOf(aig.nodes[n].fanin0)] + size[Aig::nodeOf(aig.nodes[n].fanin1)]);
+    }
+    if (size[Aig::nodeOf(lit)] > maxNodes) return "";
+    function<string(uint32_t)> print = [&](uint32_t l) -> string {
+        uint32_t n = Aig::nodeOf(l);
+        if (!aig.isAnd(n)) return (Aig::isComplemented(l) ? "~" : "") + aig.inputNames[aig.nodes[n].input];
+        if (Aig::isComplemented(l)) return "(" + print(aig.nodes[n].fanin0 ^ 1) + " + " + print(aig.nodes[n].fanin1 ^ 1) + ")";
+        return "(" + print(aig.nodes[n].fanin0) + " * " + print(aig.nodes[n].fanin1) + ")";
+    };
+    return print(lit);
+}
+
+/**
+ * \brief Prints the counters of an AIG optimization.
+ * \param stats The counters.
+ */
+void printRewriteStats(const RewriteStats& stats) {
+    cout << "AND nodes: " << stats.andsBefore << " -> " << stats.andsAfter << ", levels: " << stats.levelsBefore
+         << " -> " << stats.levelsAfter << endl;
+    cout << "Rewriting: " << stats.passes << " improving passes, " << stats.cuts << " cuts evaluated, "
+         << stats.replacements << " subgraphs replaced, " << stats.classes << " NPN classes used, " << stats.ms
+         << " ms" << endl;
+}
+
+/* ---------------- END AIG Rewriting ---------------- */
+
+/* ---------------- TWO-LEVEL MINIMIZATION ---------------- */
+
+/**
+ * \struct CubeCover
+ * \brief A list of cubes in positional notation, bit-packed 32 variables per 64-bit word.
+ *
+ * Variable v occupies bits 2(v mod 32) ("may be 0") and 2(v mod 32) + 1 ("may be 1") of word
+ * v / 32: 01 is the literal ~v, 10 is v, 11 means v does not occur and 00 makes the cube empty.
+ * Intersection is then a word-wise AND and containment a word-wise AND-NOT. Padding pairs in the
+ * last word are always 11.
+ */
+struct CubeCover {
+    static const uint64_t LOW_BITS = 0x5555555555555555ull; /**< The "may be 0" bit of every pair. */
+
+    int numVars = 0;       /**< Variables. */
+    int words = 0;         /**< Words per cube. */
+    vector<uint64_t> bits; /**< Cube i occupies bits[i * words .. (i + 1) * words). */
+
+    /** \brief Creates an empty cover over \p numVars variables. */
+    explicit CubeCover(int numVars = 0) : numVars(numVars), words(max(1, (numVars + 31) / 32)) {}
+
+    /** \brief Number of cubes. */
+    size_t size() const { return bits.size() / words; }
+    /** \brief Words of cube \p i. */
+    uint64_t* cube(size_t i) { return &bits[i * words]; }
+    /** \brief Words of cube \p i. */
+    const uint64_t* cube(size_t i) const { return &bits[i * words]; }
+    /** \brief Appends a copy of a cube. */
+    void add(const uint64_t* c) { bits.insert(bits.end(), c, c + words); }
+    /** \brief Appends the universal cube and returns it. */
+    uint64_t* addUniversal() {
+        bits.resize(bits.size() + words, ~0ull);
+        return cube(size() - 1);
+    }
+
+    /** \brief Value pair of variable \p v in a cube (1 = ~v, 2 = v, 3 = absent). */
+    static int pair(const uint64_t* c, int v) { return (c[v / 32] >> (2 * (v % 32))) & 3; }
+    /** \brief Sets the value pair of variable \p v in a cube. */
+    static void setPair(uint64_t* c, int v, int value) {
+        c[v / 32] = (c[v / 32] & ~(3ull << (2 * (v % 32)))) | ((uint64_t)value << (2 * (v % 32)));
+    }
+
+    /** \brief Returns true if some variable of a cube allows no value. */
+    bool isEmpty(const uint64_t* c) const {
+        for (int w = 0; w < words; ++w) {
+            if (((c[w] | (c[w] >> 1)) & LOW_BITS) != LOW_BITS) return true;
+        }
+        return false;
+    }
+
+    /** \brief Returns true if two cubes share a minterm. */
+    bool intersects(const uint64_t* a, const uint64_t* b) const {
+        for (int w = 0; w < words; ++w) {
+            uint64_t x = a[w] & b[w];
+            if (((x | (x >> 1)) & LOW_BITS) != LOW_BITS) return false;
+        }
+        return true;
+    }
+
+    /** \brief Returns true if cube \p a contains cube \p b. */
+    bool contains(const uint64_t* a, const uint64_t* b) const {
+        for (int w = 0; w < words; ++w) {
+            if (b[w] & ~a[w]) return false;
+        }
+        return true;
+    }
+
+    /** \brief Number of literals of a cube. */
+    int literals(const uint64_t* c) const {
+        int count = 0;
+        for (int w = 0; w < words; ++w) count += __builtin_popcountll(~(c[w] & (c[w] >> 1)) & LOW_BITS);
+        return count;
+    }
+
+    /** \brief Returns true if a cube has no literals. */
+    bool isUniversal(const uint64_t* c) const {
+        for (int w = 0; w < words; ++w) {
+            if (c[w] != ~0ull) return false;
+        }
+        return true;
+    }
+
+    /** \brief Total number of literals. */
+    size_t totalLiterals() const {
+        size_t count = 0;
+        for (size_t i = 0; i < size(); ++i) count += literals(cube(i));
+        return count;
+    }
+
+    /**
+     * \brief Cofactor with respect to a cube: the cubes meeting \p c, with the variables fixed by
+     * \p c removed.
+     */
+    CubeCover cofactor(const uint64_t* c) const {
+        CubeCover out(numVars);
+        for (size_t i = 0; i < size(); ++i) {
+            if (!intersects(cube(i), c)) continue;
+            uint64_t* d = out.addUniversal();
+            for (int w = 0; w < words; ++w) d[w] = cube(i)[w] | ~c[w];
+        }
+        return out;
+    }
+
+    /** \brief Cofactor with respect to the literal v = \p value. */
+    CubeCover cofactor(int v, bool value) const {
+        vector<uint64_t> literal(words, ~0ull);
+        setPair(literal.data(), v, value ? 2 : 1);
+        return cofactor(literal.data());
+    }
+
+    /**
+     * \brief The variable occurring in both polarities in most cubes (-1 if the cover is unate).
+     * \param fallback Receives the most frequent variable of a unate cover (-1 if none occurs).
+     */
+    int mostBinate(int& fallback) const {
+        vector<int> positive(numVars, 0), negative(numVars, 0);
+        for (size_t i = 0; i < size(); ++i) {
+            for (int v = 0; v < numVars; ++v) {
+                int p = pair(cube(i), v);
+                positive[v] += p == 2;
+                negative[v] += p == 1;
+            }
+        }
+        int best = -1;
+        fallback = -1;
+        for (int v = 0; v < numVars; ++v) {
+            if (positive[v] && negative[v] && (best < 0 || positive[v] + negative[v] > positive[best] + negative[best])) best = v;
+            if (positive[v] + negative[v] && (fallback < 0 || positive[v] + negative[v] > positive[fallback] + negative[fallback]))
+                fallback = v;
+        }
+        return best;
+    }
+};
+
+/**
+ * \struct TwoLevelStats
+ * \brief Outcome of a two-level minimization.
+ */
+struct TwoLevelStats {
+    string method;                          /**< "espresso" or "exact". */
+    size_t cubesBefore = 0, literalsBefore = 0; /**< Size of the input cover. */
+    size_t cubesAfter = 0, literalsAfter = 0;   /**< Size of the result. */
+    size_t blockingCubes = 0;               /**< Cubes of the complement used to check expansions. */
+    size_t primes = 0;                      /**< Prime implicants (exact only). */
+    int iterations = 0;                     /**< Reduce-expand-irredundant rounds (espresso only). */
+    bool proven = false;                    /**< Exact only: the cover is proven minimum. */
+    bool aborted = false;                   /**< The off-set exceeded its size limit; one pass ran without it. */
+    double ms = 0;                          /**< Minimization time. */
+};
+
+/**
+ * \struct Espresso
+ * \brief Heuristic two-level minimization in the style of Espresso-II.
+ *
+ * The on-set cover F is minimized against a cover R of the off-set (its complement):
+ * - expand raises literals of each cube while it stays disjoint from R, most useful raise
+ *   first, and drops the cubes it then contains (every cube becomes prime);
+ * - irredundant drops cubes covered by the rest (a cofactor tautology check);
+ * - reduce shrinks each cube to the smallest cube still covering what only it covers, so the
+ *   next expand can move it in a different direction.
+ * Reduce, expand and irredundant repeat while the number of cubes or literals drops. Tautology and
+ * complement are recursive Shannon expansions on the most binate variable with unate leaf rules.
+ * When the off-set is too large to build (the satisfying assignments of a hard CNF), a single
+ * expand and irredundant pass checks each raise by a tautology of the cofactor of F instead.
+ */
+struct Espresso {
+    size_t maxCubes = 5000; /**< Largest complement computed before giving up. */
+    bool overflow = false;    /**< Set when a complement exceeded \ref maxCubes. */
+
+    /** \brief Returns true if a cover contains every minterm. */
+    bool tautology(const CubeCover& f) {
+        if (f.size() == 0) return false;
+        vector<uint64_t> seen(f.words, 0);
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (f.isUniversal(f.cube(i))) return true;
+            for (int w = 0; w < f.words; ++w) seen[w] |= ~f.cube(i)[w];
+        }
+        // Unate reduction: a cube with a literal of a unate variable misses the whole opposite
+        // half, so only the cubes without such literals can cover it
+        vector<uint64_t> unate(f.words);
+        for (int w = 0; w < f.words; ++w) {
+            uint64_t both = seen[w] & (seen[w] >> 1) & CubeCover::LOW_BITS;
+            uint64_t some = (seen[w] | (seen[w] >> 1)) & CubeCover::LOW_BITS;
+            unate[w] = (some & ~both) * 3;
+        }
+        CubeCover rest(f.numVars);
+        for (size_t i = 0; i < f.size(); ++i) {
+            bool keep = true;
+            for (int w = 0; w < f.words && keep; ++w) keep = (~f.cube(i)[w] & unate[w]) == 0;
+            if (keep) rest.add(f.cube(i));
+        }
+        if (rest.size() < f.size()) return tautology(rest);
+        // A single-literal cube covers one half; only the other half remains to check
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (f.literals(f.cube(i)) != 1) continue;
+            for (int v = 0; v < f.numVars; ++v) {
+                int p = CubeCover::pair(f.cube(i), v);
+                if (p != 3) return tautology(f.cofactor(v, p == 1));
+            }
+        }
+        int fallback;
+        int v = f.mostBinate(fallback);
+        if (v < 0) return false; // a unate cover is a tautology only through a universal cube
+        return tautology(f.cofactor(v, false)) && tautology(f.cofactor(v, true));
+    }
+
+    /**
+     * \brief Complement of a cover.
+     *
+     * Cubes that the two halves of a Shannon expansion share are merged back without the
+     * splitting literal. Sets \ref overflow (and returns what it has) beyond \ref maxCubes cubes.
+     */
+    CubeCover complement(const CubeCover& f) {
+        CubeCover out(f.numVars);
+        if (overflow) return out;
+        if (f.size() == 0) {
+            out.addUniversal();
+            return out;
+        }
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (f.isUniversal(f.cube(i))) return out;
+        }
+        if (f.size() == 1) {
+            // De Morgan: one cube per literal
+            for (int v = 0; v < f.numVars; ++v) {
+                int p = CubeCover::pair(f.cube(0), v);
+                if (p == 3) continue;
+                CubeCover::setPair(out.addUniversal(), v, 3 - p);
+            }
+            return out;
+        }
+        int fallback;
+        int v = f.mostBinate(fallback);
+        if (v < 0) v = fallback;
+        CubeCover low = complement(f.cofactor(v, false)), high = complement(f.cofactor(v, true));
+        if (overflow) return out;
+        unordered_set<string> inHigh;
+        auto key = [&](const CubeCover& c, size_t i) { return string((const char*)c.cube(i), c.words * sizeof(uint64_t)); };
+        for (size_t i = 0; i < high.size(); ++i) inHigh.insert(key(high, i));
+        unordered_set<string> shared;
+        for (size_t i = 0; i < low.size(); ++i) {
+            string k = key(low, i);
+            if (inHigh.count(k)) {
+                shared.insert(k);
+                out.add(low.cube(i));
+            } else {
+                CubeCover::setPair(out.addUniversal(), v, 1);
+                uint64_t* c = out.cube(out.size() - 1);
+                for (int w = 0; w < out.words; ++w) c[w] &= low.cube(i)[w];
+            }
+        }
+        for (size_t i = 0; i < high.size(); ++i) {
+            if (shared.count(key(high, i))) continue;
+            CubeCover::setPair(out.addUniversal(), v, 2);
+            uint64_t* c = out.cube(out.size() - 1);
+            for (int w = 0; w < out.words; ++w) c[w] &= high.cube(i)[w];
+        }
+        if (out.size() > maxCubes) overflow = true;
+        return out;
+    }
+
+    /**
+     * \brief Makes every cube prime against the off-set and drops cubes that become covered.
+     * \param f The on-set cover.
+     * \param r The off-set cover, or null to check each raise by a tautology of the cofactor of \p f.
+     * \return The expanded cover.
+     */
+    CubeCover expand(const CubeCover& f, const CubeCover* r) {
+        vector<size_t> order(f.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return f.literals(f.cube(a)) < f.literals(f.cube(b)); });
+        // Literal frequencies: raising v in a cube that has v reaches the cubes that have ~v
+        vector<int> count(2 * (size_t)f.numVars, 0);
+        for (size_t i = 0; i < f.size(); ++i) {
+            for (int v = 0; v < f.numVars; ++v) {
+                int p = CubeCover::pair(f.cube(i), v);
+                if (p != 3) count[2 * v + (p == 1)]++;
+            }
+        }
+        CubeCover out(f.numVars);
+        vector<char> covered(f.size(), 0);
+        vector<uint64_t> c(f.words);
+        vector<int> conflicts(r ? r->size() : 0), candidates;
+        for (size_t i : order) {
+            if (covered[i]) continue;
+            copy(f.cube(i), f.cube(i) + f.words, c.begin());
+            for (size_t j = 0; j < conflicts.size(); ++j) {
+                conflicts[j] = 0;
+                for (int w = 0; w < f.words; ++w) {
+                    uint64_t x = c[w] & r->cube(j)[w];
+                    conflicts[j] += __builtin_popcountll(~(x | (x >> 1)) & CubeCover::LOW_BITS);
+                }
+            }
+            candidates.clear();
+            for (int v = 0; v < f.numVars; ++v) {
+                if (CubeCover::pair(c.data(), v) != 3) candidates.push_back(v);
+            }
+            stable_sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+                int pa = CubeCover::pair(c.data(), a), pb = CubeCover::pair(c.data(), b);
+                return count[2 * a + (pa == 2)] > count[2 * b + (pb == 2)];
+            });
+            for (int v : candidates) {
+                int p = CubeCover::pair(c.data(), v);
+                if (!r) {
+                    CubeCover::setPair(c.data(), v, 3);
+                    if (!tautology(f.cofactor(c.data()))) CubeCover::setPair(c.data(), v, p);
+                    continue;
+                }
+                // Raising v is allowed unless some off-set cube conflicts with the cube only in v
+                bool blocked = false;
+                for (size_t j = 0; j < r->size() && !blocked; ++j) {
+                    blocked = conflicts[j] == 1 && (CubeCover::pair(r->cube(j), v) & p) == 0;
+                }
+                if (blocked) continue;
+                CubeCover::setPair(c.data(), v, 3);
+                for (size_t j = 0; j < r->size(); ++j) {
+                    if ((CubeCover::pair(r->cube(j), v) & p) == 0) conflicts[j]--;
+                }
+            }
+            for (size_t j = 0; j < f.size(); ++j) {
+                if (!covered[j] && f.contains(c.data(), f.cube(j))) covered[j] = 1;
+            }
+            out.add(c.data());
+        }
+        return out;
+    }
+
+    /**
+     * \brief Drops cubes covered by the remaining ones, smallest cubes first.
+     * \param f The cover.
+     * \return An irredundant cover of the same function.
+     */
+    CubeCover irredundant(const CubeCover& f) {
+        vector<size_t> order(f.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return f.literals(f.cube(a)) > f.literals(f.cube(b)); });
+        vector<char> removed(f.size(), 0);
+        for (size_t i : order) {
+            CubeCover rest(f.numVars);
+            for (size_t j = 0; j < f.size(); ++j) {
+                if (j != i && !removed[j]) rest.add(f.cube(j));
+            }
+            if (tautology(rest.cofactor(f.cube(i)))) removed[i] = 1;
+        }
+        CubeCover out(f.numVars);
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (!removed[i]) out.add(f.cube(i));
+        }
+        return out;
+    }
+
+    /**
+     * \brief Shrinks every cube, largest first, to the supercube of the minterms only it covers.
+     * \param f The cover.
+     * \return The reduced cover (cubes that cover nothing alone are dropped).
+     */
+    CubeCover reduce(const CubeCover& f) {
+        vector<size_t> order(f.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return f.literals(f.cube(a)) < f.literals(f.cube(b)); });
+        CubeCover current = f;
+        vector<char> removed(f.size(), 0);
+        for (size_t i : order) {
+            CubeCover rest(f.numVars);
+            for (size_t j = 0; j < f.size(); ++j) {
+                if (j != i && !removed[j]) rest.add(current.cube(j));
+            }
+            CubeCover alone = complement(rest.cofactor(current.cube(i)));
+            if (overflow) {
+                overflow = false; // keep this cube as it is
+                continue;
+            }
+            if (alone.size() == 0) {
+                removed[i] = 1;
+                continue;
+            }
+            vector<uint64_t> super(f.words, 0);
+            for (size_t k = 0; k < alone.size(); ++k) {
+                for (int w = 0; w < f.words; ++w) super[w] |= alone.cube(k)[w];
+            }
+            for (int w = 0; w < f.words; ++w) current.cube(i)[w] &= super[w];
+        }
+        CubeCover out(f.numVars);
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (!removed[i]) out.add(current.cube(i));
+        }
+        return out;
+    }
+
+    /**
+     * \brief Minimizes a cover.
+     * \param f The on-set cover.
+     * \param stats Receives the counters.
+     * \return A prime and irredundant cover of the same function.
+     */
+    CubeCover minimize(const CubeCover& f, TwoLevelStats& stats) {
+        auto start = chrono::steady_clock::now();
+        stats.method = "espresso";
+        stats.cubesBefore = f.size();
+        stats.literalsBefore = f.totalLiterals();
+        CubeCover result = f;
+        CubeCover input(f.numVars);
+        for (size_t i = 0; i < f.size(); ++i) {
+            if (!f.isEmpty(f.cube(i))) input.add(f.cube(i));
+        }
+        overflow = false;
+        CubeCover r = complement(input);
+        stats.blockingCubes = r.size();
+        if (overflow) {
+            stats.aborted = true;
+            stats.blockingCubes = 0;
+            result = irredundant(expand(input, nullptr));
+        } else {
+            CubeCover best = irredundant(expand(input, &r));
+            auto cost = [](const CubeCover& c) { return make_pair(c.size(), c.totalLiterals()); };
+            while (true) {
+                stats.iterations++;
+                CubeCover next = irredundant(expand(reduce(best), &r));
+                if (cost(next) >= cost(best)) break;
+                best = std::move(next);
+            }
+            result = std::move(best);
+        }
+        stats.cubesAfter = result.size();
+        stats.literalsAfter = result.totalLiterals();
+        stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+/** \brief Most variables \ref minimizeExact accepts (it enumerates all 2^n minterms). */
+const int QM_MAX_VARS = 12;
+
+/**
+ * \brief Exact two-level minimization by Quine-McCluskey for covers over few variables.
+ *
+ * All prime implicants are generated by merging implicants that differ in one variable; a minimum
+ * cover (fewest cubes, then fewest literals) is chosen by branch and bound over the reduced covering
+ * table, starting from the Espresso cover as the incumbent.
+ * \param f The on-set cover; at most \ref QM_MAX_VARS variables.
+ * \param stats Receives the counters; \c proven is false if the budget ran out.
+ * \param budget Branch-and-bound nodes at most.
+ * \return A minimum cover, or the best one found when the budget ran out.
+ */
+CubeCover minimizeExact(const CubeCover& f, TwoLevelStats& stats, long budget = 200000) {
+    auto start = chrono::steady_clock::now();
+    stats.method = "exact";
+    stats.cubesBefore = f.size();
+    stats.literalsBefore = f.totalLiterals();
+    int n = f.numVars;
+    uint32_t full = (1u << n) - 1;
+
+    // Minterms of the on-set
+    vector<uint32_t> minterms;
+    for (uint32_t m = 0; m <= full; ++m) {
+        for (size_t i = 0; i < f.size(); ++i) {
+            bool inside = true;
+            for (int v = 0; v < n && inside; ++v) inside = (CubeCover::pair(f.cube(i), v) >> ((m >> v) & 1)) & 1;
+            if (inside) {
+                minterms.push_back(m);
+                break;
+            }
+        }
+    }
+
+    // Prime implicants as (value, don't-care mask)
+    vector<pair<uint32_t, uint32_t>> primes;
+    unordered_set<uint64_t> level;
+    for (uint32_t m : minterms) level.insert(m);
+    while (!level.empty()) {
+        unordered_set<uint64_t> next, merged;
+        for (uint64_t key : level) {
+            uint32_t value = (uint32_t)key, mask = (uint32_t)(key >> 32);
+            for (int v = 0; v < n; ++v) {
+                uint32_t bit = 1u << v;
+                if ((mask & bit) || (value & bit)) continue;
+                uint64_t partner = ((uint64_t)mask << 32) | (value | bit);
+                if (!level.count(partner)) continue;
+                merged.insert(key);
+                merged.insert(partner);
+                next.insert(((uint64_t)(mask | bit) << 32) | value);
+            }
+        }
+        for (uint64_t key : level) {
+            if (!merged.count(key)) primes.push_back({(uint32_t)key, (uint32_t)(key >> 32)});
+        }
+        level = std::move(next);
+    }
+    stats.primes = primes.size();
+
+    // Covering table: one row per distinct set of primes covering a minterm; a row whose set
+    // contains another row's set is dropped, since covering the smaller row covers it too
+    size_t words = (primes.size() + 63) / 64;
+    vector<vector<uint64_t>> rows;
+    for (uint32_t m : minterms) {
+        vector<uint64_t> row(words, 0);
+        for (size_t p = 0; p < primes.size(); ++p) {
+            if ((m & ~primes[p].second) == primes[p].first) row[p / 64] |= 1ULL << (p % 64);
+        }
+        rows.push_back(std::move(row));
+    }
+    sort(rows.begin(), rows.end());
+    rows.erase(unique(rows.begin(), rows.end()), rows.end());
+    auto subset = [&](const vector<uint64_t>& a, const vector<uint64_t>& b) {
+        for (size_t w = 0; w < words; ++w) {
+            if (a[w] & ~b[w]) return false;
+        }
+        return true;
+    };
+    vector<char> dominated(rows.size(), 0);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        for (size_t j = 0; j < rows.size() && !dominated[i]; ++j) {
+            if (j != i && !dominated[j] && subset(rows[j], rows[i])) dominated[i] = 1;
+        }
+    }
+    vector<vector<int>> coveredBy, rowsOf(primes.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (dominated[i]) continue;
+        vector<int> ps;
+        for (size_t p = 0; p < primes.size(); ++p) {
+            if ((rows[i][p / 64] >> (p % 64)) & 1) {
+                ps.push_back((int)p);
+                rowsOf[p].push_back((int)coveredBy.size());
+            }
+        }
+        coveredBy.push_back(std::move(ps));
+    }
+
+    auto primeLiterals = [&](int p) { return n - __builtin_popcount(primes[p].second); };
+    vector<int> chosen, best;
+    size_t bestLiterals = SIZE_MAX;
+    bool haveBest = false;
+
+    // The Espresso cover consists of primes, so it seeds the incumbent: the result is never
+    // worse than the heuristic one even when the budget runs out
+    {
+        Espresso heuristic;
+        TwoLevelStats ignored;
+        CubeCover seed = heuristic.minimize(f, ignored);
+        map<pair<uint32_t, uint32_t>, int> index;
+        for (size_t p = 0; p < primes.size(); ++p) index[primes[p]] = (int)p;
+        vector<int> mapped;
+        size_t literals = 0;
+        for (size_t i = 0; i < seed.size(); ++i) {
+            uint32_t value = 0, mask = 0;
+            for (int v = 0; v < n; ++v) {
+                int pr = CubeCover::pair(seed.cube(i), v);
+                if (pr == 3) mask |= 1u << v;
+                else if (pr == 2) value |= 1u << v;
+            }
+            auto it = index.find({value, mask});
+            if (it == index.end()) break;
+            mapped.push_back(it->second);
+            literals += primeLiterals(it->second);
+        }
+        if (mapped.size() == seed.size()) {
+            best = mapped;
+            bestLiterals = literals;
+            haveBest = true;
+        }
+    }
+
+    vector<int> coverCount(coveredBy.size(), 0);
+    long nodes = 0;
+    stats.proven = true;
+    function<void(size_t)> search = [&](size_t literals) {
+        if (++nodes > budget) {
+            stats.proven = false;
+            return;
+        }
+        int pick = -1;
+        for (size_t r = 0; r < coveredBy.size(); ++r) {
+            if (coverCount[r]) continue;
+            if (pick < 0 || coveredBy[r].size() < coveredBy[pick].size()) pick = (int)r;
+        }
+        if (pick < 0) {
+            if (!haveBest || chosen.size() < best.size() || (chosen.size() == best.size() && literals < bestLiterals)) {
+                best = chosen;
+                bestLiterals = literals;
+                haveBest = true;
+            }
+            return;
+        }
+        // Lower bound: uncovered rows that pairwise share no prime need one cube each
+        vector<char> blocked(primes.size(), 0);
+        size_t bound = chosen.size();
+        for (size_t r = 0; r < coveredBy.size(); ++r) {
+            if (coverCount[r]) continue;
+            bool independent = true;
+            for (int p : coveredBy[r]) independent &= !blocked[p];
+            if (!independent) continue;
+            bound++;
+            for (int p : coveredBy[r]) blocked[p] = 1;
+        }
+        if (haveBest && bound > best.size()) return;
+        vector<int> options = coveredBy[pick];
+        sort(options.begin(), options.end(), [&](int a, int b) { return primeLiterals(a) < primeLiterals(b); });
+        for (int p : options) {
+            if (!stats.proven) return;
+            chosen.push_back(p);
+            for (int r : rowsOf[p]) coverCount[r]++;
+            if (!haveBest || chosen.size() < best.size() || (chosen.size() == best.size() && literals + primeLiterals(p) < bestLiterals))
+                search(literals + primeLiterals(p));
+            for (int r : rowsOf[p]) coverCount[r]--;
+            chosen.pop_back();
+        }
+    };
+    search(0);
+
+    CubeCover out(n);
+    for (int p : best) {
+        uint64_t* c = out.addUniversal();
+        for (int v = 0; v < n; ++v) {
+            if (!((primes[p].second >> v) & 1)) CubeCover::setPair(c, v, ((primes[p].first >> v) & 1) ? 2 : 1);
+        }
+    }
+    stats.cubesAfter = out.size();
+    stats.literalsAfter = out.totalLiterals();
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+/**
+ * \brief The off-set cover of a CNF: one cube per non-tautological clause (all its literals false).
+ * \param db The clause database.
+ * \return The cover over \c db.numVars variables.
+ */
+CubeCover offsetCover(const ClauseDB& db) {
+    CubeCover out(db.numVars);
+    for (const auto& clause : db.clauses) {
+        uint64_t* c = out.addUniversal();
+        for (int lit : clause) {
+            int v = literalVar(lit);
+            CubeCover::setPair(c, v, CubeCover::pair(c, v) & (literalIsNegated(lit) ? 2 : 1));
+        }
+        if (out.isEmpty(c)) out.bits.resize(out.bits.size() - out.words); // tautological clause
+    }
+    return out;
+}
+
+/**
+ * \brief Turns an off-set cover back into clauses (each cube is the negation of a clause).
+ * \param cover The off-set cover.
+ * \param names Atom names of the variables.
+ * \return The clause database.
+ */
+ClauseDB coverToClauses(const CubeCover& cover, const vector<string>& names) {
+    ClauseDB db;
+    db.numVars = cover.numVars;
+    db.names = names;
+    for (size_t i = 0; i < cover.size(); ++i) {
+        vector<int> clause;
+        for (int v = 0; v < cover.numVars; ++v) {
+            int p = CubeCover::pair(cover.cube(i), v);
+            if (p != 3) clause.push_back(makeLiteral(v, p == 2));
+        }
+        db.clauses.push_back(clause);
+    }
+    return db;
+}
+
+/**
+ * \brief Writes a cover as a formula: a sum of products, or (for an off-set cover) a product of
+ * sums.
+ * \param cover The cover.
+ * \param names Atom names of the variables.
+ * \param asCnf Whether \p cover is an off-set to print as clauses.
+ * \return The formula.
+ */
+string coverToString(const CubeCover& cover, const vector<string>& names, bool asCnf) {
+    if (cover.size() == 0) return asCnf ? "(TRUE)" : "(FALSE)";
+    string out;
+    for (size_t i = 0; i < cover.size(); ++i) {
+        string term;
+        for (int v = 0; v < cover.numVars; ++v) {
+            int p = CubeCover::pair(cover.cube(i), v);
+            if (p == 3) continue;
+            bool positive = asCnf ? p == 1 : p == 2;
+            term += string(term.empty() ? "" : asCnf ? " + " : " * ") + (positive ? "" : "~") + names[v];
+        }
+        if (term.empty()) term = asCnf ? "FALSE" : "TRUE";
+        out += string(i ? (asCnf ? " * " : " + ") : "") + "(" + term + ")";
+    }
+    return out;
+}
+
+/**
+ * \brief Prints the sizes before and after a two-level minimization.
+ * \param stats The counters.
+ * \param unit "clauses" or "terms".
+ */
+void printTwoLevelStats(const TwoLevelStats& stats, const string& unit) {
+    cout << "Method: " << stats.method << (stats.method == "exact" ? (stats.proven ? " (proven minimum)" : " (budget exhausted, best found)") : "")
+         << ", " << stats.ms << " ms" << endl;
+    cout << unit << ": " << stats.cubesBefore << " -> " << stats.cubesAfter << ", literals: " << stats.literalsBefore
+         << " -> " << stats.literalsAfter << endl;
+    if (stats.method == "exact") cout << "Prime implicants: " << stats.primes << endl;
+    else cout << "Complement cubes: " << stats.blockingCubes << ", improvement rounds: " << stats.iterations << endl;
+    if (stats.aborted) cout << "The off-set grew too large; a single expand/irredundant pass was run without it." << endl;
+}
+
+/* ---------------- END Two-Level Minimization ---------------- */
+
+/* ---------------- ALGEBRAIC SIMPLIFICATION ---------------- */
+
+/** \brief Operators of an \ref AlgebraicRewriter term; the constants and atoms are the leaves. */
+enum class TermOp { FALSE_CONST, TRUE_CONST, ATOM, NOT, AND, OR, IMPLIES };
+
+/** \brief Number of \ref TermOp values, the size of the rule dispatch table. */
+const int NUM_TERM_OPS = 7;
+
+/**
+ * \struct Term
+ * \brief A node of a hash-consed formula: AND and OR take any number of operands, NOT one and
+ * IMPLIES two.
+ */
+struct Term {
+    TermOp op;        /**< The operator. */
+    int atom;         /**< Atom index for \c ATOM, -1 otherwise. */
+    vector<int> args; /**< Operand terms, in formula order. */
+};
+
+/**
+ * \struct AlgebraicStats
+ * \brief Counters of one \ref simplifyFormula run.
+ */
+struct AlgebraicStats {
+    size_t nodesBefore = 0;       /**< Parse tree nodes of the input. */
+    size_t nodesAfter = 0;        /**< Parse tree nodes of the result. */
+    int depthBefore = 0;          /**< Parse tree depth of the input. */
+    int depthAfter = 0;           /**< Parse tree depth of the result. */
+    long steps = 0;               /**< Rule applications. */
+    int passes = 0;               /**< Bottom-up passes; the last one changed nothing. */
+    bool budgetExhausted = false; /**< The step budget ran out before the fixpoint. */
+    map<string, long> firings;    /**< Applications per rule name. */
+    double ms = 0;                /**< Simplification time. */
+};
+
+/**
+ * \struct AlgebraicRewriter
+ * \brief Bottom-up algebraic rewriting of formulas with constant folding.
+ *
+ * Formulas are stored as hash-consed terms, so equal subformulas share one id and rules compare
+ * operands in O(1); AND/OR chains are flattened into one n-ary term. A term is rewritten after
+ * its operands: the rules registered for its operator in \ref rules are tried in order and the
+ * replacement given by the first one that applies is rewritten in turn. Every rule makes the
+ * formula strictly smaller, so this terminates; \ref budget bounds the number of applications.
+ */
+struct AlgebraicRewriter {
+    /** \brief A rewrite rule: returns the replacement of a term, or -1 if it does not apply. */
+    struct Rule {
+        const char* name;                     /**< Name in the statistics. */
+        int (AlgebraicRewriter::*apply)(int); /**< The rule. */
+    };
+
+    static const int FALSE_TERM = 0; /**< The constant 0. */
+    static const int TRUE_TERM = 1;  /**< The constant 1. */
+
+    vector<Term> terms;                   /**< All terms; ids index this vector. */
+    unordered_map<string, int> unique;    /**< Operator and operands to term id. */
+    vector<string> atomNames;             /**< Atom names by index. */
+    unordered_map<string, int> atomIndex; /**< Atom name to index. */
+    vector<Rule> rules[NUM_TERM_OPS];     /**< Rules by operator, tried in order. */
+    vector<int> memo;                     /**< Rewritten form of each term in this pass, -1 if not known yet. */
+    long budget = 100000;                 /**< Rule applications allowed. */
+    long steps = 0;                       /**< Rule applications so far. */
+    map<string, long> firings;            /**< Applications per rule name. */
+
+    AlgebraicRewriter() {
+        make(TermOp::FALSE_CONST, -1, {});
+        make(TermOp::TRUE_CONST, -1, {});
+        rules[(int)TermOp::NOT] = {{"constant folding", &AlgebraicRewriter::notConstant},
+                                   {"double negation", &AlgebraicRewriter::doubleNegation}};
+        for (TermOp op : {TermOp::AND, TermOp::OR}) {
+            rules[(int)op] = {{"constant folding", &AlgebraicRewriter::chainConstant},
+                              {"idempotence", &AlgebraicRewriter::idempotence},
+                              {"complement", &AlgebraicRewriter::complement},
+                              {"absorption", &AlgebraicRewriter::absorption},
+                              {"negated absorption", &AlgebraicRewriter::negatedAbsorption}};
+        }
+        rules[(int)TermOp::AND].push_back({"modus ponens", &AlgebraicRewriter::modusPonens});
+        rules[(int)TermOp::OR].push_back({"factoring", &AlgebraicRewriter::factoring});
+        rules[(int)TermOp::IMPLIES] = {{"constant folding", &AlgebraicRewriter::impliesConstant},
+                                       {"reflexivity", &AlgebraicRewriter::impliesSelf},
+                                       {"implication absorption", &AlgebraicRewriter::impliesAbsorption}};
+    }
+
+    /** \brief Returns the term with the given operator and operands, creating it on first use. */
+    int make(TermOp op, int atom, const vector<int>& args) {
+        string key(1, (char)op);
+        key.append((const char*)&atom, sizeof(int));
+        key.append((const char*)args.data(), args.size() * sizeof(int));
+        auto it = unique.find(key);
+        if (it != unique.end()) return it->second;
+        int id = (int)terms.size();
+        terms.push_back({op, atom, args});
+        memo.push_back(-1);
+        unique.emplace(std::move(key), id);
+        return id;
+    }
+
+    /** \brief Returns the term of an atom. */
+    int atom(const string& name) {
+        auto it = atomIndex.find(name);
+        if (it == atomIndex.end()) {
+            it = atomIndex.emplace(name, (int)atomNames.size()).first;
+            atomNames.push_back(name);
+        }
+        return make(TermOp::ATOM, it->second, {});
+    }
+
+    /** \brief Returns ~t (not simplified). */
+    int negation(int t) { return make(TermOp::NOT, -1, {t}); }
+
+    /**
+     * \brief Returns the AND or OR of operands. Operands with the same operator are spliced in;
+     * no operand gives the neutral constant and one operand gives that operand.
+     */
+    int chain(TermOp op, const vector<int>& args) {
+        vector<int> flat;
+        for (int a : args) {
+            if (terms[a].op == op) flat.insert(flat.end(), terms[a].args.begin(), terms[a].args.end());
+            else flat.push_back(a);
+        }
+        if (flat.empty()) return identity(op);
+        if (flat.size() == 1) return flat[0];
+        return make(op, -1, flat);
+    }
+
+    /** \brief OR for AND and AND for OR. */
+    static TermOp dual(TermOp op) { return op == TermOp::AND ? TermOp::OR : TermOp::AND; }
+
+    /** \brief The constant that decides a chain: 0 for AND, 1 for OR. */
+    static int annihilator(TermOp op) {
+        if (op == TermOp::AND) return FALSE_TERM;
+        return TRUE_TERM;
+    }
+
+    /** \brief The constant a chain ignores: 1 for AND, 0 for OR. */
+    static int identity(TermOp op) {
+        if (op == TermOp::AND) return TRUE_TERM;
+        return FALSE_TERM;
+    }
+
+    /** \brief Returns true if one term is the negation of the other. */
+    bool complementary(int a, int b) const {
+        return (terms[a].op == TermOp::NOT && terms[a].args[0] == b) || (terms[b].op == TermOp::NOT && terms[b].args[0] == a);
+    }
+
+    /** \brief ~1 = 0 and ~0 = 1. */
+    int notConstant(int t) {
+        int a = terms[t].args[0];
+        if (a == TRUE_TERM) return FALSE_TERM;
+        if (a == FALSE_TERM) return TRUE_TERM;
+        return -1;
+    }
+
+    /** \brief ~~A = A. */
+    int doubleNegation(int t) {
+        int a = terms[t].args[0];
+        return terms[a].op == TermOp::NOT ? terms[a].args[0] : -1;
+    }
+
+    /** \brief A * 0 = 0 and A * 1 = A (dually A + 1 = 1 and A + 0 = A). */
+    int chainConstant(int t) {
+        TermOp op = terms[t].op;
+        vector<int> kept;
+        for (int a : terms[t].args) {
+            if (a == annihilator(op)) return annihilator(op);
+            if (a != identity(op)) kept.push_back(a);
+        }
+        return kept.size() < terms[t].args.size() ? chain(op, kept) : -1;
+    }
+
+    /** \brief A * A = A (dually A + A = A). */
+    int idempotence(int t) {
+        unordered_set<int> seen;
+        vector<int> kept;
+        for (int a : terms[t].args) {
+            if (seen.insert(a).second) kept.push_back(a);
+        }
+        return kept.size() < terms[t].args.size() ? chain(terms[t].op, kept) : -1;
+    }
+
+    /** \brief A * ~A = 0 (dually A + ~A = 1). */
+    int complement(int t) {
+        unordered_set<int> present(terms[t].args.begin(), terms[t].args.end());
+        for (int a : terms[t].args) {
+            if (terms[a].op == TermOp::NOT && present.count(terms[a].args[0])) return annihilator(terms[t].op);
+        }
+        return -1;
+    }
+
+    /** \brief A * (A + B) = A (dually A + (A * B) = A). */
+    int absorption(int t) {
+        TermOp op = terms[t].op;
+        unordered_set<int> present(terms[t].args.begin(), terms[t].args.end());
+        vector<int> kept;
+        for (int a : terms[t].args) {
+            bool absorbed = false;
+            if (terms[a].op == dual(op)) {
+                for (int b : terms[a].args) absorbed |= present.count(b) > 0;
+            }
+            if (!absorbed) kept.push_back(a);
+        }
+        return kept.size() < terms[t].args.size() ? chain(op, kept) : -1;
+    }
+
+    /** \brief A * (~A + B) = A * B (dually A + (~A * B) = A + B). */
+    int negatedAbsorption(int t) {
+        TermOp op = terms[t].op;
+        vector<int> args = terms[t].args;
+        unordered_set<int> present(args.begin(), args.end()), negated;
+        for (int a : args) {
+            if (terms[a].op == TermOp::NOT) negated.insert(terms[a].args[0]);
+        }
+        bool changed = false;
+        for (int& a : args) {
+            if (terms[a].op != dual(op)) continue;
+            vector<int> kept;
+            for (int b : terms[a].args) {
+                bool opposite = negated.count(b) || (terms[b].op == TermOp::NOT && present.count(terms[b].args[0]));
+                if (!opposite) kept.push_back(b);
+            }
+            if (kept.size() == terms[a].args.size()) continue;
+            a = chain(dual(op), kept);
+            changed = true;
+        }
+        return changed ? chain(op, args) : -1;
+    }
+
+    /** \brief A * (A > B) = A * B. */
+    int modusPonens(int t) {
+        vector<int> args = terms[t].args;
+        unordered_set<int> present(args.begin(), args.end());
+        bool changed = false;
+        for (int& a : args) {
+            if (terms[a].op == TermOp::IMPLIES && present.count(terms[a].args[0])) {
+                a = terms[a].args[1];
+                changed = true;
+            }
+        }
+        return changed ? chain(TermOp::AND, args) : -1;
+    }
+
+    /**
+     * \brief (A * B) + (A * C) = A * (B + C), for the operand shared by the most conjunctions.
+     *
+     * Only disjunctions are factored: a conjunction of clauses is already the shape that
+     * \ref convertToCNF produces, while factoring a disjunction saves distribution work there.
+     */
+    int factoring(int t) {
+        vector<int> args = terms[t].args;
+        unordered_map<int, int> frequency;
+        for (int a : args) {
+            if (terms[a].op == TermOp::AND) {
+                for (int b : terms[a].args) frequency[b]++; // operands are distinct after idempotence
+            }
+        }
+        int common = -1, best = 1;
+        for (int a : args) {
+            if (terms[a].op != TermOp::AND) continue;
+            for (int b : terms[a].args) {
+                if (frequency[b] > best) best = frequency[b], common = b;
+            }
+        }
+        if (common < 0) return -1;
+        vector<int> rests, others;
+        int position = -1;
+        for (int a : args) {
+            const vector<int>& operands = terms[a].args;
+            if (terms[a].op != TermOp::AND || find(operands.begin(), operands.end(), common) == operands.end()) {
+                others.push_back(a);
+                continue;
+            }
+            if (position < 0) position = (int)others.size();
+            vector<int> rest;
+            for (int b : operands) {
+                if (b != common) rest.push_back(b);
+            }
+            rests.push_back(chain(TermOp::AND, rest));
+        }
+        int factored = chain(TermOp::AND, {common, chain(TermOp::OR, rests)});
+        others.insert(others.begin() + position, factored);
+        return chain(TermOp::OR, others);
+    }
+
+    /** \brief 0 > B = 1, A > 1 = 1, 1 > B = B and A > 0 = ~A. */
+    int impliesConstant(int t) {
+        int a = terms[t].args[0], b = terms[t].args[1];
+        if (a == FALSE_TERM || b == TRUE_TERM) return TRUE_TERM;
+        if (a == TRUE_TERM) return b;
+        if (b == FALSE_TERM) return negation(a);
+        return -1;
+    }
+
+    /** \brief A > A = 1, A > ~A = ~A and ~A > A = A. */
+    int impliesSelf(int t) {
+        int a = terms[t].args[0], b = terms[t].args[1];
+        if (a == b) return TRUE_TERM;
+        return complementary(a, b) ? b : -1;
+    }
+
+    /** \brief A > (A + B) = 1 and (A * B) > A = 1. */
+    int impliesAbsorption(int t) {
+        int a = terms[t].args[0], b = terms[t].args[1];
+        const vector<int>& left = terms[a].args;
+        const vector<int>& right = terms[b].args;
+        if (terms[b].op == TermOp::OR && find(right.begin(), right.end(), a) != right.end()) return TRUE_TERM;
+        if (terms[a].op == TermOp::AND && find(left.begin(), left.end(), b) != left.end()) return TRUE_TERM;
+        return -1;
+    }
+
+    /**
+     * \brief Converts a parse tree into a term.
+     *
+     * Iterative post-order traversal, so deep trees do not exhaust the call stack.
+     * \param root Root of the parse tree.
+     * \param known Atoms with a known value, which become constants (none if null).
+     * \return The term.
+     */
+    int fromTree(Node* root, const unordered_map<string, bool>* known = nullptr) {
+        unordered_map<Node*, int> termOf;
+        vector<pair<Node*, bool>> stack{{root, false}};
+        vector<Node*> children;
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+            if (!node->left && !node->right) {
+                if (isConstant(node->value)) termOf[node] = node->value == "1" ? int(TRUE_TERM) : int(FALSE_TERM);
+                else if (known && known->count(node->value)) termOf[node] = known->at(node->value) ? int(TRUE_TERM) : int(FALSE_TERM);
+                else termOf[node] = atom(node->value);
+                continue;
+            }
+            TseitinEncoder::operands(node, children);
+            if (!expanded) {
+                stack.push_back({node, true});
+                for (auto it = children.rbegin(); it != children.rend(); ++it) stack.push_back({*it, false});
+                continue;
+            }
+            vector<int> args;
+            for (Node* child : children) args.push_back(termOf[child]);
+            if (node->value == "~") termOf[node] = negation(args[0]);
+            else if (node->value == ">") termOf[node] = make(TermOp::IMPLIES, -1, args);
+            else termOf[node] = chain(node->value == "*" ? TermOp::AND : TermOp::OR, args);
+        }
+        return termOf[root];
+    }
+
+    /**
+     * \brief Applies rules at the root of a term whose operands are already rewritten.
+     *
+     * After a rule fires, the operands of the replacement are rewritten (they may be new terms)
+     * and the rules are tried again on it.
+     * \param t The term.
+     * \return The rewritten term.
+     */
+    int rewriteRoot(int t) {
+        while (true) {
+            int next = -1;
+            for (const Rule& rule : rules[(int)terms[t].op]) {
+                if (steps >= budget) return t;
+                next = (this->*rule.apply)(t);
+                if (next < 0) continue;
+                steps++;
+                firings[rule.name]++;
+                break;
+            }
+            if (next < 0) return t;
+            if (memo[next] >= 0) return memo[next];
+            Term replacement = terms[next];
+            for (int& a : replacement.args) a = simplify(a);
+            bool isChain = replacement.op == TermOp::AND || replacement.op == TermOp::OR;
+            t = isChain ? chain(replacement.op, replacement.args) : make(replacement.op, replacement.atom, replacement.args);
+            if (memo[t] >= 0) return memo[t];
+        }
+    }
+
+    /**
+     * \brief Rewrites a term bottom-up, memoizing the result of every term for this pass.
+     * \param root The term.
+     * \return The rewritten term.
+     */
+    int simplify(int root) {
+        vector<pair<int, bool>> stack{{root, false}};
+        while (!stack.empty()) {
+            auto [t, expanded] = stack.back();
+            stack.pop_back();
+            if (memo[t] >= 0) continue;
+            if (!expanded) {
+                stack.push_back({t, true});
+                for (int a : terms[t].args) {
+                    if (memo[a] < 0) stack.push_back({a, false});
+                }
+                continue;
+            }
+            Term rebuilt = terms[t];
+            for (int& a : rebuilt.args) a = memo[a];
+            bool isChain = rebuilt.op == TermOp::AND || rebuilt.op == TermOp::OR;
+            int u = isChain ? chain(rebuilt.op, rebuilt.args) : make(rebuilt.op, rebuilt.atom, rebuilt.args);
+            if (memo[u] < 0) memo[u] = rewriteRoot(u);
+            memo[t] = memo[u];
+            memo[memo[t]] = memo[t];
+        }
+        return memo[root];
+    }
+
+    /**
+     * \brief Rewrites a term to a fixpoint: bottom-up passes until one changes nothing or the
+     * budget runs out.
+     * \param root The term.
+     * \param passes Receives the number of passes.
+     * \return The rewritten term.
+     */
+    int run(int root, int& passes) {
+        passes = 0;
+        while (true) {
+            passes++;
+            fill(memo.begin(), memo.end(), -1);
+            int next = simplify(root);
+            if (next == root || steps >= budget) return next;
+            root = next;
+        }
+    }
+
+    /** \brief Builds a parse tree of a term; AND/OR chains become left-leaning binary nodes. */
+    Node* toTree(int t) const {
+        const Term& term = terms[t];
+        switch (term.op) {
+        case TermOp::FALSE_CONST: return new Node("0");
+        case TermOp::TRUE_CONST: return new Node("1");
+        case TermOp::ATOM: return new Node(atomNames[term.atom]);
+        case TermOp::NOT: return new Node("~", toTree(term.args[0]), nullptr);
+        case TermOp::IMPLIES: return new Node(">", toTree(term.args[0]), toTree(term.args[1]));
+        default: break;
+        }
+        string op = term.op == TermOp::AND ? "*" : "+";
+        Node* node = toTree(term.args[0]);
+        for (size_t i = 1; i < term.args.size(); ++i) node = new Node(op, node, toTree(term.args[i]));
+        return node;
+    }
+};
+
+/**
+ * \brief Simplifies a formula by algebraic rewriting with constant folding.
+ * \param root The parse tree; it is not modified.
+ * \param stats Receives the counters.
+ * \param budget Rule applications at most.
+ * \param known Atoms replaced by their values before rewriting (none if null).
+ * \return The simplified parse tree, or \p root itself if nothing was replaced and no rule applied.
+ */
+Node* simplifyFormula(Node* root, AlgebraicStats& stats, long budget = 100000,
+                      const unordered_map<string, bool>* known = nullptr) {
+    auto start = chrono::steady_clock::now();
+    stats = AlgebraicStats();
+    measureTree(root, stats.nodesBefore, stats.depthBefore);
+    AlgebraicRewriter rewriter;
+    rewriter.budget = budget;
+    int term = rewriter.run(rewriter.fromTree(root, known), stats.passes);
+    stats.steps = rewriter.steps;
+    stats.firings = rewriter.firings;
+    stats.budgetExhausted = rewriter.steps >= budget;
+    Node* result = stats.steps > 0 || known ? rewriter.toTree(term) : root;
+    measureTree(result, stats.nodesAfter, stats.depthAfter);
+    stats.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/**
+ * \brief Prints the size reduction and the rule applications of a simplification.
+ * \param stats The counters.
+ */
+void printAlgebraicStats(const AlgebraicStats& stats) {
+    cout << "Parse tree nodes: " << stats.nodesBefore << " -> " << stats.nodesAfter;
+    if (stats.nodesBefore > 0) cout << " (" << 100.0 * ((double)stats.nodesBefore - stats.nodesAfter) / stats.nodesBefore << "% smaller)";
+    cout << ", depth: " << stats.depthBefore << " -> " << stats.depthAfter << endl;
+    cout << "Rule applications: " << stats.steps << " in " << stats.passes << " passes, " << stats.ms << " ms"
+         << (stats.budgetExhausted ? " (step budget exhausted)" : "") << endl;
+    for (const auto& [name, count] : stats.firings) cout << "  " << name << ": " << count << endl;
+}
+
+/* ---------------- END Algebraic Simplification ---------------- */
+
+/* ---------------- PARTIAL EVALUATION ---------------- */
+
+/** \brief A truth value of Kleene's strong three-valued logic. */
+enum class KleeneValue { FALSE_VALUE, TRUE_VALUE, UNKNOWN };
+
+/** \brief Returns "FALSE", "TRUE" or "UNKNOWN". */
+string kleeneName(KleeneValue value) {
+    if (value == KleeneValue::TRUE_VALUE) return "TRUE";
+    if (value == KleeneValue::FALSE_VALUE) return "FALSE";
+    return "UNKNOWN";
+}
+
+/**
+ * \brief Evaluates a formula under a partial assignment in Kleene's strong three-valued logic.
+ *
+ * An unassigned atom is UNKNOWN; A * B is FALSE as soon as one side is FALSE and A + B is TRUE
+ * as soon as one side is TRUE, so the other side is not evaluated. Unlike \ref evaluate, missing
+ * atoms are not an error.
+ * \param root Pointer to the root Node of the parse tree.
+ * \param values The known atoms.
+ * \return TRUE or FALSE if every completion of the assignment gives that value by these rules,
+ * UNKNOWN otherwise.
+ */
+KleeneValue evaluateKleene(Node* root, const unordered_map<string, bool>& values) {
+    if (!root->left && !root->right) {
+        if (isConstant(root->value)) return root->value == "1" ? KleeneValue::TRUE_VALUE : KleeneValue::FALSE_VALUE;
+        auto it = values.find(root->value);
+        if (it == values.end()) return KleeneValue::UNKNOWN;
+        return it->second ? KleeneValue::TRUE_VALUE : KleeneValue::FALSE_VALUE;
+    }
+    auto negate = [](KleeneValue v) {
+        if (v == KleeneValue::UNKNOWN) return v;
+        return v == KleeneValue::TRUE_VALUE ? KleeneValue::FALSE_VALUE : KleeneValue::TRUE_VALUE;
+    };
+    if (root->value == "~") return negate(evaluateKleene(root->left, values));
+
+    // AND decides on FALSE; OR and IMPLIES (~A + B) decide on TRUE
+    bool isAnd = root->value == "*";
+    KleeneValue decisive = isAnd ? KleeneValue::FALSE_VALUE : KleeneValue::TRUE_VALUE;
+    KleeneValue left = evaluateKleene(root->left, values);
+    if (root->value == ">") left = negate(left);
+    if (left == decisive) return decisive;
+    KleeneValue right = evaluateKleene(root->right, values);
+    if (right == decisive) return decisive;
+    if (left == KleeneValue::UNKNOWN || right == KleeneValue::UNKNOWN) return KleeneValue::UNKNOWN;
+    return negate(decisive);
+}
+
+/**
+ * \struct Specialization
+ * \brief A formula specialized to a partial assignment by \ref specialize.
+ */
+struct Specialization {
+    Node* residual = nullptr;                   /**< The simplified formula over the open atoms. */
+    KleeneValue value = KleeneValue::UNKNOWN;   /**< TRUE or FALSE if the residual is a constant. */
+    KleeneValue kleene = KleeneValue::UNKNOWN;  /**< Strong Kleene value of the original formula. */
+    size_t fixedAtoms = 0;                      /**< Atoms of the formula with a known value. */
+    vector<string> openAtoms;                   /**< Atoms of the residual, sorted. */
+    AlgebraicStats stats;                       /**< Size reduction and rule applications. */
+};
+
+/**
+ * \brief Specializes a formula to a partial assignment.
+ *
+ * The known atoms become constants and the formula is simplified by \ref simplifyFormula, which
+ * folds the constants and drops the branches they decide. The residual depends only on the open
+ * atoms, so completing the assignment and evaluating the residual gives the same value as
+ * evaluating the whole formula. The rewrite rules can decide cases that strong Kleene logic leaves
+ * UNKNOWN (x + ~x with x open), so \c value may be decided when \c kleene is not.
+ * \param root The parse tree; it is not modified.
+ * \param values The known atoms (atoms that do not occur are ignored).
+ * \param budget Rule applications at most.
+ * \return The residual and its value.
+ */
+Specialization specialize(Node* root, const unordered_map<string, bool>& values, long budget = 100000) {
+    Specialization out;
+    set<string> atoms;
+    collectAtoms(root, atoms);
+    for (const auto& name : atoms) out.fixedAtoms += values.count(name);
+    out.kleene = evaluateKleene(root, values);
+    out.residual = simplifyFormula(root, out.stats, budget, &values);
+    if (!out.residual->left && !out.residual->right && isConstant(out.residual->value)) {
+        out.value = out.residual->value == "1" ? KleeneValue::TRUE_VALUE : KleeneValue::FALSE_VALUE;
+    }
+    set<string> open;
+    collectAtoms(out.residual, open);
+    out.openAtoms.assign(open.begin(), open.end());
+    return out;
+}
+
+/**
+ * \brief Prints a specialization: fixed and open atoms, size reduction, values and the residual.
+ * \param spec The specialization.
+ * \param maxAtoms Open atoms listed at most.
+ */
+void printSpecialization(const Specialization& spec, size_t maxAtoms = 20) {
+    cout << "Fixed atoms: " << spec.fixedAtoms << ", open atoms: " << spec.openAtoms.size();
+    if (!spec.openAtoms.empty() && spec.openAtoms.size() <= maxAtoms) {
+        cout << " (";
+        for (size_t i = 0; i < spec.openAtoms.size(); ++i) cout << (i ? " " : "") << spec.openAtoms[i];
+        cout << ")";
+    }
+    cout << endl;
+    printAlgebraicStats(spec.stats);
+    cout << "Kleene value: " << kleeneName(spec.kleene) << endl;
+    if (spec.value != KleeneValue::UNKNOWN && spec.value != spec.kleene) cout << "Decided by simplification: " << kleeneName(spec.value) << endl;
+    cout << "Residual formula: " << toInfix(spec.residual) << endl;
+}
+
+/* ---------------- END Partial Evaluation ---------------- */
+
+/* ---------------- INCREMENTAL EVALUATION ---------------- */
+
+/**
+ * \struct IncrementalEvaluator
+ * \brief Keeps the value of every subformula up to date while atoms change one batch at a time.
+ *
+ * The formula is compiled into a DAG (equal subformulas are shared and AND/OR chains are n-ary)
+ * stored in flat arrays with child and parent links. Every node caches its value; an AND node also
+ * counts its false operands and an OR node its true ones, so an operand change costs O(1) at the
+ * parent no matter how many operands it has. An update marks the parents of the changed atoms,
+ * and a worklist bucketed by level (longest path from an atom) recomputes the marked nodes
+ * bottom-up, each at most once. A node whose value stays the same does not mark its parents, so
+ * the work is bounded by the part of the cone of the changed atoms that actually changes.
+ */
+struct IncrementalEvaluator {
+    vector<TermOp> op;                    /**< Operator of each node; operands precede their parents. */
+    vector<int> childStart, children;     /**< Operands of node n: children[childStart[n] .. childStart[n + 1]). */
+    vector<int> parentStart, parents;     /**< Parents of node n, once per occurrence as an operand. */
+    vector<int> level;                    /**< Longest path from a leaf. */
+    vector<char> value;                   /**< Cached value of each node. */
+    vector<int> count;                    /**< False operands of an AND, true operands of an OR. */
+    vector<int> atomNode;                 /**< Node of each atom. */
+    vector<string> atomNames;             /**< Atom names by index. */
+    unordered_map<string, int> atomIndex; /**< Atom name to index. */
+    int root = -1;                        /**< Node of the whole formula. */
+    long updates = 0;                     /**< Batches applied. */
+    long recomputed = 0;                  /**< Nodes recomputed by updates. */
+    long changed = 0;                     /**< Nodes whose value changed (atoms included). */
+
+    vector<vector<int>> buckets; /**< Worklist: marked nodes by level. */
+    vector<char> queued;         /**< Node is in the worklist. */
+    size_t pending = 0;          /**< Nodes in the worklist. */
+
+    /**
+     * \brief Compiles a formula; all atoms start false (see \ref reset).
+     * \param formula Root of the parse tree (not modified).
+     */
+    explicit IncrementalEvaluator(Node* formula) {
+        // Hash-consed terms are created operands first, so term ids are a topological order
+        AlgebraicRewriter dag;
+        int top = dag.fromTree(formula);
+        vector<char> reachable(top + 1, 0);
+        vector<int> stack{top};
+        reachable[top] = 1;
+        while (!stack.empty()) {
+            int t = stack.back();
+            stack.pop_back();
+            for (int a : dag.terms[t].args) {
+                if (!reachable[a]) reachable[a] = 1, stack.push_back(a);
+            }
+        }
+        vector<int> nodeOf(top + 1, -1);
+        childStart.push_back(0);
+        for (int t = 0; t <= top; ++t) {
+            if (!reachable[t]) continue;
+            const Term& term = dag.terms[t];
+            int n = (int)op.size();
+            nodeOf[t] = n;
+            op.push_back(term.op);
+            int height = 0;
+            for (int a : term.args) {
+                children.push_back(nodeOf[a]);
+                height = max(height, level[nodeOf[a]] + 1);
+            }
+            childStart.push_back((int)children.size());
+            level.push_back(height);
+            if (term.op == TermOp::ATOM) {
+                atomIndex[dag.atomNames[term.atom]] = (int)atomNames.size();
+                atomNames.push_back(dag.atomNames[term.atom]);
+                atomNode.push_back(n);
+            }
+        }
+        root = nodeOf[top];
+
+        size_t numNodes = op.size();
+        parentStart.assign(numNodes + 1, 0);
+        for (int c : children) parentStart[c + 1]++;
+        for (size_t n = 0; n < numNodes; ++n) parentStart[n + 1] += parentStart[n];
+        parents.resize(children.size());
+        vector<int> fill(parentStart.begin(), parentStart.end() - 1);
+        for (size_t n = 0; n < numNodes; ++n) {
+            for (int i = childStart[n]; i < childStart[n + 1]; ++i) parents[fill[children[i]]++] = (int)n;
+        }
+        buckets.resize(level[root] + 1);
+        queued.assign(numNodes, 0);
+        value.assign(numNodes, 0);
+        count.assign(numNodes, 0);
+        reset(unordered_map<string, bool>());
+    }
+
+    /** \brief Number of DAG nodes. */
+    size_t size() const { return op.size(); }
+
+    /** \brief Index of an atom, or -1 if it does not occur in the formula. */
+    int atom(const string& name) const {
+        auto it = atomIndex.find(name);
+        return it == atomIndex.end() ? -1 : it->second;
+    }
+
+    /** \brief Value of node \p n computed from its operands (and counter). */
+    bool compute(int n) const {
+        const int* operands = children.data() + childStart[n];
+        switch (op[n]) {
+        case TermOp::NOT: return !value[operands[0]];
+        case TermOp::AND: return count[n] == 0;
+        case TermOp::OR: return count[n] > 0;
+        case TermOp::IMPLIES: return !value[operands[0]] || value[operands[1]];
+        case TermOp::TRUE_CONST: return true;
+        default: return value[n]; // atoms and the constant 0
+        }
+    }
+
+    /**
+     * \brief Evaluates every node from scratch.
+     * \param values Atom values; atoms not listed are false.
+     * \return The value of the formula.
+     */
+    bool reset(const unordered_map<string, bool>& values) {
+        for (size_t i = 0; i < atomNames.size(); ++i) {
+            auto it = values.find(atomNames[i]);
+            value[atomNode[i]] = it != values.end() && it->second;
+        }
+        for (size_t n = 0; n < op.size(); ++n) {
+            if (op[n] == TermOp::ATOM) continue;
+            count[n] = 0;
+            for (int i = childStart[n]; i < childStart[n + 1]; ++i) {
+                bool operand = value[children[i]];
+                if ((op[n] == TermOp::AND && !operand) || (op[n] == TermOp::OR && operand)) count[n]++;
+            }
+            value[n] = compute((int)n);
+        }
+        return value[root];
+    }
+
+    /** \brief Adjusts the counters of the parents of a node whose value flipped and marks them. */
+    void notifyParents(int n) {
+        for (int i = parentStart[n]; i < parentStart[n + 1]; ++i) {
+            int p = parents[i];
+            if (op[p] == TermOp::AND) count[p] += value[n] ? -1 : 1;
+            else if (op[p] == TermOp::OR) count[p] += value[n] ? 1 : -1;
+            if (!queued[p]) {
+                queued[p] = 1;
+                buckets[level[p]].push_back(p);
+                pending++;
+            }
+        }
+    }
+
+    /**
+     * \brief Applies a batch of atom changes and brings the cached values up to date.
+     * \param changes (atom index, new value) pairs; see \ref atom.
+     * \return The new value of the formula.
+     */
+    bool update(const vector<pair<int, bool>>& changes) {
+        updates++;
+        int lowest = level[root] + 1;
+        for (const auto& [index, v] : changes) {
+            int n = atomNode[index];
+            if (value[n] == v) continue;
+            value[n] = v;
+            changed++;
+            notifyParents(n);
+            lowest = 1; // parents of atoms are on level 1 or higher
+        }
+        for (int l = lowest; pending > 0; ++l) {
+            // Nodes marked while draining this level are on higher levels
+            for (size_t i = 0; i < buckets[l].size(); ++i) {
+                int n = buckets[l][i];
+                queued[n] = 0;
+                pending--;
+                recomputed++;
+                bool v = compute(n);
+                if (v == (bool)value[n]) continue;
+                value[n] = v;
+                changed++;
+                notifyParents(n);
+            }
+            buckets[l].clear();
+        }
+        return value[root];
+    }
+
+    /** \brief Sets one atom (by name; atoms not in the formula are ignored) and returns the formula's value. */
+    bool update(const string& name, bool v) {
+        int index = atom(name);
+        if (index < 0) return value[root];
+        return update({{index, v}});
+    }
+};
+
+/**
+ * \brief Measures incremental against from-scratch evaluation on random single-atom flips.
+ *
+ * Every flip is applied to the evaluator and, for the first \p checks flips, the formula is also
+ * evaluated from scratch with \ref evaluate and the results are compared.
+ * \param formula The parse tree.
+ * \param evaluator The compiled formula, already reset to \p values.
+ * \param values The current assignment of all atoms; updated by the flips.
+ * \param flips Number of random flips.
+ * \param checks Flips also evaluated from scratch.
+ * \param seed Random seed.
+ * \return The number of disagreements (0 unless something is broken).
+ */
+int benchmarkIncremental(Node* formula, IncrementalEvaluator& evaluator, unordered_map<string, bool>& values,
+                         int flips, int checks, unsigned seed = 12345) {
+    if (evaluator.atomNames.empty()) return 0;
+    mt19937 rng(seed);
+    long recomputedBefore = evaluator.recomputed;
+    double incrementalMs = 0, scratchMs = 0;
+    int mismatches = 0;
+    for (int i = 0; i < flips; ++i) {
+        int index = (int)(rng() % evaluator.atomNames.size());
+        const string& name = evaluator.atomNames[index];
+        bool v = !values[name];
+        values[name] = v;
+        auto start = chrono::steady_clock::now();
+        bool incremental = evaluator.update({{index, v}});
+        incrementalMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (i >= checks) continue;
+        start = chrono::steady_clock::now();
+        bool scratch = evaluate(formula, values);
+        scratchMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        mismatches += incremental != scratch;
+    }
+    cout << "Random flips: " << flips << ", incremental " << 1000.0 * incrementalMs / flips << " us per flip, "
+         << (double)(evaluator.recomputed - recomputedBefore) / flips << " nodes recomputed per flip" << endl;
+    if (checks > 0) {
+        cout << "From scratch: " << 1000.0 * scratchMs / min(flips, checks) << " us per evaluation, "
+             << (mismatches ? "MISMATCHES: " + to_string(mismatches) : "all " + to_string(min(flips, checks)) + " agree") << endl;
+    }
+    return mismatches;
+}
+
+/* ---------------- END Incremental Evaluation ---------------- */
+
+
+// ---------------- MAIN ----------------
+
+/**
+ * \brief Main function to handle user interaction, execute formula processing tasks, and output results.
+ *
+ * Tasks include: Infix to Prefix conversion, Parse Tree construction, Infix output, 
+ * Tree Height calculation, Manual Evaluation, Truth Table Generation, CNF Conversion, 
+ * and CNF Validity Check. It can load an expression from user input or a DIMACS file.
+ * \return 0 upon successful execution, 1 on error.
+ */
+int main() {
+    cout << "Enter the infix logical expression (or leave blank to use CNF file): ";
+    string infix_expr;
+    getline(cin, infix_expr);
+
+    // --- Case 1: User entered a formula manually ---
+    if (!infix_expr.empty()) {
+        cout << "\n--- Using User-Entered Expression ---" << endl;
+        cout << "Expression: " << infix_expr << endl;
+    } 
+    // --- Case 2: No expression entered — load CNF file ---
+    else {
+        cout << "\nNo custom expression entered. Reading from CNF file..." << endl;
+        string formula = dimacsToFormula("unif-c500-v250-s453695930.cnf");
+        if (formula.empty()) {
+            cerr << "Error: CNF file could not be loaded. Exiting.\n";
+            return 1;
+        }
+        infix_expr = formula;
+        cout << "\n--- DIMACS Conversion ---" << endl;
+        cout << "Formula from CNF: " << formula << endl;
+    }
+
+    // --- Task 1: Infix → Prefix ---
+    vector<string> prefix_tokens = infixToPrefix(infix_expr);
+    string prefix_expr;
+    for (const string& token : prefix_tokens) prefix_expr += token + " ";
+
+    cout << "\n--- Task 1: Prefix Conversion ---" << endl;
+    cout << "Infix: " << infix_expr << endl;
+    cout << "Prefix: " << prefix_expr << endl;
+
+    // --- Task 2: Prefix → Parse Tree ---
+    Node* root = buildParseTree(prefix_tokens); 
+
+    cout << "\n--- Task 2: Parse Tree Building ---" << endl;
+    if (!root) {
+        cout << "Tree could not be built! Check the input expression." << endl;
+        return 1;
+    }
+    cout << "Parse Tree built successfully!" << endl;
+
+    // --- Task 3: Tree → Infix ---
+    string inOrder = toInfix(root);
+    cout << "\n--- Task 3: Tree to Infix Conversion ---" << endl;
+    cout << "In-order (Infix form): " << inOrder << endl;
+
+    // --- Task 4: Tree Height ---
+    int height = treeHeight(root);
+    cout << "\n--- Task 4: Tree Height ---" << endl;
+    cout << "Tree Height: " << height << endl;
+
+    // --- Task 5: Evaluation ---
+    cout << "\n--- Task 5: Formula Evaluation ---" << endl;
+    unordered_map<string, bool> assignment;
+    
+    while (true) {
+        string atom;
+        cout << "Enter atom name (e.g., x1, p, y22) or STOP to end: ";
+        cin >> atom;
+        if (atom == "STOP") break;
+
+        int val_input;
+        cout << "Enter truth value for " << atom << " (0 for FALSE, 1 for TRUE): ";
+        cin >> val_input;
+
+        if (cin.fail() || (val_input != 0 && val_input != 1)) {
+            cerr << "Invalid input. Please enter 0 or 1." << endl;
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        assignment[atom] = (val_input == 1);
+    }
+
+    set<string> formulaAtoms;
+    collectAtoms(root, formulaAtoms);
+    size_t assigned = 0;
+    for (const auto& name : formulaAtoms) assigned += assignment.count(name);
+    if (!assignment.empty() && assigned == formulaAtoms.size()) {
+        bool result = evaluate(root, assignment); 
+        cout << "\nEvaluation Result:" << endl;
+        cout << "The formula evaluates to " << (result ? "TRUE" : "FALSE") << "." << endl;
+    } else if (!assignment.empty()) {
+        // Some atoms are open: specialize instead of evaluating
+        Specialization partial = specialize(root, assignment);
+        cout << "\nEvaluation Result (partial assignment):" << endl;
+        printSpecialization(partial);
+    } else {
+        cout << "No variables assigned. Skipping evaluation." << endl;
+    }
+
+    // ---- Generate Truth Table ---
+    cout << "\n---Truth Table Generation ---" << endl;
+    cout << "Do you want to generate a full truth table for this formula? (y/n): ";
+    char choice;
+    cin >> choice;
+    if (choice == 'y' || choice == 'Y') {
+        generateTruthTable(root);
+    }
+
+    // --- Streaming CNF conversion, offered before a CNF too large for memory is built ---
+    ClauseDB db;
+    bool streamed = false;
+    uint64_t cnfBound = estimateCNFClauses(root);
+    if (cnfBound > STREAMING_CNF_CLAUSES) {
+        cout << "\nThe CNF may have up to " << cnfBound << " clauses. Stream them to a disk spill file "
+             << "instead of building the CNF in memory? (y/n): ";
+        char stream;
+        cin >> stream;
+        if (stream == 'y' || stream == 'Y') {
+            cout << "\n--- Streaming CNF Conversion ---" << endl;
+            string spillPath = makeSpillPath();
+            vector<string> names;
+            SpillFileHeader header;
+            auto start = chrono::steady_clock::now();
+            bool written = convertToCNFStreaming(copyTree(root), spillPath, names, header);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (!written) {
+                cerr << "Error: could not write the spill file " << spillPath << " (disk full?)." << endl;
+                remove(spillPath.c_str());
+                return 1;
+            }
+            cout << "Spill file: " << spillPath << endl;
+            cout << "Clauses written: " << header.numClauses << " (" << header.numLiterals << " literals) in "
+                 << ms << " ms" << endl;
+            SpillStatistics spill;
+            if (analyzeSpilledClauses(spillPath, spill)) {
+                cout << "Variables used: " << spill.usedVars << ", unit clauses: " << spill.unitClauses
+                     << ", binary clauses: " << spill.binaryClauses << ", longest clause: " << spill.maxLength << endl;
+                cout << "Tautological clauses: " << spill.tautologies << endl;
+            }
+            cout << "Load the spilled clauses into memory for further analysis? (y/n): ";
+            char load;
+            cin >> load;
+            bool loaded = (load == 'y' || load == 'Y') && loadSpilledClauses(spillPath, names, db);
+            remove(spillPath.c_str());
+            if (!loaded) return 0;
+            streamed = true;
+        }
+    }
+
+    // --- Task 6 & 7: CNF Conversion + Validity ---
+    cout << "\n--- Task 6 & 7: CNF Conversion and Clause Validity ---" << endl;
+    Node* original = copyTree(root); // convertToCNF() rewrites the tree in place
+    if (streamed) {
+        cout << "\nCNF loaded from the spill file: " << db.clauses.size() << " clauses over " << db.numVars
+             << " variables" << endl;
+    } else {
+        Node* cnfRoot = convertToCNF(root);
+        string cnfInfix = toInfix(cnfRoot);
+        cout << "\nCNF Form of Formula: " << cnfInfix << endl;
+
+        vector<vector<string>> clauses;
+        collectClauses(cnfRoot, clauses);
+        db = buildClauseDB(clauses);
+    }
+
+    int valid_count = 0, invalid_count = 0;
+    bool all_valid = analyzeCNFValidity(db, valid_count, invalid_count);
+
+    cout << "\nCNF Clause Validity Analysis:" << endl;
+    cout << "Valid (tautological) clauses: " << valid_count << endl;
+    cout << "Non-tautological clauses: " << invalid_count << endl;
+
+    if (all_valid)
+        cout << "The CNF is valid (all clauses are tautologies)." << endl;
+    else
+        cout << "The CNF is not valid (some clauses are not tautologies)." << endl;
+    printFormulaProfile(classifyClauseDB(db));
+
+    // --- Further Analysis on the integer clause database ---
+    while (true) {
+        cout << "\n--- Further Analysis ---" << endl;
+        cout << "1. Simplify clause database (duplicates, tautologies, subsumption)" << endl;
+        cout << "2. Streaming CNF conversion to a disk spill file" << endl;
+        cout << "3. Export clause database to a DIMACS file" << endl;
+        cout << "4. Load clause database from a DIMACS file" << endl;
+        cout << "5. Parallel CNF conversion (work-stealing pool)" << endl;
+        cout << "6. Solve with the CDCL SAT solver" << endl;
+        cout << "7. Local search (probSAT / WalkSAT)" << endl;
+        cout << "8. Parallel portfolio SAT solving" << endl;
+        cout << "9. Cube-and-conquer parallel solving" << endl;
+        cout << "10. Incremental queries under assumptions" << endl;
+        cout << "11. Validity check by SAT (Tseitin encoding)" << endl;
+        cout << "12. Equivalence check against another formula (miter)" << endl;
+        cout << "13. Solve with a DRAT proof and check it" << endl;
+        cout << "14. Preprocess (variable/blocked clause elimination, subsumption) and solve" << endl;
+        cout << "15. Equivalent literal substitution (SCCs of binary clauses)" << endl;
+        cout << "16. Solve with the special-case dispatcher (2-SAT / Horn-SAT / CDCL)" << endl;
+        cout << "17. Count models (#SAT with component caching)" << endl;
+        cout << "18. Build a BDD of the formula (validity, model count, restrict)" << endl;
+        cout << "19. Compare BDD variable orders (lexicographic, DFS, FORCE, sifting)" << endl;
+        cout << "20. Compile to d-DNNF (count, probability, condition, evaluate)" << endl;
+        cout << "21. Build an And-Inverter Graph (structural hashing, simulation, Tseitin export)" << endl;
+        cout << "22. Minimize the formula by AIG rewriting (4-input cuts, NPN library, balancing)" << endl;
+        cout << "23. Two-level minimization to CNF or DNF (Espresso / exact Quine-McCluskey)" << endl;
+        cout << "24. Partial evaluation (specialize to a partial assignment, Kleene value)" << endl;
+        cout << "25. Incremental evaluation (stream atom updates, dirty propagation)" << endl;
+        cout << "26. Algebraic simplification (constant folding, absorption, factoring)" << endl;
+        cout << "0. Exit" << endl;
+        cout << "Choose an option: ";
+        int option;
+        if (!(cin >> option) || option == 0) break;
+
+        if (option == 1) {
+            cout << "\n--- Clause Simplification ---" << endl;
+            printSimplifyStats(simplifyClauseDB(db));
+        } else if (option == 2) {
+            cout << "\n--- Streaming CNF Conversion ---" << endl;
+            cout << "Enter buffer size in KB: ";
+            size_t bufferKB;
+            if (!(cin >> bufferKB) || bufferKB == 0) bufferKB = DEFAULT_SPILL_BUFFER_BYTES / 1024;
+
+            string spillPath = makeSpillPath(), simplePath = makeSpillPath();
+            vector<string> names;
+            auto start = chrono::steady_clock::now();
+            SpillFileHeader header;
+            bool written = convertToCNFStreaming(copyTree(original), spillPath, names, header, bufferKB * 1024);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (!written) {
+                cerr << "Error: could not write the spill file " << spillPath << " (disk full?)." << endl;
+                remove(spillPath.c_str());
+                continue;
+            }
+            cout << "Spill file: " << spillPath << endl;
+            cout << "Clauses written: " << header.numClauses << " (" << header.numLiterals << " literals) in "
+                 << ms << " ms" << endl;
+
+            SpillStatistics spill;
+            if (analyzeSpilledClauses(spillPath, spill, bufferKB * 1024)) {
+                cout << "Variables used: " << spill.usedVars << ", unit clauses: " << spill.unitClauses
+                     << ", binary clauses: " << spill.binaryClauses << ", longest clause: " << spill.maxLength << endl;
+                cout << "Tautological clauses: " << spill.tautologies << endl;
+            }
+            SimplifyStats simplified;
+            if (simplifySpilledClauses(spillPath, simplePath, simplified, bufferKB * 1024)) {
+                cout << "Streaming simplification:" << endl;
+                printSimplifyStats(simplified);
+            }
+            remove(spillPath.c_str());
+            remove(simplePath.c_str());
+        } else if (option == 3) {
+            cout << "Enter output file name: ";
+            string filename;
+            cin >> filename;
+            auto start = chrono::steady_clock::now();
+            if (writeDimacs(db, filename)) {
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                cout << "Wrote " << db.clauses.size() << " clauses over " << db.numVars << " variables to "
+                     << filename << " in " << ms << " ms" << endl;
+            }
+        } else if (option == 4) {
+            cout << "Enter DIMACS file name: ";
+            string filename;
+            cin >> filename;
+            ClauseDB loaded;
+            auto start = chrono::steady_clock::now();
+            if (loadDimacs(filename, loaded)) {
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                db = move(loaded);
+                cout << "Loaded " << db.clauses.size() << " clauses over " << db.numVars << " variables in "
+                     << ms << " ms" << endl;
+                printFormulaProfile(classifyClauseDB(db));
+            }
+        } else if (option == 5) {
+            cout << "\n--- Parallel CNF Conversion ---" << endl;
+            cout << "Enter number of threads: ";
+            int numThreads;
+            if (!(cin >> numThreads) || numThreads < 1) numThreads = max(1u, thread::hardware_concurrency());
+            numThreads = min(numThreads, MAX_PARALLEL_CNF_THREADS);
+
+            auto start = chrono::steady_clock::now();
+            vector<NodeArena> arenas; // frees the parallel CNF at the end of this option
+            Node* parallelCnf = parallelConvertToCNF(original, numThreads, arenas);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            vector<vector<string>> parallelClauses;
+            collectClauses(parallelCnf, parallelClauses);
+            cout << "Threads: " << numThreads << ", clauses: " << parallelClauses.size() << ", time: " << ms << " ms" << endl;
+        } else if (option == 6) {
+            cout << "\n--- CDCL SAT Solver ---" << endl;
+            auto start = chrono::steady_clock::now();
+            CDCLSolver solver(db, SolverOptions());
+            SolveResult result = solver.solve();
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            printSolverStats(result, solver.stats, ms);
+            if (result == SolveResult::SAT) {
+                printModel(db, solver.model);
+                cout << "Model check: " << (modelSatisfies(db, solver.model) ? "passed" : "FAILED") << endl;
+            }
+        } else if (option == 7) {
+            cout << "\n--- Stochastic Local Search ---" << endl;
+            LocalSearchOptions slsOptions;
+            cout << "Policy (1 = probSAT, 2 = WalkSAT): ";
+            int policy;
+            if (cin >> policy && policy == 2) slsOptions.policy = LocalSearchPolicy::WALKSAT;
+            cout << "Flip budget (0 for default): ";
+            uint64_t budget;
+            if (cin >> budget && budget > 0) slsOptions.maxFlips = budget;
+
+            auto start = chrono::steady_clock::now();
+            LocalSearchSolver sls(db, slsOptions);
+            SolveResult result = sls.solve();
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "Result: " << solveResultName(result) << endl;
+            cout << "Flips: " << sls.flips << ", unsatisfied clauses left: " << sls.unsat.size() << endl;
+            cout << "Time: " << ms << " ms";
+            if (ms > 0) cout << ", flips/sec: " << (uint64_t)(sls.flips / (ms / 1000.0));
+            cout << endl;
+            if (result == SolveResult::SAT) {
+                printModel(db, sls.assignment);
+                cout << "Model check: " << (modelSatisfies(db, sls.assignment) ? "passed" : "FAILED") << endl;
+            }
+        } else if (option == 8) {
+            cout << "\n--- Parallel Portfolio ---" << endl;
+            cout << "Enter number of threads: ";
+            int numThreads;
+            if (!(cin >> numThreads) || numThreads < 1) numThreads = max(1u, thread::hardware_concurrency());
+
+            auto start = chrono::steady_clock::now();
+            PortfolioResult portfolio = solvePortfolio(db, numThreads);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "Result: " << solveResultName(portfolio.result) << " in " << ms << " ms" << endl;
+            if (portfolio.winner >= 0)
+                cout << "Winner: worker " << portfolio.winner << " (" << portfolio.configs[portfolio.winner].description << ")" << endl;
+            for (int i = 0; i < numThreads; ++i) {
+                cout << "  worker " << i << ": " << portfolio.configs[i].description << ", exported "
+                     << portfolio.exported[i] << ", imported " << portfolio.imported[i] << endl;
+            }
+            if (portfolio.result == SolveResult::SAT)
+                cout << "Model check: " << (modelSatisfies(db, portfolio.model) ? "passed" : "FAILED") << endl;
+        } else if (option == 9) {
+            cout << "\n--- Cube and Conquer ---" << endl;
+            CubeOptions cubeOptions;
+            cout << "Target number of cubes: ";
+            int target;
+            if (cin >> target && target > 0) cubeOptions.targetCubes = target;
+            cout << "Number of workers: ";
+            int workers;
+            if (!(cin >> workers) || workers < 1) workers = max(1u, thread::hardware_concurrency());
+            cout << "Solve cubes in separate processes? (y/n): ";
+            char processes = 'n';
+            cin >> processes;
+
+            CubeAndConquerResult cc = solveCubeAndConquer(db, workers, processes == 'y' || processes == 'Y', cubeOptions);
+            cout << "Result: " << solveResultName(cc.result) << endl;
+            cout << "Cubes: " << cc.cubes << " (" << cc.refuted << " branches refuted while cubing), solved: "
+                 << cc.solvedCubes << (cc.usedProcesses ? " by worker processes" : " by threads") << endl;
+            cout << "Cube time: " << cc.cubeMs << " ms, conquer time: " << cc.conquerMs << " ms" << endl;
+            if (cc.result == SolveResult::SAT)
+                cout << "Model check: " << (modelSatisfies(db, cc.model) ? "passed" : "FAILED") << endl;
+        } else if (option == 10) {
+            cout << "\n--- Incremental Queries ---" << endl;
+            cout << "One query per line: atoms to assume (e.g. \"a ~b\"), \"+ a ~c\" to add a clause, END to finish." << endl;
+            IncrementalSolver session(db);
+            string line;
+            getline(cin, line); // rest of the option line
+            double totalIncremental = 0, totalCold = 0;
+            int queries = 0;
+            while (getline(cin, line) && line != "END") {
+                bool adding = !line.empty() && line[0] == '+';
+                vector<int> lits;
+                string error;
+                if (!session.parseLiterals(adding ? line.substr(1) : line, lits, adding, error)) {
+                    cout << "Error: " << error << endl;
+                    continue;
+                }
+                if (adding) {
+                    bool consistent = session.addClause(lits);
+                    cout << "Clause added" << (consistent ? "." : "; the formula is now unsatisfiable.") << endl;
+                    continue;
+                }
+                SolveResult result = session.solve(lits);
+                double coldMs;
+                SolveResult cold = session.solveCold(lits, coldMs);
+                queries++;
+                totalIncremental += session.lastMs;
+                totalCold += coldMs;
+                cout << solveResultName(result);
+                if (result == SolveResult::UNSAT && !session.failedAssumptions().empty()) {
+                    cout << " (failed assumptions: ";
+                    printLiteralList(session.db, session.failedAssumptions());
+                    cout << ")";
+                }
+                cout << "  incremental " << session.lastMs << " ms, cold " << coldMs << " ms"
+                     << (cold != result ? "  [cold solver disagrees]" : "") << endl;
+            }
+            if (queries > 0)
+                cout << "Mean latency over " << queries << " queries: incremental " << totalIncremental / queries
+                     << " ms, cold " << totalCold / queries << " ms" << endl;
+        } else if (option == 11) {
+            cout << "\n--- SAT-Based Validity Check ---" << endl;
+            SatCheckResult check = checkValidity(original);
+            cout << "Encoding: " << check.variables << " variables, " << check.clauses << " clauses" << endl;
+            if (!check.decided) cout << "Undecided." << endl;
+            else if (check.holds) cout << "The formula is VALID." << endl;
+            else {
+                cout << "The formula is NOT valid. Counterexample:";
+                printAssignment(check.counterexample);
+            }
+            cout << "Time: " << check.ms << " ms" << endl;
+        } else if (option == 12) {
+            cout << "\n--- SAT-Based Equivalence Check ---" << endl;
+            cout << "Enter the second infix formula: ";
+            string other;
+            getline(cin >> ws, other);
+            vector<string> otherPrefix = infixToPrefix(other);
+            Node* otherRoot = buildParseTree(otherPrefix);
+            if (!otherRoot) {
+                cout << "Tree could not be built! Check the input expression." << endl;
+                continue;
+            }
+            SatCheckResult check = checkEquivalence(original, otherRoot);
+            cout << "Encoding: " << check.variables << " variables, " << check.clauses << " clauses" << endl;
+            if (!check.decided) cout << "Undecided." << endl;
+            else if (check.holds) cout << "The formulas are EQUIVALENT." << endl;
+            else {
+                cout << "The formulas are NOT equivalent. They differ under:";
+                printAssignment(check.counterexample);
+            }
+            cout << "Time: " << check.ms << " ms" << endl;
+        } else if (option == 13) {
+            cout << "\n--- DRAT Proof ---" << endl;
+            cout << "Proof file path: ";
+            string proofPath;
+            cin >> proofPath;
+            DratProofWriter writer;
+            if (!writer.open(proofPath)) {
+                cout << "Could not create " << proofPath << endl;
+                continue;
+            }
+            // Attach the proof before loading: a refutation by unit propagation is logged by addClause
+            CDCLSolver solver(db.numVars, SolverOptions());
+            solver.proof = &writer;
+            auto start = chrono::steady_clock::now();
+            for (const auto& clause : db.clauses) {
+                if (!solver.addClause(clause)) break;
+            }
+            SolveResult result = solver.solve();
+            writer.close();
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            printSolverStats(result, solver.stats, ms);
+            cout << "Proof: " << writer.additions << " additions, " << writer.deletions << " deletions, "
+                 << writer.bytes << " bytes" << endl;
+            if (result == SolveResult::UNSAT) {
+                DratCheckResult check = checkDratProof(db, proofPath, max(1u, thread::hardware_concurrency()));
+                if (check.verified) {
+                    cout << "Proof VERIFIED: " << check.coreLemmas << " of " << check.lemmas << " lemmas checked ("
+                         << check.ratLemmas << " by RAT), core uses " << check.coreOriginals << " of "
+                         << db.clauses.size() << " clauses" << endl;
+                } else {
+                    cout << "Proof REJECTED: " << check.message << endl;
+                }
+                cout << "Check time: " << check.parseMs + check.checkMs << " ms" << endl;
+            }
+        } else if (option == 14) {
+            cout << "\n--- Preprocessing ---" << endl;
+            Preprocessor pre(db);
+            pre.run();
+            ClauseDB simplified = pre.result(db);
+            printPreprocessStats(pre.stats);
+            if (pre.unsat) {
+                cout << "Preprocessing proved the formula UNSAT." << endl;
+                continue;
+            }
+
+            auto start = chrono::steady_clock::now();
+            CDCLSolver plain(db, SolverOptions());
+            SolveResult plainResult = plain.solve();
+            double plainMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            start = chrono::steady_clock::now();
+            CDCLSolver reduced(simplified, SolverOptions());
+            SolveResult reducedResult = reduced.solve();
+            double reducedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            cout << "Solve original: " << solveResultName(plainResult) << " in " << plainMs << " ms" << endl;
+            cout << "Solve preprocessed: " << solveResultName(reducedResult) << " in " << reducedMs
+                 << " ms (+" << pre.stats.ms << " ms preprocessing)" << endl;
+            if (reducedResult == SolveResult::SAT) {
+                vector<char> model = reduced.model;
+                pre.extendModel(model);
+                cout << "Reconstructed model check: " << (modelSatisfies(db, model) ? "passed" : "FAILED") << endl;
+            }
+        } else if (option == 15) {
+            cout << "\n--- Equivalent Literal Substitution ---" << endl;
+            EquivalenceReducer reducer(db);
+            reducer.run();
+            ClauseDB reduced = reducer.apply(db);
+            const EquivalenceStats& es = reducer.stats;
+            cout << "Components: " << es.components << ", substituted variables: " << es.substitutedVars << endl;
+            cout << "Variables: " << es.originalVars << " -> " << es.remainingVars << ", clauses: "
+                 << es.originalClauses << " -> " << es.remainingClauses << ", time: " << es.ms << " ms" << endl;
+            if (reducer.unsat) {
+                cout << "A literal is equivalent to its negation: the formula is UNSAT." << endl;
+                continue;
+            }
+
+            auto start = chrono::steady_clock::now();
+            CDCLSolver plain(db, SolverOptions());
+            SolveResult plainResult = plain.solve();
+            double plainMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            start = chrono::steady_clock::now();
+            CDCLSolver substituted(reduced, SolverOptions());
+            SolveResult reducedResult = substituted.solve();
+            double reducedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "Solve original: " << solveResultName(plainResult) << " in " << plainMs << " ms" << endl;
+            cout << "Solve substituted: " << solveResultName(reducedResult) << " in " << reducedMs << " ms" << endl;
+            if (reducedResult == SolveResult::SAT) {
+                vector<char> model = substituted.model;
+                reducer.extendModel(model);
+                cout << "Reconstructed model check: " << (modelSatisfies(db, model) ? "passed" : "FAILED") << endl;
+            }
+        } else if (option == 16) {
+            cout << "\n--- Special-Case Dispatch ---" << endl;
+            DispatchResult dispatched = solveWithDispatch(db);
+            printFormulaProfile(dispatched.profile);
+            cout << "Solver: " << dispatched.path << endl;
+            cout << "Result: " << solveResultName(dispatched.result) << endl;
+            cout << "Solve time: " << dispatched.ms << " ms" << endl;
+            if (dispatched.result == SolveResult::SAT) {
+                printModel(db, dispatched.model);
+                cout << "Model check: " << (modelSatisfies(db, dispatched.model) ? "passed" : "FAILED") << endl;
+            }
+        } else if (option == 17) {
+            cout << "\n--- Model Counting ---" << endl;
+            cout << "Weighted count with atom probabilities? (y/n): ";
+            char weighted;
+            cin >> weighted;
+            CountStats stats;
+            if (weighted == 'y' || weighted == 'Y') {
+                cout << "Enter \"atom probability\" pairs, END to finish (other atoms get 0.5): ";
+                vector<double> weights(2 * (size_t)db.numVars, 0.5);
+                string atom;
+                while (cin >> atom && atom != "END") {
+                    double probability;
+                    if (!(cin >> probability) || probability < 0 || probability > 1) {
+                        cin.clear();
+                        cout << "Probability must be in [0, 1]." << endl;
+                        continue;
+                    }
+                    auto it = find(db.names.begin(), db.names.end(), atom);
+                    if (it == db.names.end()) {
+                        cout << "Unknown atom " << atom << endl;
+                        continue;
+                    }
+                    int v = (int)(it - db.names.begin());
+                    weights[makeLiteral(v, false)] = probability;
+                    weights[makeLiteral(v, true)] = 1 - probability;
+                }
+                double probability = countModelsWeighted(db, weights, stats);
+                cout << "Probability that the formula holds: " << probability << endl;
+            } else {
+                BigNat models = countModels(db, stats);
+                cout << "Models over " << db.numVars << " atoms: " << models.toString() << endl;
+            }
+            printCountStats(stats);
+        } else if (option == 18) {
+            cout << "\n--- Binary Decision Diagram ---" << endl;
+            BddManager bdd;
+            auto start = chrono::steady_clock::now();
+            uint32_t f = bdd.fromTree(original);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "BDD of the formula: " << bdd.nodeCount(f) << " nodes over " << bdd.numVars()
+                 << " atoms, built in " << ms << " ms" << endl;
+            cout << "Valid: " << (f == BddManager::ONE ? "yes" : "no")
+                 << ", satisfiable: " << (f != BddManager::ZERO ? "yes" : "no") << endl;
+            cout << "Models: " << bdd.satCount(f).toString() << endl;
+            vector<pair<int, bool>> path;
+            if (bdd.anySat(f, path)) {
+                cout << "Satisfying assignment (other atoms are free):";
+                for (auto [var, value] : path) cout << " " << (value ? "" : "~") << bdd.names[var];
+                cout << endl;
+            }
+            cout << "Atoms to fix for restrict (e.g. \"a ~b\", empty to skip): ";
+            string line;
+            getline(cin, line); // rest of the option line
+            getline(cin, line);
+            stringstream fixes(line);
+            vector<pair<int, bool>> values;
+            string literal;
+            while (fixes >> literal) {
+                bool negated = literal[0] == '~';
+                string atom = negated ? literal.substr(1) : literal;
+                if (!bdd.varIndex.count(atom)) {
+                    cout << "Unknown atom " << atom << " ignored." << endl;
+                    continue;
+                }
+                values.push_back({bdd.varIndex[atom], !negated});
+            }
+            if (!values.empty()) {
+                uint32_t g = bdd.restrictVars(f, values);
+                cout << "Restricted BDD: " << bdd.nodeCount(g) << " nodes, models over all atoms: "
+                     << bdd.satCount(g).toString() << (g == BddManager::ONE ? " (valid)" : "")
+                     << (g == BddManager::ZERO ? " (unsatisfiable)" : "") << endl;
+                bdd.deref(g);
+            }
+            bdd.deref(f);
+            printBddStats(bdd.statistics());
+        } else if (option == 19) {
+            cout << "\n--- BDD Variable Ordering ---" << endl;
+            set<string> atoms;
+            collectAtoms(original, atoms);
+            vector<string> lexicographic(atoms.begin(), atoms.end());
+            size_t span = 0;
+            vector<string> force = forceAtomOrder(original, span);
+            vector<OrderReport> reports;
+            reports.push_back(buildBddWithOrder(original, lexicographic, "lexicographic"));
+            reports.push_back(buildBddWithOrder(original, dfsAtomOrder(original), "DFS"));
+            reports.push_back(buildBddWithOrder(original, force, "FORCE"));
+            reports.push_back(buildBddWithOrder(original, lexicographic, "lexicographic + auto sifting", true));
+            reports.push_back(buildBddWithOrder(original, lexicographic, "lexicographic + final sift", false, true));
+            cout << "FORCE order span: " << span << endl;
+            printOrderReports(reports);
+        } else if (option == 20) {
+            cout << "\n--- d-DNNF Compilation ---" << endl;
+            CountStats stats;
+            Dnnf dnnf = compileDnnf(db, stats);
+            printDnnfStats(dnnf, stats);
+            auto start = chrono::steady_clock::now();
+            BigNat models = dnnf.count();
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            cout << "Models over " << db.numVars << " atoms: " << models.toString() << " (" << us << " us)" << endl;
+            start = chrono::steady_clock::now();
+            double probability = dnnf.weightedCount(vector<double>(2 * (size_t)db.numVars, 0.5));
+            us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            cout << "Probability that the formula holds (atoms true with 0.5): " << probability << " (" << us << " us)" << endl;
+            if (!assignment.empty()) {
+                vector<char> model(db.numVars, 0);
+                for (int v = 0; v < db.numVars; ++v) {
+                    auto it = assignment.find(db.names[v]);
+                    if (it != assignment.end()) model[v] = it->second;
+                }
+                cout << "Value under the entered assignment (other atoms false): "
+                     << (dnnf.evaluate(model) ? "TRUE" : "FALSE") << endl;
+            }
+            cout << "Atoms to condition on (e.g. \"a ~b\", empty to skip): ";
+            string line;
+            getline(cin, line); // rest of the option line
+            getline(cin, line);
+            stringstream fixes(line);
+            vector<signed char> values(db.numVars, -1);
+            string literal;
+            bool any = false;
+            while (fixes >> literal) {
+                bool negated = literal[0] == '~';
+                string atom = negated ? literal.substr(1) : literal;
+                auto it = find(db.names.begin(), db.names.end(), atom);
+                if (it == db.names.end()) {
+                    cout << "Unknown atom " << atom << " ignored." << endl;
+                    continue;
+                }
+                values[it - db.names.begin()] = !negated;
+                any = true;
+            }
+            if (any) {
+                start = chrono::steady_clock::now();
+                Dnnf conditioned = dnnf.condition(values);
+                BigNat rest = conditioned.count();
+                us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+                cout << "Conditioned d-DNNF: " << conditioned.nodes.size() << " nodes, models over the other atoms: "
+                     << rest.toString() << " (" << us << " us)" << endl;
+            }
+        } else if (option == 21) {
+            cout << "\n--- And-Inverter Graph ---" << endl;
+            Aig aig;
+            uint32_t output = aig.fromTree(original);
+            aig.measure(output);
+            measureTree(original, aig.stats.treeNodes, aig.stats.treeDepth);
+            printAigStats(aig.stats);
+            if (output <= Aig::TRUE_LIT) cout << "The formula folded to the constant " << (output == Aig::TRUE_LIT ? "true" : "false") << "." << endl;
+
+            TseitinEncoder encoder;
+            encoder.encode(original);
+            int outputLit;
+            ClauseDB aigCnf = aig.toCnf(output, outputLit);
+            cout << "Tseitin CNF: parse tree " << encoder.db.numVars << " variables / " << encoder.db.clauses.size()
+                 << " clauses, AIG " << aigCnf.numVars << " variables / " << aigCnf.clauses.size() << " clauses" << endl;
+            aigCnf.clauses.push_back({outputLit});
+            CDCLSolver solver(aigCnf, SolverOptions());
+            cout << "Satisfiable (CDCL on the AIG CNF): " << (solver.solve() == SolveResult::SAT ? "yes" : "no") << endl;
+
+            const size_t words = 1024;
+            mt19937_64 random(1);
+            vector<uint64_t> inputWords(aig.inputs.size() * words), values;
+            for (auto& word : inputWords) word = random();
+            auto start = chrono::steady_clock::now();
+            aig.simulate(inputWords, words, values);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            uint64_t hits = 0;
+            for (size_t w = 0; w < words; ++w) hits += __builtin_popcountll(Aig::literalWord(values, words, output, w));
+            cout << "Random simulation: " << 64 * words << " patterns in " << ms << " ms, formula true on "
+                 << 100.0 * hits / (64 * words) << "% of them" << endl;
+            if (!assignment.empty()) {
+                cout << "Value under the entered assignment (other atoms false): "
+                     << (aig.evaluate(output, assignment) ? "TRUE" : "FALSE") << endl;
+            }
+        } else if (option == 22) {
+            cout << "\n--- AIG Rewriting ---" << endl;
+            Aig aig;
+            uint32_t output = aig.fromTree(original);
+            AigRewriter rewriter;
+            uint32_t optimizedOutput;
+            Aig optimized = rewriter.optimize(aig, output, optimizedOutput);
+            printRewriteStats(rewriter.stats);
+            int before, after;
+            ClauseDB beforeCnf = aig.toCnf(output, before), afterCnf = optimized.toCnf(optimizedOutput, after);
+            cout << "Tseitin CNF: " << beforeCnf.numVars << " variables / " << beforeCnf.clauses.size() << " clauses -> "
+                 << afterCnf.numVars << " variables / " << afterCnf.clauses.size() << " clauses" << endl;
+            if (optimizedOutput <= Aig::TRUE_LIT) {
+                cout << "The formula is " << (optimizedOutput == Aig::TRUE_LIT ? "valid" : "unsatisfiable") << "." << endl;
+            } else {
+                string formula = aigToInfix(optimized, optimizedOutput);
+                if (formula.empty()) cout << "Minimized formula is too large to print." << endl;
+                else cout << "Minimized formula: " << formula << endl;
+            }
+        } else if (option == 23) {
+            cout << "\n--- Two-Level Minimization ---" << endl;
+            cout << "Target form, CNF or DNF? (c/d): ";
+            char form;
+            cin >> form;
+            bool asCnf = !(form == 'd' || form == 'D');
+            cout << "Method, Espresso or exact Quine-McCluskey (up to " << QM_MAX_VARS << " atoms)? (e/x): ";
+            char method;
+            cin >> method;
+            bool exact = method == 'x' || method == 'X';
+            if (exact && db.numVars > QM_MAX_VARS) {
+                cout << "The formula has " << db.numVars << " atoms; using Espresso instead." << endl;
+                exact = false;
+            }
+            // The clauses are a cover of the off-set; its complement covers the on-set
+            Espresso espresso;
+            CubeCover cover = offsetCover(db);
+            cout << "CNF clauses: " << db.clauses.size() << ", literals: ";
+            size_t literals = 0;
+            for (const auto& clause : db.clauses) literals += clause.size();
+            cout << literals << endl;
+            if (!asCnf) {
+                cover = espresso.complement(cover);
+                if (espresso.overflow) {
+                    cout << "The on-set cover is too large (over " << espresso.maxCubes << " cubes)." << endl;
+                    continue;
+                }
+            }
+            TwoLevelStats stats;
+            CubeCover result = exact ? minimizeExact(cover, stats) : espresso.minimize(cover, stats);
+            printTwoLevelStats(stats, asCnf ? "Clauses" : "Terms");
+            if (result.size() <= 100) cout << (asCnf ? "Minimized CNF: " : "Minimized DNF: ") << coverToString(result, db.names, asCnf) << endl;
+            if (asCnf) {
+                cout << "Replace the clause database with the minimized CNF? (y/n): ";
+                char replace;
+                cin >> replace;
+                if (replace == 'y' || replace == 'Y') db = coverToClauses(result, db.names);
+            }
+        } else if (option == 24) {
+            cout << "\n--- Partial Evaluation ---" << endl;
+            unordered_map<string, bool> partial;
+            while (true) {
+                string atom;
+                cout << "Enter atom name or STOP to end: ";
+                if (!(cin >> atom) || atom == "STOP") break;
+                int value;
+                cout << "Enter truth value for " << atom << " (0 for FALSE, 1 for TRUE): ";
+                if (!(cin >> value) || (value != 0 && value != 1)) {
+                    cerr << "Invalid input. Please enter 0 or 1." << endl;
+                    cin.clear();
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    continue;
+                }
+                partial[atom] = (value == 1);
+            }
+            Specialization spec = specialize(original, partial);
+            printSpecialization(spec);
+
+            // Re-evaluation cost: the same random completions on the whole formula and the residual
+            set<string> allAtoms;
+            collectAtoms(original, allAtoms);
+            const int samples = 1000;
+            mt19937 rng(12345);
+            vector<unordered_map<string, bool>> completions(samples, partial);
+            for (auto& completion : completions) {
+                for (const auto& name : allAtoms) {
+                    if (!partial.count(name)) completion[name] = rng() & 1;
+                }
+            }
+            vector<char> full(samples), residual(samples);
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < samples; ++i) full[i] = evaluate(original, completions[i]);
+            double fullMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            start = chrono::steady_clock::now();
+            for (int i = 0; i < samples; ++i) residual[i] = evaluate(spec.residual, completions[i]);
+            double residualMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "Re-evaluation of " << samples << " completions: whole formula " << fullMs << " ms, residual "
+                 << residualMs << " ms, " << (full == residual ? "all agree" : "MISMATCH") << endl;
+        } else if (option == 25) {
+            cout << "\n--- Incremental Evaluation ---" << endl;
+            auto start = chrono::steady_clock::now();
+            IncrementalEvaluator evaluator(original);
+            double compileMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            size_t treeNodes = 0;
+            int treeDepth = 0;
+            measureTree(original, treeNodes, treeDepth);
+            unordered_map<string, bool> values;
+            for (const auto& name : evaluator.atomNames) values[name] = assignment.count(name) && assignment.at(name);
+            bool result = evaluator.reset(values);
+            cout << "Compiled " << treeNodes << " tree nodes into " << evaluator.size() << " DAG nodes ("
+                 << evaluator.atomNames.size() << " atoms, " << evaluator.level[evaluator.root] << " levels) in "
+                 << compileMs << " ms" << endl;
+            cout << "Current value (unassigned atoms FALSE): " << (result ? "TRUE" : "FALSE") << endl;
+            unordered_map<string, bool> flipped = values;
+            benchmarkIncremental(original, evaluator, flipped, 10000, 100);
+            evaluator.reset(values);
+
+            // Batches typed by the user: atom/value pairs, END applies them, STOP finishes
+            vector<pair<int, bool>> batch;
+            while (true) {
+                string atom;
+                cout << "Enter atom name, END to apply the batch, or STOP to finish: ";
+                if (!(cin >> atom) || atom == "STOP") break;
+                if (atom == "END") {
+                    long before = evaluator.recomputed;
+                    result = evaluator.update(batch);
+                    cout << "Applied " << batch.size() << " update(s): formula is " << (result ? "TRUE" : "FALSE")
+                         << ", " << evaluator.recomputed - before << " nodes recomputed" << endl;
+                    batch.clear();
+                    continue;
+                }
+                int value;
+                cout << "Enter truth value for " << atom << " (0 for FALSE, 1 for TRUE): ";
+                if (!(cin >> value) || (value != 0 && value != 1)) {
+                    cerr << "Invalid input. Please enter 0 or 1." << endl;
+                    cin.clear();
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    continue;
+                }
+                int index = evaluator.atom(atom);
+                if (index < 0) cout << atom << " does not occur in the formula." << endl;
+                else batch.push_back({index, value == 1});
+            }
+        } else if (option == 26) {
+            cout << "\n--- Algebraic Simplification ---" << endl;
+            AlgebraicStats algebra;
+            Node* simplified = simplifyFormula(original, algebra); // a fresh tree, or original itself
+            printAlgebraicStats(algebra);
+            if (algebra.steps == 0) {
+                cout << "No rule applies; the formula is kept as entered." << endl;
+                continue;
+            }
+            cout << "Simplified formula: " << toInfix(simplified) << endl;
+            cout << "Use the simplified formula and its CNF for the other options? (y/n): ";
+            char replace;
+            cin >> replace;
+            if (replace != 'y' && replace != 'Y') {
+                deleteTree(simplified);
+            } else {
+                deleteTree(original);
+                original = simplified;
+                vector<vector<string>> simplifiedClauses;
+                collectClauses(convertToCNF(copyTree(simplified)), simplifiedClauses);
+                db = buildClauseDB(simplifiedClauses);
+                cout << "Clause database replaced: " << db.clauses.size() << " clauses over " << db.numVars
+                     << " variables" << endl;
+            }
+        } else {
+            cout << "Unknown option." << endl;
+        }
+    }
     
     // NOTE: Memory cleanup (e.g., deleteTree) is typically needed here.
 